@@ -0,0 +1,34 @@
+# Find LuaJIT 2.x
+#
+# Sets the same variables FindLua51 does, so either one can be used:
+#  LUA_INCLUDE_DIR, LUA_LIBRARIES, and LUAJIT_FOUND
+
+FIND_PATH(LUA_INCLUDE_DIR luajit.h
+  PATH_SUFFIXES luajit-2.1 luajit-2.0 luajit
+  PATHS
+    "$ENV{LUAJIT}/include"
+    /usr/local/include
+    /usr/include)
+
+SET(LUAJIT_NAMES ${LUAJIT_NAMES} luajit-5.1 luajit)
+FIND_LIBRARY(LUA_LIBRARIES NAMES ${LUAJIT_NAMES}
+  PATHS
+    "$ENV{LUAJIT}/lib"
+    /usr/local/lib
+    /usr/lib)
+
+IF(LUA_INCLUDE_DIR AND LUA_LIBRARIES)
+	SET(LUAJIT_FOUND TRUE)
+ENDIF(LUA_INCLUDE_DIR AND LUA_LIBRARIES)
+
+IF(LUAJIT_FOUND)
+	IF(NOT LuaJIT_FIND_QUIETLY)
+		MESSAGE(STATUS "Found LuaJIT: ${LUA_LIBRARIES}")
+	ENDIF (NOT LuaJIT_FIND_QUIETLY)
+ELSE(LUAJIT_FOUND)
+	IF(LuaJIT_FIND_REQUIRED)
+		MESSAGE(FATAL_ERROR "Could not find LuaJIT")
+	ENDIF(LuaJIT_FIND_REQUIRED)
+ENDIF(LUAJIT_FOUND)
+
+MARK_AS_ADVANCED(LUA_INCLUDE_DIR LUA_LIBRARIES)
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_CONFIG_OPTION_H
+#define H_HAX_CONFIG_OPTION_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/ConfigValue.hpp"
+
+#include <vector>
+#include <map>
+
+namespace Hax {
+
+  /**
+   * @class ConfigOption
+   *
+   * A typed field of a Configurable registered through one of the
+   * Configurable::defineOption() variants. Options know how to convert a
+   * ConfigValue into their field's type, which aliases they answer to,
+   * and what their default value is.
+   *
+   * Usage:
+   * @code
+   *  defineOption("Tick Script", &mConfig.TickScript).defaultsTo("true");
+   *  defineEnumOption("Error Handling", &mConfig.ErrorHandling)
+   *    .value("Die", CATCH_AND_DIE)
+   *    .value("Exception", CATCH_AND_THROW)
+   *    .defaultsTo("Die");
+   * @endcode
+   */
+  class ConfigOption {
+  public:
+
+    enum Type {
+      Boolean = 0,  /** bool, "true", "yes", "on" and anything else is false */
+      Integer,      /** int */
+      Bytes,        /** uint64_t, "[NUMBER][B|K|M|G|T]" */
+      Duration,     /** uint64_t seconds, "[NUMBER][S|M|H|D|W]" */
+      Enum,         /** int, one of the values registered using value() */
+      String        /** string_t, taken as-is */
+    };
+
+    ConfigOption(string_t const& name, Type type, void* field);
+    virtual ~ConfigOption();
+
+    /**
+     * Assigns the default value to the field right away, and whenever
+     * the owning Configurable is reset using setDefaults().
+     */
+    ConfigOption& defaultsTo(string_t const& value);
+
+    /** Registers a possible value of an Enum option. */
+    ConfigOption& value(string_t const& name, int value);
+
+    /**
+     * Converts the value and writes it to the field.
+     *
+     * @return false if the value could not be converted, in which case the
+     * field is left untouched
+     */
+    bool assign(ConfigValue const&);
+
+    /** Writes the default value, if any, to the field. */
+    void reset();
+
+    string_t const& getName() const;
+    Type getType() const;
+
+  private:
+    string_t  mName;
+    Type      mType;
+    void      *mField;
+    string_t  mDefault;
+    bool      fHasDefault;
+
+    std::map<string_t, int> mEnumValues;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_CONFIG_OPTION_H
@@ -0,0 +1,139 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_CONFIG_SNAPSHOT_H
+#define H_HAX_CONFIG_SNAPSHOT_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/ConfigValue.hpp"
+
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Hax {
+
+  /**
+   * @class ConfigSnapshot
+   *
+   * A compiled, binary form of a JSON configuration sheet with all of its
+   * includes resolved. Values are stored typed and grouped by the context they
+   * were found in, in the order they were encountered, so applying a snapshot
+   * has the same effect as parsing the sheets it was compiled from.
+   *
+   * Every sheet that contributed to the snapshot is recorded with its hash,
+   * the Configurator uses those to tell whether a snapshot is still fresh.
+   *
+   * Snapshots are produced by Configurator::compile() (or the `hax-config`
+   * tool) and consumed by Configurator::run(snapshot_path).
+   *
+   * @note
+   * Snapshots are written in the host's byte order and are not meant to be
+   * shipped across architectures; load() rejects a foreign snapshot.
+   */
+  class ConfigSnapshot {
+  public:
+
+    struct source_t {
+      string_t  uri;  /** the root sheet has an empty URI */
+      uint64_t  hash;
+    };
+
+    /** Used by apply() to hand over the snapshot's content. */
+    class Visitor {
+    public:
+      inline virtual ~Visitor() { }
+      virtual void onContextStart(string_t const& context)=0;
+      virtual void onOption(string_t const& key, ConfigValue const& value)=0;
+      /**
+       * @param complete
+       * false when the context is interrupted by an include and resumed
+       * after it, in which case it isn't done being configured yet
+       */
+      virtual void onContextEnd(bool complete)=0;
+    };
+
+    ConfigSnapshot();
+    virtual ~ConfigSnapshot();
+    ConfigSnapshot(const ConfigSnapshot&) = delete;
+    ConfigSnapshot& operator=(const ConfigSnapshot&) = delete;
+
+    /** Records a sheet (the root one, or an include) that contributed to this snapshot. */
+    void addSource(string_t const& uri, string_t const& data);
+
+    /** Options recorded from now on belong to the given context. */
+    void beginContext(string_t const& context);
+
+    /**
+     * The current context is interrupted, by an include in the middle of it;
+     * it's resumed by another beginContext() once the include is done.
+     */
+    void suspendContext();
+
+    /** Records an option for the current context. */
+    void record(string_t const& key, string_t const& value);
+
+    /** Writes the recorded snapshot to disk. */
+    bool save(string_t const& path) const;
+
+    /**
+     * Maps the snapshot found at path into memory and validates its layout.
+     * The snapshot stays mapped until this object is destroyed or another
+     * snapshot is loaded.
+     */
+    bool load(string_t const& path);
+
+    /** Walks the loaded snapshot handing every context and option to the visitor. */
+    void apply(Visitor&) const;
+
+    std::vector<source_t> const& getSources() const;
+
+    /** A hash of all the source hashes, in the order they were recorded. */
+    uint64_t getSourcesHash() const;
+
+    enum {
+      Version = 2
+    };
+
+  private:
+    struct context_t {
+      string_t name;
+      bool     complete;
+      std::vector< std::pair<string_t, ConfigValue> > options;
+    };
+
+    std::vector<source_t>   mSources;
+    std::vector<context_t>  mContexts;
+
+    boost::interprocess::file_mapping   *mFile;
+    boost::interprocess::mapped_region  *mRegion;
+    const char  *mBody;     /** the contexts section of the mapped snapshot */
+    size_t      mBodySize;
+    uint32_t    mNrContexts;
+
+    void unmap();
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_CONFIG_SNAPSHOT_H
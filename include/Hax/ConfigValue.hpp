@@ -0,0 +1,140 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_CONFIG_VALUE_H
+#define H_HAX_CONFIG_VALUE_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/Utility.hpp"
+
+namespace Hax {
+
+  /**
+   * @struct ConfigValue
+   *
+   * A configuration value as found in a JSON sheet along with its decoded
+   * form. Values are typed once when they're parsed (or compiled into a
+   * snapshot) so consumers don't have to re-convert the raw string.
+   *
+   * @note
+   * Type inference is context-free: a value like "10M" is ambiguous between
+   * a byte size and a duration in minutes so it is kept as a String and left
+   * for the consumer to interpret.
+   */
+  struct ConfigValue {
+
+    enum Type {
+      String = 0,
+      Boolean,
+      Integer,
+      Bytes,    /** "[NUMBER][B|K|G|T]", decoded into bytes */
+      Duration  /** "[NUMBER][S|H|D|W]", decoded into seconds */
+    };
+
+    inline ConfigValue()
+    : type(String),
+      number(0)
+    {
+    }
+
+    inline explicit ConfigValue(string_t const& in_raw)
+    : type(String),
+      raw(in_raw),
+      number(0)
+    {
+      type = infer(raw, &number);
+    }
+
+    inline ConfigValue(string_t const& in_raw, Type in_type, int64_t in_number)
+    : type(in_type),
+      raw(in_raw),
+      number(in_number)
+    {
+    }
+
+    /**
+     * Determines the type of the given raw value and writes its decoded
+     * numerical form (if any) into out_number.
+     */
+    inline static Type infer(string_t const& raw, int64_t* out_number)
+    {
+      (*out_number) = 0;
+
+      if (raw.empty())
+        return String;
+
+      string_t s = Utility::tolower(raw);
+      if (s == "true" || s == "yes" || s == "on") {
+        (*out_number) = 1;
+        return Boolean;
+      }
+      else if (s == "false" || s == "no" || s == "off")
+        return Boolean;
+
+      bool negative = (s[0] == '-');
+      string_t digits = negative ? s.substr(1) : s;
+      if (digits.empty())
+        return String;
+
+      if (Utility::is_decimal_nr(digits)) {
+        try {
+          (*out_number) = Utility::convertTo<int64_t>(s);
+          return Integer;
+        } catch (BadConversion&) {
+          return String;
+        }
+      }
+
+      if (negative || !Utility::is_decimal_nr(digits.substr(0, digits.size() - 1)))
+        return String;
+
+      switch (digits[digits.size() - 1]) {
+        case 'b': case 'k': case 'g': case 't':
+        {
+          uint64_t bytes = 0;
+          if (!Utility::string_to_bytes(raw, &bytes))
+            return String;
+          (*out_number) = (int64_t)bytes;
+          return Bytes;
+        }
+        case 's': case 'h': case 'd': case 'w':
+        {
+          timespec ts;
+          if (!Utility::string_to_seconds(raw, &ts))
+            return String;
+          (*out_number) = (int64_t)ts.tv_sec;
+          return Duration;
+        }
+      }
+
+      return String;
+    }
+
+    Type      type;
+    string_t  raw;
+    int64_t   number; /** booleans are 0 or 1, bytes and durations are normalized */
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_CONFIG_VALUE_H
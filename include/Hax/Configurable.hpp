@@ -25,7 +25,10 @@
 #define H_HAX_CONFIGURABLE_H
 
 #include "Hax/Hax.hpp"
+#include "Hax/ConfigValue.hpp"
+#include "Hax/ConfigOption.hpp"
 #include <vector>
+#include <unordered_map>
 
 namespace Hax {
 
@@ -37,6 +40,11 @@ namespace Hax {
    * Configurables can subscribe themselves to "contexts" that contain settings
    * related to them and will be called with the defined settings when the configuration
    * is parsed.
+   *
+   * Settings are best handled by registering typed fields using defineOption()
+   * and friends; the Configurator then assigns them directly by looking up the
+   * key (or any of its aliases) in the option registry. Keys that aren't
+   * registered are passed on to setOption().
    */
   class Configurable {
   public:
@@ -61,14 +69,25 @@ namespace Hax {
 
     virtual ~Configurable();
 
-    /** Called whenever a cfg setting is encountered and parsed. */
-    virtual void setOption(string_t const& key, string_t const& value)=0;
+    /** 
+     * Called whenever a cfg setting that isn't in the option registry is
+     * encountered and parsed. The default implementation discards the setting.
+     */
+    virtual void setOption(string_t const& key, string_t const& value);
+
+    /**
+     * Assigns the value to the registered option identified by key, or
+     * passes it on to setOption() if there's no such option.
+     *
+     * This is what the Configurator calls for every setting.
+     */
+    void applyOption(string_t const& key, ConfigValue const& value);
 
     /** 
-     * All Configurables must provide some defaults that will be set when
-     * they're constructed.
+     * Resets all registered options to their defaults. Implementations with
+     * settings outside the registry should reset those here as well.
      */
-    virtual void setDefaults() = 0;
+    virtual void setDefaults();
     
     /**
      * Called when the config section is fully parsed, implementations
@@ -89,6 +108,21 @@ namespace Hax {
     
     /** This instance will be called whenever the given context is encountered. */
     void subscribeContext(string_t const&);
+
+    /**
+     * Registers a typed field in the option registry. The field is assigned
+     * whenever the key, or any of the aliases, is encountered in a context
+     * this instance is subscribed to.
+     *
+     * @warning
+     * The field must outlive this instance; it is normally a member of it.
+     */
+    ConfigOption& defineOption(string_t const& key, bool* field, std::vector<string_t> aliases = {});
+    ConfigOption& defineOption(string_t const& key, int* field, std::vector<string_t> aliases = {});
+    ConfigOption& defineOption(string_t const& key, string_t* field, std::vector<string_t> aliases = {});
+    ConfigOption& defineBytesOption(string_t const& key, uint64_t* field, std::vector<string_t> aliases = {});
+    ConfigOption& defineDurationOption(string_t const& key, uint64_t* field, std::vector<string_t> aliases = {});
+    ConfigOption& defineEnumOption(string_t const& key, int* field, std::vector<string_t> aliases = {});
     
     /** 
      * When a Configurable is subscribed to more than 1 context,
@@ -98,7 +132,20 @@ namespace Hax {
     
     std::vector<string_t> mContexts;
     
+    /**
+     * @note
+     * The option registry is not copied along with the instance as the options
+     * point to the source's fields; copies must define their own.
+     */
     void copy(const Configurable& src);
+
+  private:
+    ConfigOption& registerOption(string_t const& key, ConfigOption::Type, void* field, std::vector<string_t> const& aliases);
+
+    std::vector<ConfigOption> mOptions;
+
+    /** maps every key and alias to the option in mOptions */
+    std::unordered_map<string_t, size_t> mOptionIndex;
   };
 }
 
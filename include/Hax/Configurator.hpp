@@ -27,6 +27,7 @@
 #include "Hax/Hax.hpp"
 #include "Hax/Logger.hpp"
 #include "Hax/Configurable.hpp"
+#include "Hax/ConfigSnapshot.hpp"
 
 #include <map>
 
@@ -40,8 +41,11 @@ namespace Hax {
    * 
    * Parses a JSON configuration sheet and calls all subscribed Configurable objects
    * with their options.
+   *
+   * A sheet can also be compiled into a ConfigSnapshot which can be applied
+   * on later boots without parsing the sheet or any of its includes.
    */
-  class Configurator : public Logger {
+  class Configurator : public Logger, private ConfigSnapshot::Visitor {
   public:
 
     Configurator(string_t const& json_data);
@@ -57,6 +61,26 @@ namespace Hax {
      * performs the actual parsing and configuration of subscribed instances
      */
     void run();
+
+    /**
+     * Configures subscribed instances from the compiled snapshot found at
+     * snapshot_path, as long as it was compiled from this very sheet and none
+     * of the sheets it includes have changed since.
+     *
+     * If the snapshot is missing or stale, the sheet is parsed just like run().
+     *
+     * @return true if the snapshot was used
+     */
+    bool run(string_t const& snapshot_path);
+
+    /**
+     * Parses the sheet, resolving all of its includes, and writes a compiled
+     * snapshot of it to out_path. Subscribed instances are NOT configured.
+     *
+     * @return false if the sheet (or one of its includes) is malformed, or
+     * the snapshot could not be written
+     */
+    bool compile(string_t const& out_path);
     
     /** 
      * subscribed the given Configurable to its configuration context;
@@ -77,7 +101,18 @@ namespace Hax {
     int __onJsonArrayEnd();
     
   private:
-  
+
+    /** Runs the JSON parser over mData, returns false on a malformed sheet. */
+    bool parse();
+
+    /** Are all the sheets the snapshot was compiled from unchanged? */
+    bool isFresh(ConfigSnapshot const&);
+
+    /** overridden from ConfigSnapshot::Visitor */
+    virtual void onContextStart(string_t const&);
+    virtual void onOption(string_t const&, ConfigValue const&);
+    virtual void onContextEnd(bool complete);
+
     /** 
      * Is the JSON key a keyword reserved by the Configurator?
      * 
@@ -96,6 +131,12 @@ namespace Hax {
     string_t      mCurrCtx;
     Configurable  *mCurrSub;
     int           mDepth;
+
+    /** when set, the parsed sheet is recorded into this snapshot */
+    ConfigSnapshot  *mSnapshot;
+    /** when set, the parsed options are only recorded and not dispatched */
+    bool            fCompiling;
+    bool            fFailed;
    
     enum {
       yajl_continue = 1, /** continue parsing */
@@ -60,6 +60,18 @@ namespace Hax
      */
     virtual bool cleanup()=0;
 
+    /**
+     * Called with the time left until the next frame, when there's any, for
+     * work that may as well be done ahead, like collecting garbage. The
+     * default does nothing.
+     *
+     * @param lBudgetNs
+     * The number of nanoseconds the engine may spend in here.
+     */
+    inline virtual void idle(uint64_t /* lBudgetNs */)
+    {
+    }
+
   protected:
     inline Engine()
     : fSetup(false)
@@ -0,0 +1,216 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_ENGINE_SCHEDULER_H
+#define H_HAX_ENGINE_SCHEDULER_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/Engine.hpp"
+#include "Hax/Logger.hpp"
+#include "Hax/Configurable.hpp"
+#include "Hax/Metrics.hpp"
+#include "Hax/WorkerPool.hpp"
+
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <boost/thread.hpp>
+
+namespace Hax {
+
+  /**
+   * @class EngineScheduler
+   *
+   * Drives a set of Engines on a fixed-timestep loop, replacing the hand
+   * written loops that update every engine in a hard-coded order.
+   *
+   * Every engine is registered with a tick rate and the names of the engines
+   * it depends on. The loop advances in steps of "Timestep" milliseconds;
+   * real time is accumulated and as many steps are run as have elapsed, up to
+   * "Max Catch Up" per frame, after which the backlog is dropped (and counted)
+   * rather than spiralling. An engine is updated on the steps where its own
+   * period is due and is handed its period as lTimeElapsed; periods that
+   * aren't a whole number of milliseconds (60Hz is 16.67ms) are handed out
+   * rounded up or down so that they add up to real time, and an engine is
+   * updated exactly tick_rate times per simulated second whatever the step.
+   *
+   * Within a step, an engine is only updated once all the engines it depends
+   * on (that are due in the same step) are done. Engines registered as
+   * parallel are handed to a pool of "Workers" threads and may run at the same
+   * time as any engine they don't depend on; the rest run on the thread that
+   * calls step() or run().
+   *
+   * @warning
+   * Only mark an engine parallel if it doesn't share unsynchronized state
+   * with engines it can overlap with; the EventListener queues for one are
+   * not thread-safe, so event-driven engines should depend on EventManager.
+   *
+   * An exception thrown by an engine's update() doesn't break off the step:
+   * the engine's remaining runs are skipped, every other due engine is still
+   * updated, and step() (or run()) rethrows the first exception once they're
+   * all done.
+   *
+   * Each engine can be given an update budget; updates going over it are
+   * counted and logged. Update times are also exported to the MetricsManager
+   * as hax_engine_update_seconds{engine="name"}.
+   *
+   * The scheduler subscribes to the "Engine Scheduler" configuration context:
+   *  "Timestep": milliseconds per step, default: 16
+   *  "Max Catch Up": the most steps run per frame, default: 5
+   *  "Workers": threads for parallel engines, default: 0 (no parallelism)
+   *
+   * Usage:
+   * @code
+   *  EngineScheduler scheduler;
+   *  scheduler.add("events", EventManager::getSingletonPtr());
+   *  scheduler.add("script", &script_engine, 0, { "events" });
+   *  scheduler.add("physics", &physics, 120, {}, 4000, true);
+   *  scheduler.setup();
+   *  scheduler.run(); // until stop() is called
+   *  scheduler.cleanup();
+   * @endcode
+   */
+  class EngineScheduler : public Logger, public Configurable {
+  public:
+
+    struct stats_t {
+      uint64_t updates;
+      uint64_t overruns;  /** updates that went over the budget */
+      uint64_t last_ns;
+      uint64_t max_ns;
+      uint64_t total_ns;
+    };
+
+    EngineScheduler();
+    EngineScheduler(const EngineScheduler&) = delete;
+    EngineScheduler& operator=(const EngineScheduler&) = delete;
+    virtual ~EngineScheduler();
+
+    /**
+     * Registers an engine; must be done before setup().
+     *
+     * @param tick_rate updates per second, 0 updates it on every step; a rate
+     *  above 1000 / "Timestep" is still met on average, but with several
+     *  updates back to back on some steps, and is warned about
+     * @param depends_on engines that must be done before this one is updated
+     * @param budget_us the expected update time in microseconds, 0 for none
+     * @param parallel whether the engine may be updated on a worker thread
+     */
+    void add(
+      string_t const& name,
+      Engine* engine,
+      unsigned tick_rate = 0,
+      std::vector<string_t> depends_on = {},
+      uint64_t budget_us = 0,
+      bool parallel = false);
+
+    /**
+     * Orders the engines by their dependencies and sets them up; returns false
+     * if a dependency is unknown or cyclic, or if an engine fails to set up.
+     */
+    bool setup();
+
+    /** Runs the fixed-timestep loop on the calling thread until stop() is called. */
+    void run();
+
+    /** Makes run() return after the current frame; safe to call from any thread. */
+    void stop();
+
+    /**
+     * Advances the schedule by a single step, for applications that drive
+     * their own loop.
+     */
+    void step();
+
+    /** Cleans up the engines in the reverse order they were set up. */
+    bool cleanup();
+
+    stats_t getStats(string_t const& name) const;
+
+    /** The number of steps dropped because the loop couldn't catch up. */
+    uint64_t getDroppedSteps() const;
+
+  private:
+    struct entry_t {
+      string_t  name;
+      const char *trace_name; /** the name, interned for the Tracer */
+      Engine    *engine;
+      unsigned  tick_rate;
+      uint64_t  accumulator;  /** due updates, in thousandths */
+      uint64_t  ticks;        /** updates so far within the current second */
+      uint64_t  budget_ns;
+      bool      parallel;
+      std::vector<string_t> depends_on;
+
+      /* indices into mEngines, resolved by setup() */
+      std::vector<size_t> requires;
+      std::vector<size_t> dependents;
+
+      /* this step's state */
+      uint64_t  runs;     /** how many periods are due */
+      size_t    pending;  /** due dependencies that aren't done yet */
+
+      std::atomic<uint64_t> updates;
+      std::atomic<uint64_t> overruns;
+      std::atomic<uint64_t> last_ns;
+      std::atomic<uint64_t> max_ns;
+      std::atomic<uint64_t> total_ns;
+      Histogram *update_time;
+    };
+
+    /**
+     * Updates an engine, holding on to the first exception an engine throws
+     * in a step so that step() can rethrow it once the step is drained.
+     */
+    void update(size_t index);
+
+    /** called once an engine is updated, on whichever thread updated it */
+    void onUpdated(size_t index);
+
+    std::vector<entry_t*> mEngines;
+
+    /* the engines ordered so that dependencies come first */
+    std::vector<size_t> mOrder;
+
+    WorkerPool *mWorkers;
+
+    /* step bookkeeping, guarded by mStepMutex */
+    boost::mutex              mStepMutex;
+    boost::condition_variable mStepProgress;
+    std::vector<size_t>       mReady;
+    size_t                    mRemaining;
+    std::exception_ptr        mError;
+
+    std::atomic<bool>     fRunning;
+    std::atomic<uint64_t> mDroppedSteps;
+
+    struct config_t {
+      int Timestep;
+      int MaxCatchUp;
+      int Workers;
+    } mConfig;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_ENGINE_SCHEDULER_H
@@ -60,6 +60,18 @@ namespace Hax {
     };
   }
 
+  /** protocol errors caught while parsing inbound events, see Event::fromStream() */
+  namespace EventParseError {
+
+    enum {
+      TooShort = 0,       // fewer bytes than a header and a footer
+      FailedSanityCheck,  // malformed UID, feedback, or length in the header
+      BadLength,          // the properties length exceeds the received bytes
+      ChecksumMismatch,
+      Count
+    };
+  }
+
   /**
    * Base Event object that is used and handled to represent game events.
    */
@@ -90,6 +102,11 @@ namespace Hax {
 		//! resets evt state
 		~Event();
 
+    /**
+     * Parses an event out of the buffer. Protocol errors are counted, see
+     * getParseErrors(), and logged by the "Event" logger at most once a second
+     * per thread; no global lock is taken.
+     */
     bool fromStream(boost::asio::streambuf& in);
     void toStream(boost::asio::streambuf& out) const;
 
@@ -118,6 +135,13 @@ namespace Hax {
     static const uint32_t MaxLength; // no single message can be longer than this (2^32-1)
     void                  *Any;
 
+    /**
+     * The number of inbound events of the given EventParseError type that
+     * failed to parse, over all threads; -1 sums all the types.
+     */
+    static uint64_t getParseErrors(int error = -1);
+    static const char* getParseErrorName(int error);
+
     static int __CRC32(const std::string& my_string);
     static std::string __uidToString(unsigned char);
 		void __clone(const Event& src);
@@ -84,6 +84,20 @@ namespace Hax
     public:
     typedef std::function<bool(const Event&)> EventHandler_T;
 
+    /**
+     * Which thread may run this listener's handlers.
+     *
+     * OwnerThread listeners are only ever processed by whoever owns them,
+     * when they call processEvents(). AnyThread listeners promise their
+     * handlers are thread-safe; when the EventManager has a WorkerPool it
+     * processes them itself, on the pool, right after handing them events.
+     * Their owners should then leave processEvents() alone.
+     */
+    enum Affinity {
+      OwnerThread,
+      AnyThread
+    };
+
     EventListener();
     virtual ~EventListener();
 
@@ -91,11 +105,22 @@ namespace Hax
      * Injects the EventListener causing it to process any queued events,
      * you should do this when you update, step, or tick your components.
      *
+     * Events are handled in order, and an event is done once all of its
+     * handlers have returned true; the ones that returned false are called
+     * again with the same event on the next injection, and the events
+     * queued behind it wait until then. A handler that throws is left
+     * pending as well, and the exception is passed on to the caller.
+     *
+     * @param budget
+     * The most events to process in this call, 0 for all of them.
+     *
+     * @return true if the queue was drained
+     *
      * @note
      * EventListeners MUST be injected (ticked, updated, whatever you call it)
      * or otherwise no handler will be called!
      */
-    bool processEvents();
+    bool processEvents(size_t budget = 0);
 
     /** Binds a handler to an event identified by the given UID. */
     void bind(EventUID_T, EventHandler_T);
@@ -112,6 +137,9 @@ namespace Hax
     /** An automatically generated UID for this EventListener. */
     int getUID() const;
 
+    void setAffinity(Affinity);
+    Affinity getAffinity() const;
+
   protected:
     friend class EventManager;
     
@@ -128,12 +156,52 @@ namespace Hax
     typedef std::map<EventUID_T, std::vector<EventHandler_T>> EventHandlers_T;
     EventHandlers_T mEvtHandlers;
 
-    typedef std::list<EventHandler_T> tracker_t;
-    tracker_t mTracker;
+    /** calls the handlers still pending for evt, true once they're all done */
+    bool dispatch(const Event& evt);
+
+    /**
+     * A handler of the event at the front of the queue that has yet to
+     * return true: its index in the handlers bound to uid, which is either
+     * the event's own UID or EventUID::Unassigned, as of the given bind
+     * generation of uid.
+     */
+    struct pending_t {
+      pending_t(EventUID_T in_uid, size_t in_index, size_t in_generation)
+      : uid(in_uid), index(in_index), generation(in_generation) { }
+
+      EventUID_T uid;
+      size_t index;
+      size_t generation;
+    };
+
+    /** the pending handler, unless it was unbound in the meantime */
+    EventHandler_T* getHandler(pending_t const&);
+
+    std::vector<pending_t> mPending;
+    bool fRetrying;
+
+    /**
+     * Bumped for a UID whenever its handlers are unbound, so a pending
+     * handler isn't mistaken for whatever is bound at its index afterwards.
+     */
+    std::map<EventUID_T, size_t> mBindGenerations;
+
+    /**
+     * Handlers may bind and unbind while being called; the handler vectors
+     * they'd destroy or reallocate are kept here until the dispatch is over.
+     */
+    std::vector<std::vector<EventHandler_T>> mRetired;
+    bool fDispatching;
+
+    /** moves the handlers of uid to mRetired if a dispatch is running */
+    void retire(EventHandlers_T::iterator);
 
     queue<Event> mEvents; // processing queue
 
     int mUID;
+
+    Affinity mAffinity;
+    bool fScheduled; // queued for the EventManager's WorkerPool this update
   private:
     void doSubscribe(EventUID_T);
     void doUnsubscribe(EventUID_T);
@@ -27,6 +27,7 @@
 #include <string>
 #include <map>
 #include <queue>
+#include <deque>
 #include <list>
 #include <vector>
 #include <utility>
@@ -34,8 +35,12 @@
 
 #include "Hax/Hax.hpp"
 #include "Hax/Logger.hpp"
+#include "Hax/Engine.hpp"
 #include "Hax/Event.hpp"
 #include "Hax/EventListener.hpp"
+#include "Hax/Metrics.hpp"
+
+#include <boost/thread.hpp>
 
 using std::make_pair;
 using std::pair;
@@ -46,6 +51,19 @@ using std::list;
 namespace Hax
 {
 	class EventListener;
+	class WorkerPool;
+
+  /** the EventManager's queue lanes, in order of precedence */
+  namespace EventLane {
+
+    enum {
+      Critical = 0,
+      Major,
+      Minor,
+      Count
+    };
+  }
+
   /*!
   * @class EventManager "EventManager.h" "../include/EventManager.h"
   * @brief
@@ -62,7 +80,7 @@ namespace Hax
   *	to make sure all EventListeners interested in this Event are notified
   *	when the Event's turn has come in the queue.
   */
-  class EventManager : public Logger
+  class EventManager : public Logger, public Engine
   {
     typedef std::list<EventListener*> subscribers_t;
     typedef std::map< unsigned char, subscribers_t > subscription_t;
@@ -92,8 +110,11 @@ namespace Hax
     *  @return nothing
     *
     *  \note inListener MUST be a derivative of EventListener
+    *  \note May be called from any thread, including an AnyThread
+    *  listener's handler running on the WorkerPool.
     */
     void subscribe(unsigned char evt, EventListener* listener) {
+      boost::mutex::scoped_lock lock(mSubscriptionsMutex);
       subscription_t::iterator binder = mSubscriptions.find(evt);
       if (binder == mSubscriptions.end())
       {
@@ -112,23 +133,38 @@ namespace Hax
      *  required to be fired.
      *
      *  \remarks
-     *  When an Event is requested to be fired, ie hooked,
-     *  EventManager determines the position for this Event
-     *  in the queue using the Rank of the event;
+     *  Events are queued in the lane assigned to their UID, see
+     *  setLane(); each lane is FIFO, and update() picks the lane to
+     *  dispatch from by weight so a flood of minor events can't hold
+     *  back critical ones, nor starve itself.
      *
-     *  If the Event is ranked MINOR_EVT, it is queued right
-     *  after the last minor event in the queue.
-     *  If the Event is ranked MAJOR_EVT, it is queued in the
-     *  end; will be processed once all preceding events
-     *  are done.
+     *  If the UID is coalesced, see coalesce(), and an event of the
+     *  same UID and key property is still pending, that one takes on
+     *  the content of inEvt and keeps its place in the lane.
+     */
+    void hook(const Event& inEvt);
+
+    /*! \brief Assigns the events of the given UID to an EventLane.
      *
-     *  \note
-     *  For more info about the Ranks of events, see
-     *  the class reference for Event.
+     *  UIDs not assigned to any lane are queued in EventLane::Major.
      */
-    void hook(const Event& inEvt) {
-      mEvents.push(Event(inEvt));
-    }
+    void setLane(EventUID_T evt, int lane);
+
+    /*! \brief How many events a lane may dispatch per round, when all of
+     *  the lanes are busy. The defaults are 8, 4, and 1 for the Critical,
+     *  Major, and Minor lanes. A weight of 0 is taken as 1.
+     */
+    void setLaneWeight(int lane, unsigned weight);
+
+    /*! \brief Keeps only the latest pending event per (UID, key) pair.
+     *
+     *  Meant for events that supersede each other, like position updates
+     *  of the same entity: with coalesce(EntityMoved, "Entity"), hooking
+     *  a newer EntityMoved for an entity replaces the older one still
+     *  waiting in the queue. Events lacking the key property are never
+     *  coalesced. Pass an empty key to stop coalescing the UID.
+     */
+    void coalesce(EventUID_T evt, std::string const& key);
 
     /*! \brief
     *	Processes Events in queue.
@@ -137,6 +173,28 @@ namespace Hax
     */
     void update();
 
+    /*! \brief
+    *  Engine interface, so the EventManager can be driven by an
+    *  EngineScheduler; update() dispatches the queue and cleanup()
+    *  discards whatever is left in it.
+    */
+    virtual bool setup();
+    virtual void update(unsigned long lTimeElapsed);
+    virtual bool cleanup();
+
+    /*! \brief
+    *  Hands AnyThread listeners to the given pool: every update() then
+    *  runs their processEvents() as jobs, and returns once they're done.
+    *  Each listener has at most one job in flight, so its events are
+    *  still handled in order. Pass NULL to go back to the serial mode.
+    *
+    *  If a handler throws, the first exception is rethrown by update()
+    *  once all of the jobs are done.
+    *
+    *  \note The pool isn't owned by the EventManager.
+    */
+    void setWorkerPool(WorkerPool*);
+
     protected:
     EventManager();
     EventManager(const EventManager& src);
@@ -146,11 +204,48 @@ namespace Hax
     bool alreadySubscribed(EventListener* inListener);
     void detachListener(EventListener* inListener);
 
-    //! container for direct subscribers
+    //! container for direct subscribers; AnyThread handlers may subscribe
+    //! and unsubscribe while the pool runs them, so it's guarded by
+    //! mSubscriptionsMutex, which update() takes only while delivering
     subscription_t mSubscriptions;
-
-    //! processing queue
-    std::queue<Event> mEvents;
+    boost::mutex mSubscriptionsMutex;
+
+    //! processing lanes, hook() may be called from any thread; all of the
+    //! lanes and their bookkeeping are guarded by mEventsMutex
+    std::deque<Event> mLanes[EventLane::Count];
+    unsigned mLaneWeights[EventLane::Count];
+    unsigned mLaneCredits[EventLane::Count];
+    std::map<EventUID_T, int> mLaneAssignments;
+    boost::mutex mEventsMutex;
+
+    //! the lane to dispatch the next event from, or -1 if all are empty
+    int nextLane();
+    int getLane(EventUID_T) const;
+
+    //! coalescing: the key property per UID, and the pending events by key;
+    //! deque elements stay put when pushing and popping at the ends
+    std::map<EventUID_T, std::string> mCoalesceKeys;
+    std::map<std::pair<EventUID_T, std::string>, Event*> mCoalescing;
+    size_t mPending;
+
+    //! job system mode, see setWorkerPool()
+    void deliver(EventListener*, const Event&);
+    void process(EventListener*);
+
+    WorkerPool *mWorkers;
+    std::vector<EventListener*> mScheduled;
+    size_t mInFlight;
+    std::exception_ptr mJobError;
+    boost::mutex mInFlightMutex;
+    boost::condition_variable mJobsDone;
+
+    //! metrics, see MetricsManager
+    Counter   *mHooked;
+    Counter   *mDelivered;
+    Counter   *mCoalesced;
+    Gauge     *mQueueDepth;
+    Histogram *mFanOut;
+    Histogram *mDispatchTime;
 
   };
 } // Hax namespace
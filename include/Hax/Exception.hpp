@@ -98,6 +98,14 @@ namespace Hax {
 		: std::runtime_error(s)
 		{ }
 	};
+
+  /** a Lua call ran out of its instruction budget, see ScriptEngine */
+  class ScriptBudgetError : public ScriptError {
+	public:
+		inline ScriptBudgetError(const std::string& s)
+		: ScriptError(s)
+		{ }
+	};
   
   class request_incomplete : public std::runtime_error {
     public:
@@ -109,10 +109,6 @@ namespace Hax {
      */
     bool loadFile(std::ifstream &file, string_t& out);
     
-    /** overridden from Hax::configurable */
-    virtual void setOption(string_t const& key, string_t const& value);
-    virtual void setDefaults();
-    
     size_t __onCurlData(char *buffer, size_t size, size_t nmemb, void *userdata);
   private:    
     explicit FileManager();
@@ -149,7 +145,7 @@ namespace Hax {
        * 
        * alias keys: "dist from root"
        */
-      string_t DistFromRoot; 
+      int DistFromRoot; 
     } mConfig;
   };
 
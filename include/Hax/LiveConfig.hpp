@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LIVE_CONFIG_H
+#define H_HAX_LIVE_CONFIG_H
+
+#include "Hax/Hax.hpp"
+
+#include <atomic>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+namespace Hax {
+
+  /**
+   * @class LiveConfig
+   *
+   * Holds an immutable, published version of a Configurable's settings that
+   * can be read from any thread while the Configurable is being reconfigured.
+   *
+   * Reading is a single acquire load of the current version; readers never
+   * register nor write anything. Writers (normally Configurable::configure())
+   * publish a fresh copy which atomically replaces the current one.
+   *
+   * Replaced versions are retired rather than freed, and reclaimed by the
+   * owner from a quiescent point, see quiesce(). A version is freed only once
+   * a whole quiescent period has passed since it was replaced, so a reader
+   * may keep using what it read until the owner's next quiescent point.
+   *
+   * Usage:
+   * @code
+   *  // writer, in configure()
+   *  mLiveConfig.publish(mConfig);
+   *
+   *  // owner, once per update when none of its reads is in progress
+   *  mLiveConfig.quiesce();
+   *
+   *  // reader, on any thread
+   *  if (mLiveConfig->TickScript) ...
+   *
+   *  // reading several settings off the same version
+   *  config_t const* config = mLiveConfig.read();
+   *  if (config->TickScript && config->BatchEvents) ...
+   * @endcode
+   */
+  template <typename T>
+  class LiveConfig {
+  public:
+
+    inline LiveConfig()
+    : mCurrent(new T())
+    {
+    }
+
+    inline explicit LiveConfig(T const& initial)
+    : mCurrent(new T(initial))
+    {
+    }
+
+    /** There must be no readers left by now. */
+    inline ~LiveConfig()
+    {
+      for (T const* retiree : mRetiring)
+        delete retiree;
+
+      for (T const* retiree : mRetired)
+        delete retiree;
+
+      delete mCurrent.load();
+    }
+
+    LiveConfig(const LiveConfig&) = delete;
+    LiveConfig& operator=(const LiveConfig&) = delete;
+
+    /**
+     * The current version; it stays valid until the owner's second quiesce()
+     * after it's replaced.
+     */
+    inline T const* read() const
+    {
+      return mCurrent.load(std::memory_order_acquire);
+    }
+
+    /** Reads a setting off the current version. */
+    inline T const* operator->() const
+    {
+      return read();
+    }
+
+    /** Replaces the current version with a copy of value. */
+    inline void publish(T const& value)
+    {
+      T const* fresh = new T(value);
+
+      boost::mutex::scoped_lock lock(mMutex);
+
+      mRetiring.push_back(mCurrent.exchange(fresh, std::memory_order_acq_rel));
+    }
+
+    /**
+     * Marks a quiescent point: the owner guarantees no read that started
+     * before the previous quiescent point is still in progress.
+     *
+     * Frees the versions retired before the previous call; the ones retired
+     * since are kept for another period, as readers may still be on them.
+     */
+    inline void quiesce()
+    {
+      std::vector<T const*> expired;
+
+      {
+        boost::mutex::scoped_lock lock(mMutex);
+
+        if (mRetiring.empty() && mRetired.empty())
+          return;
+
+        expired.swap(mRetired);
+        mRetired.swap(mRetiring);
+      }
+
+      for (T const* retiree : expired)
+        delete retiree;
+    }
+
+  private:
+    std::atomic<T const*> mCurrent;
+
+    /** guards the retired versions, it's never taken by readers */
+    boost::mutex mMutex;
+
+    /** retired since the last quiescent point */
+    std::vector<T const*> mRetiring;
+
+    /** retired before the last quiescent point, freed at the next one */
+    std::vector<T const*> mRetired;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_LIVE_CONFIG_H
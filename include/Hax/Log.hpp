@@ -28,13 +28,51 @@
 #include <log4cpp/SyslogAppender.hh>
 #include <log4cpp/RollingFileAppender.hh>
 #include <log4cpp/OstreamAppender.hh>
+#include <log4cpp/Priority.hh>
 
 #include "Hax/log4cpp/FileLayout.hpp"
 #include "Hax/log4cpp/SyslogLayout.hpp"
 #include "Hax/log4cpp/VanillaLayout.hpp"
+#include "Hax/log4cpp/AsyncAppender.hpp"
+#include "Hax/log4cpp/BinaryAppender.hpp"
+#include "Hax/log4cpp/LineAppenders.hpp"
+#include "Hax/log4cpp/RateLimitFilter.hpp"
 
 namespace Hax {
   typedef log4cpp::Category log_t;
 }
 
+/**
+ * The least severe priority that is compiled in at all; statements below it
+ * are dead code and are stripped by the compiler. Defaults to DEBUG, or INFO
+ * when NDEBUG is defined. Can be overridden using the CMake HAX_LOG_MIN_LEVEL
+ * cache variable.
+ */
+#ifndef HAX_LOG_MIN_LEVEL
+# ifdef NDEBUG
+#   define HAX_LOG_MIN_LEVEL log4cpp::Priority::INFO
+# else
+#   define HAX_LOG_MIN_LEVEL log4cpp::Priority::DEBUG
+# endif
+#endif
+
+/**
+ * Level-gated logging statements, usage:
+ *
+ *  HAX_LOG_DEBUG(mLog) << "read file into memory: \n" << out_buf;
+ *
+ * The priority is checked before the stream is created, so none of the
+ * streamed arguments are evaluated unless the message will be logged. The
+ * if/else shape makes the statement safe to use in an unbraced if.
+ */
+#define HAX_LOG_AT(log, priority) \
+  if ((priority) > (HAX_LOG_MIN_LEVEL) || !(log)->isPriorityEnabled(priority)) ; \
+  else (log)->getStream(priority)
+
+#define HAX_LOG_DEBUG(log)  HAX_LOG_AT(log, log4cpp::Priority::DEBUG)
+#define HAX_LOG_INFO(log)   HAX_LOG_AT(log, log4cpp::Priority::INFO)
+#define HAX_LOG_NOTICE(log) HAX_LOG_AT(log, log4cpp::Priority::NOTICE)
+#define HAX_LOG_WARN(log)   HAX_LOG_AT(log, log4cpp::Priority::WARN)
+#define HAX_LOG_ERROR(log)  HAX_LOG_AT(log, log4cpp::Priority::ERROR)
+
 #endif
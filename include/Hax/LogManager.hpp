@@ -27,6 +27,7 @@
 #include "Hax/Hax.hpp"
 #include "Hax/Log.hpp"
 #include "Hax/Configurable.hpp"
+#include "Hax/LiveConfig.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -88,14 +89,13 @@ namespace Hax {
      */
     virtual void configure();
 
-    /** overridden from Hax::configurable */
-    virtual void setOption(string_t const& key, string_t const& value);
-    virtual void setDefaults();
-    
     /** a log that can be used by any entity that is not a derivative of Hax::logger */
     log_t* getLog();
 
     void setSilent(bool);
+
+    /** The configured log4cpp priority; this is safe to call from any thread. */
+    int getLevel() const;
         
   private:    
     explicit LogManager();
@@ -109,22 +109,48 @@ namespace Hax {
 
     string_t mCategoryName;
 
+    enum {
+      DEVICE_FILE = 0,
+      DEVICE_STDOUT,
+      DEVICE_SYSLOG,
+      DEVICE_BINARY
+    };
+
     /* the log manager's config context is "log manager" */
     struct config_t {
-      string_t device;   /** possible values: 'stdout' or 'syslog' or 'file', default: 'file' */
-      string_t level;    /** possible values: 'debug', 'notice', 'info', 'warn', 'error', default: 'debug' */
+      int device;   /** possible values: 'stdout' or 'syslog' or 'file' or 'binary', default: 'stdout' */
+      int level;    /** possible values: 'debug', 'notice', 'info', 'warn', 'error', default: 'debug' */
       
-      /* the following apply only when logging to a file */
+      /* the following apply only when logging to a file, 'binary' writes records that hax-logcat decodes */
       string_t dir;      /** default: "log", the log file will be in /path/to/app/log/mLogname.log */
       string_t filename;     /** default: "Hax.log" */
-      string_t filesize; /** value format: "[NUMBER][B|K|M]", default: 10M */
+      uint64_t filesize; /** value format: "[NUMBER][B|K|M]", default: 10M */
 
       string_t app_name;
       string_t app_version;
       string_t app_website;
       
-      bool     silent;
-    } mConfig;    
+      bool     header;  /** "log header", whether the application header is logged */
+
+      /* asynchronous logging, records are written by a dedicated thread */
+      bool     async;         /** "async", default: false */
+      int      async_buffer;  /** "async buffer", the number of pending records, default: 8192 */
+      int      overflow;      /** "overflow policy", 'block', 'drop' or 'count', default: 'block' */
+
+      /* per-context flood control, see RateLimitFilter */
+      int      rate_limit;    /** "rate limit", messages per second per context, 0 is unlimited, default: 0 */
+      int      rate_burst;    /** "rate burst", default: the rate limit */
+      int      sample_rate;   /** "sample rate", keep 1 in N messages below WARN, default: 1 */
+      string_t rate_limits;   /** "rate limits", per-context overrides: "Context=rate[/burst], ..." */
+      string_t sample_rates;  /** "sample rates", per-context overrides: "Context=N, ..." */
+      uint64_t suppression_report; /** "suppression report", seconds between reports of suppressed messages, default: 10s */
+    };
+
+    /** The settings as they're being parsed, only the configuring thread touches these. */
+    config_t mConfig;
+
+    /** The settings as of the last configure(), these are safe to read from any thread. */
+    LiveConfig<config_t> mLiveConfig;
   };
 
 # ifndef HAX_LOG
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LUA_ALLOCATOR_H
+#define H_HAX_LUA_ALLOCATOR_H
+
+#include "Hax/Hax.hpp"
+
+#include <vector>
+#include <atomic>
+
+namespace Hax {
+
+  /**
+   * @class LuaAllocator
+   *
+   * A lua_Alloc for a single Lua state that serves the small blocks Lua
+   * churns through (strings, tables, closures) out of size-classed free lists
+   * carved from 64K chunks, and leaves anything larger to the heap.
+   *
+   * Freed blocks go back to their free list and are never returned to the
+   * heap until the allocator is destroyed, so a state's footprint is its
+   * peak; in exchange the short-lived tables created per event or tick cost
+   * no malloc() calls, and thus no contention between the threads running
+   * other states.
+   *
+   * A Lua state is only ever used by one thread at a time and so is its
+   * allocator: it takes no locks. The byte counts may be read from anywhere.
+   */
+  class LuaAllocator {
+  public:
+    enum {
+      Granularity = 16,     /** the size classes are multiples of this */
+      MaxPooled   = 256,    /** larger blocks come off the heap */
+      Classes     = MaxPooled / Granularity,
+      ChunkSize   = 64 * 1024
+    };
+
+    LuaAllocator();
+    LuaAllocator(const LuaAllocator&) = delete;
+    LuaAllocator& operator=(const LuaAllocator&) = delete;
+    virtual ~LuaAllocator();
+
+    /** The lua_Alloc to pass to lua_newstate() along with the allocator. */
+    static void* allocate(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    /** Bytes the Lua state is using. */
+    size_t getBytes() const;
+
+    /** The most bytes the Lua state has used at once. */
+    size_t getPeakBytes() const;
+
+    /** Bytes held in chunks, used or not. */
+    size_t getChunkBytes() const;
+
+  private:
+    struct block_t {
+      block_t* next;
+    };
+
+    void* alloc(size_t size);
+    void  release(void* ptr, size_t size);
+    void* resize(void* ptr, size_t osize, size_t nsize);
+
+    /** the block size class of a pooled size */
+    inline static size_t getClass(size_t size) {
+      return (size - 1) / Granularity;
+    }
+
+    block_t*            mFree[Classes];
+    std::vector<char*>  mChunks;
+    char*               mCursor;
+    char*               mEnd;
+
+    /** only written by the thread using the state, relaxed */
+    std::atomic<size_t> mBytes;
+    std::atomic<size_t> mPeakBytes;
+    std::atomic<size_t> mChunkBytes;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_LUA_ALLOCATOR_H
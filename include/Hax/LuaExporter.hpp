@@ -23,38 +23,234 @@
 #ifndef H_HAX_LUA_EXPORTER_H
 #define H_HAX_LUA_EXPORTER_H
 
-#include "Hax/ScriptEngine.hpp"
+#include "Hax/Hax.hpp"
 // #include "Hax/Entity.hpp"
 
+#include <map>
 #include <vector>
 #include <list>
+#include <iterator>
+#include <unordered_map>
+
+extern "C" {
+	#include "lua.h"
+	#include "lauxlib.h"
+}
+
+#include "tolua++.h"
 
 namespace Hax {
 
+  /** the userdata cache shared by the LuaExporters of a state */
+  class LuaExporterBase {
+    protected:
+      /**
+       * Pushes the cache of the usertypes of the given type: a table of
+       * userdata by the light userdata of the object they wrap, with weak
+       * values so objects no export holds anymore are collected.
+       */
+      static void pushCache(lua_State*, const char* data_type);
+
+      /**
+       * Pushes the userdata of an object, reusing the one in the cache at the
+       * given (absolute or pseudo) index if there's one.
+       */
+      static void pushCached(lua_State*, int cache, void* object, const char* data_type);
+  };
+
+  /**
+   * @class LuaExporter
+   *
+   * Exposes a container of pointers to Lua as a global array of usertypes.
+   *
+   * Exports are incremental: the array of every export name is kept in the
+   * registry between calls, and only the objects inserted into or removed
+   * from the container since the last export touch it; each object keeps
+   * the same userdata for as long as it's exported. Exporting an unchanged
+   * container every tick thus creates no garbage at all.
+   *
+   * Removals move the last element into the gap, so the array's order is
+   * that of the insertions rather than the container's, and an object in
+   * the container more than once is exported once.
+   *
+   * Exports are bound to the lua_State they were made in; reset() them when
+   * the state is closed.
+   */
   template <typename T>
-  class LuaExporter {
+  class LuaExporter : public LuaExporterBase {
     public:
       LuaExporter() { }
-      virtual ~LuaExporter() {}
+      virtual ~LuaExporter() { }
 
+      /**
+       * Brings the global array out_table up to date with the container,
+       * whose elements are pushed as usertypes of data_type.
+       */
       inline virtual void
-      __export(T const& container, const char* data_type, const char* out_table)
+      __export(lua_State* lua, T const& container, const char* data_type, const char* out_table)
       {
-        lua_State *lua = ScriptEngine::getSingleton().getLuaState();
+        export_t& exp = getExport(lua, out_table);
+        unsigned generation = ++exp.generation;
 
-        lua_newtable(lua); // declare the empty table out_table
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, exp.table);
+        int table = lua_gettop(lua);
+        pushCache(lua, data_type);
+        int cache = lua_gettop(lua);
 
         typename T::const_iterator cursor;
-        int count = 0;
         for (cursor = container.begin(); cursor != container.end(); ++cursor)
         {
-          lua_pushinteger(lua, (++count));
-          tolua_pushusertype(lua, (void*)(*cursor), data_type);
-          lua_settable(lua, -3);
+          const void* object = (const void*)(*cursor);
+
+          typename std::unordered_map<const void*, size_t>::const_iterator known = exp.positions.find(object);
+          if (known != exp.positions.end()) {
+            exp.stamps[known->second] = generation;
+            continue;
+          }
+
+          exp.positions.insert(std::make_pair(object, exp.slots.size()));
+          exp.slots.push_back(object);
+          exp.stamps.push_back(generation);
+
+          pushCached(lua, cache, (void*)object, data_type);
+          lua_rawseti(lua, table, (int)exp.slots.size());
         }
 
+        // whatever wasn't stamped is gone; everything past the cursor was
+        // kept, so the last element can fill the gap
+        for (size_t slot = exp.slots.size(); slot-- > 0;)
+        {
+          if (exp.stamps[slot] == generation)
+            continue;
+
+          exp.positions.erase(exp.slots[slot]);
+
+          size_t last = exp.slots.size() - 1;
+          if (slot != last) {
+            exp.slots[slot] = exp.slots[last];
+            exp.stamps[slot] = exp.stamps[last];
+            exp.positions[exp.slots[slot]] = slot;
+
+            lua_rawgeti(lua, table, (int)last + 1);
+            lua_rawseti(lua, table, (int)slot + 1);
+          }
+
+          lua_pushnil(lua);
+          lua_rawseti(lua, table, (int)last + 1);
+
+          exp.slots.pop_back();
+          exp.stamps.pop_back();
+        }
+
+        lua_pop(lua, 1); // the cache
         lua_setglobal(lua, out_table);
       }
+
+      /**
+       * Exposes the container as the global out_table without building any
+       * table: it's a proxy that looks elements up in the container as
+       * they're indexed, pushing them as usertypes of data_type.
+       *
+       * Proxies support indexing by position and the length operator, so
+       * they're iterated like so (ipairs() doesn't see through them):
+       * @code
+       *   for i = 1, #Entities do local entity = Entities[i] ... end
+       * @endcode
+       *
+       * The container must outlive the proxy; indexing is linear in the
+       * position for containers without random access, like std::list.
+       */
+      inline virtual void
+      proxy(lua_State* lua, T const& container, const char* data_type, const char* out_table)
+      {
+        *(T const**)lua_newuserdata(lua, sizeof(T const*)) = &container;
+
+        lua_createtable(lua, 0, 2);
+        lua_pushstring(lua, data_type);
+        pushCache(lua, data_type);
+        lua_pushcclosure(lua, &LuaExporter::proxyIndex, 2);
+        lua_setfield(lua, -2, "__index");
+        lua_pushcclosure(lua, &LuaExporter::proxyLength, 0);
+        lua_setfield(lua, -2, "__len");
+        lua_setmetatable(lua, -2);
+
+        lua_setglobal(lua, out_table);
+      }
+
+      /** Forgets about an export, leaving its global array be. */
+      inline virtual void
+      release(const char* out_table)
+      {
+        typename std::map<string_t, export_t>::iterator exp = mExports.find(out_table);
+        if (exp == mExports.end())
+          return;
+
+        luaL_unref(exp->second.lua, LUA_REGISTRYINDEX, exp->second.table);
+        mExports.erase(exp);
+      }
+
+      /** Forgets about all exports, for when their state is closed. */
+      inline virtual void
+      reset()
+      {
+        mExports.clear();
+      }
+
+    protected:
+      struct export_t {
+        lua_State*  lua;
+        int         table;      /** registry reference of the global array */
+        unsigned    generation; /** bumped on every export */
+
+        /** the objects by their position in the array, less one */
+        std::vector<const void*> slots;
+        /** the generation each slot was last seen in the container */
+        std::vector<unsigned> stamps;
+        std::unordered_map<const void*, size_t> positions;
+      };
+
+      std::map<string_t, export_t> mExports;
+
+      /** the export of the given name, built from scratch if it's new to the state */
+      export_t& getExport(lua_State* lua, const char* out_table)
+      {
+        export_t& exp = mExports[out_table];
+
+        if (exp.lua != lua || !exp.generation) {
+          exp = export_t();
+          exp.lua = lua;
+          exp.generation = 1;
+
+          lua_newtable(lua);
+          exp.table = luaL_ref(lua, LUA_REGISTRYINDEX);
+        }
+
+        return exp;
+      }
+
+      static int proxyIndex(lua_State* lua)
+      {
+        T const* container = *(T const**)lua_touserdata(lua, 1);
+
+        lua_Integer index = lua_isnumber(lua, 2) ? lua_tointeger(lua, 2) : 0;
+        if (index < 1 || (size_t)index > container->size()) {
+          lua_pushnil(lua);
+          return 1;
+        }
+
+        typename T::const_iterator cursor = container->begin();
+        std::advance(cursor, index - 1);
+
+        pushCached(lua, lua_upvalueindex(2), (void*)(*cursor), lua_tostring(lua, lua_upvalueindex(1)));
+        return 1;
+      }
+
+      static int proxyLength(lua_State* lua)
+      {
+        T const* container = *(T const**)lua_touserdata(lua, 1);
+        lua_pushinteger(lua, (lua_Integer)container->size());
+        return 1;
+      }
   };
 }
 
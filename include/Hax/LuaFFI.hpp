@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LUA_FFI_H
+#define H_HAX_LUA_FFI_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/Event.hpp"
+
+#include <vector>
+#include <stdint.h>
+
+extern "C" {
+	#include "lua.h"
+}
+
+/**
+ * A flat, read-only view of an Event that LuaJIT scripts can read through the
+ * FFI without crossing the C API: no tolua++ wrappers, no std::map lookups.
+ *
+ * The strings point straight into the Event's properties and aren't NUL
+ * terminated; a view is only valid while its Event is alive and unchanged.
+ *
+ * @warning
+ * Keep these in sync with the declarations in LuaFFI::CDef.
+ */
+extern "C" {
+  typedef struct {
+    const char* key;
+    uint32_t    key_length;
+    const char* value;
+    uint32_t    value_length;
+  } hax_property_t;
+
+  typedef struct {
+    uint8_t               uid;
+    uint8_t               options;
+    uint8_t               feedback;
+    uint32_t              length;
+    uint32_t              property_count;
+    const hax_property_t* properties;
+  } hax_event_t;
+}
+
+namespace Hax {
+
+  /**
+   * @class FlatEvent
+   *
+   * Owns the property array of a hax_event_t; reusing an instance across
+   * events doesn't allocate once the array is large enough.
+   */
+  class FlatEvent {
+  public:
+    FlatEvent();
+
+    /** Points the view at the given event's fields and properties. */
+    hax_event_t const* assign(const Event&);
+
+    hax_event_t const* get() const;
+
+  private:
+    hax_event_t                 mEvent;
+    std::vector<hax_property_t> mProperties;
+  };
+
+  namespace LuaFFI {
+
+    /** the ffi.cdef declarations of hax_event_t and hax_property_t */
+    extern const char* CDef;
+
+    /**
+     * Declares the types to the FFI and defines the helpers scripts use to
+     * read flat events, passed to them as light userdata:
+     *
+     * @code
+     *   function Hax.onEvent(ptr)
+     *     local evt = Hax.flatEvent(ptr)
+     *     if evt.uid == MY_EVENT then
+     *       local who = Hax.flatProperty(evt, "Entity")
+     *     end
+     *   end
+     * @endcode
+     *
+     * @return false if the state has no FFI, ie. isn't running on LuaJIT
+     */
+    bool open(lua_State*);
+  }
+
+} // namespace Hax
+
+#endif // H_HAX_LUA_FFI_H
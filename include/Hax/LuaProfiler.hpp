@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LUA_PROFILER_H
+#define H_HAX_LUA_PROFILER_H
+
+#include "Hax/Hax.hpp"
+
+#include <map>
+#include <vector>
+
+extern "C" {
+	#include "lua.h"
+}
+
+namespace Hax {
+
+  /**
+   * @class LuaProfiler
+   *
+   * A sampling profiler for a Lua state: every sample captures the Lua stack
+   * and puts the time since the previous sample down to it, so the totals
+   * approximate where the time went at a fraction of the cost of tracing
+   * every call.
+   *
+   * Like LuaWatchdog, the profiler is driven by the count hook of its owner
+   * which reports every firing with onCount(); see ScriptEngine's "Profile".
+   *
+   * Stacks are written in the folded format flamegraph.pl and speedscope
+   * read, one "outer;...;inner microseconds" line per distinct stack. Every
+   * frame is a "function@source:line", the line being the one the frame was
+   * running, so the flame graph attributes time to lines too.
+   */
+  class LuaProfiler {
+  public:
+    enum {
+      MaxDepth = 64  /** deeper frames are left out of the stacks */
+    };
+
+    LuaProfiler();
+    LuaProfiler(const LuaProfiler&) = delete;
+    LuaProfiler& operator=(const LuaProfiler&) = delete;
+    virtual ~LuaProfiler();
+
+    /**
+     * Forgets about any earlier samples and starts sampling, for the given
+     * duration or until stop() if it's 0.
+     */
+    void start(uint64_t lDurationNs);
+    void stop();
+
+    bool isRunning() const;
+
+    /** Has the duration passed to start() run out? */
+    bool isDue() const;
+
+    /**
+     * Marks the start of a stretch of Lua, so the time spent outside of Lua
+     * since the last sample isn't put down to the next one.
+     */
+    void resume();
+
+    /** Samples the stack the hook interrupted. */
+    void onCount(lua_State*, lua_Debug*);
+
+    /** How many samples were taken. */
+    uint64_t getSamples() const;
+
+    /** The time sampled in every source line, the most time consuming first. */
+    std::vector<std::pair<string_t, uint64_t>> getLines() const;
+
+    /** Writes the folded stacks to the given file, returns false if it couldn't. */
+    bool write(string_t const& path) const;
+
+  private:
+    bool      fRunning;
+    uint64_t  mDeadline;
+    uint64_t  mLastSample;
+    uint64_t  mSamples;
+
+    /** nanoseconds by folded stack, and by "source:line" */
+    std::map<string_t, uint64_t> mStacks;
+    std::map<string_t, uint64_t> mLines;
+
+    /** the stack being folded, reused across samples */
+    std::vector<string_t> mFrames;
+    string_t mStack;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_LUA_PROFILER_H
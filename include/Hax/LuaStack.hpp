@@ -0,0 +1,293 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LUA_STACK_H
+#define H_HAX_LUA_STACK_H
+
+#include "Hax/Hax.hpp"
+
+#include <string>
+#include <type_traits>
+
+extern "C" {
+	#include "lua.h"
+	#include "lauxlib.h"
+}
+
+#include "tolua++.h"
+
+namespace Hax {
+
+  /**
+   * Maps a C++ type to the name tolua++ bound it under; specialize it with
+   * HAX_LUA_USERTYPE for every type that's passed to Lua as a usertype.
+   */
+  template <typename T>
+  struct LuaUsertype;
+
+  /**
+   * Moving values between C++ and the Lua stack, with the conversion picked
+   * at compile time:
+   *
+   *  - booleans go through lua_pushboolean
+   *  - other arithmetic types through lua_pushnumber
+   *  - strings through lua_pushlstring
+   *  - pointers and references to HAX_LUA_USERTYPEs as tolua++ usertypes
+   *  - LuaStack::Ref as the registry value it refers to
+   *  - void pointers as light userdata
+   *
+   * Usertype metatables are looked up by name only the first time a type
+   * is pushed onto a state; they're then cached in the registry under a
+   * per-type light userdata key. The userdata themselves still go through
+   * tolua++'s ubox, see pushBoxed().
+   */
+  namespace LuaStack {
+
+    /** the per-type registry key the cached metatable is stored under */
+    template <typename T>
+    struct MetatableKey {
+      static char key;
+    };
+
+    template <typename T>
+    char MetatableKey<T>::key = 0;
+
+    /**
+     * Pushes the userdata boxing object, given the metatable of its type at
+     * the top of the stack, the way tolua_pushusertype does: userdata are
+     * kept in tolua++'s weak-valued ubox, so pushing the same object twice
+     * yields the same userdata, and its metatable is only swapped for a
+     * less derived one when tolua++ doesn't know the type to be a base.
+     */
+    inline void pushBoxed(lua_State* lua, void* object, const char* name) {
+      int mt = lua_gettop(lua);
+
+      lua_pushstring(lua, "tolua_ubox");
+      lua_rawget(lua, mt);
+      if (lua_isnil(lua, -1)) {
+        lua_pop(lua, 1);
+        lua_pushstring(lua, "tolua_ubox");
+        lua_rawget(lua, LUA_REGISTRYINDEX);
+      }
+
+      if (lua_isnil(lua, -1)) {
+        // no ubox to share with tolua++, keep a weak-valued one of our own
+        lua_pop(lua, 1);
+        lua_newtable(lua);
+        lua_newtable(lua);
+        lua_pushstring(lua, "__mode");
+        lua_pushstring(lua, "v");
+        lua_rawset(lua, -3);
+        lua_setmetatable(lua, -2);
+        lua_pushstring(lua, "tolua_ubox");
+        lua_pushvalue(lua, -2);
+        lua_rawset(lua, mt);
+      }
+
+      // stack: mt ubox
+      lua_pushlightuserdata(lua, object);
+      lua_rawget(lua, -2);
+
+      if (lua_isnil(lua, -1)) {
+        lua_pop(lua, 1);
+        *(void**)lua_newuserdata(lua, sizeof(void*)) = object;
+        lua_pushlightuserdata(lua, object);
+        lua_pushvalue(lua, -2);
+        lua_rawset(lua, -4);
+        lua_pushvalue(lua, mt);
+        lua_setmetatable(lua, -2);
+      }
+      else if (lua_getmetatable(lua, -1)) {
+        // stack: mt ubox ud udmt
+        if (!lua_rawequal(lua, -1, mt)) {
+          bool derived = false;
+
+          lua_pushstring(lua, "tolua_super");
+          lua_rawget(lua, LUA_REGISTRYINDEX);
+          if (lua_istable(lua, -1)) {
+            lua_pushvalue(lua, -2);
+            lua_rawget(lua, -2);
+            if (lua_istable(lua, -1)) {
+              lua_getfield(lua, -1, name);
+              derived = lua_toboolean(lua, -1);
+              lua_pop(lua, 1);
+            }
+            lua_pop(lua, 1);
+          }
+          lua_pop(lua, 1);
+
+          if (!derived) {
+            lua_pushvalue(lua, mt);
+            lua_setmetatable(lua, -3);
+          }
+        }
+        lua_pop(lua, 1);
+      }
+
+      // stack: mt ubox ud
+      lua_replace(lua, mt);
+      lua_pop(lua, 1);
+    }
+
+    template <typename T>
+    void pushUsertype(lua_State* lua, T* object) {
+      typedef typename std::remove_cv<T>::type type_t;
+
+      if (!object) {
+        lua_pushnil(lua);
+        return;
+      }
+
+      lua_pushlightuserdata(lua, &MetatableKey<type_t>::key);
+      lua_rawget(lua, LUA_REGISTRYINDEX);
+
+      if (lua_isnil(lua, -1)) {
+        // first time around: let tolua++ push it, then cache its metatable
+        lua_pop(lua, 1);
+        tolua_pushusertype(lua, (void*)object, LuaUsertype<type_t>::name());
+
+        lua_pushlightuserdata(lua, &MetatableKey<type_t>::key);
+        if (lua_getmetatable(lua, -2))
+          lua_rawset(lua, LUA_REGISTRYINDEX);
+        else
+          lua_pop(lua, 1);
+
+        return;
+      }
+
+      pushBoxed(lua, (void*)object, LuaUsertype<type_t>::name());
+    }
+
+    /** a value held in the Lua registry by luaL_ref, pushed as that value */
+    struct Ref {
+      explicit Ref(int inRef) : ref(inRef) { }
+      int ref;
+    };
+
+    inline void push(lua_State* lua, Ref const& value) {
+      lua_rawgeti(lua, LUA_REGISTRYINDEX, value.ref);
+    }
+
+    inline void push(lua_State* lua, const void* value) {
+      lua_pushlightuserdata(lua, (void*)value);
+    }
+
+    inline void push(lua_State* lua, bool value) {
+      lua_pushboolean(lua, value);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type
+    push(lua_State* lua, T value) {
+      lua_pushnumber(lua, (lua_Number)value);
+    }
+
+    inline void push(lua_State* lua, const char* value) {
+      lua_pushstring(lua, value);
+    }
+
+    inline void push(lua_State* lua, char* value) {
+      lua_pushstring(lua, value);
+    }
+
+    inline void push(lua_State* lua, std::string const& value) {
+      lua_pushlstring(lua, value.data(), value.size());
+    }
+
+    template <typename T>
+    void push(lua_State* lua, T* object) {
+      pushUsertype(lua, object);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_class<T>::value>::type
+    push(lua_State* lua, T const& object) {
+      pushUsertype(lua, &object);
+    }
+
+    inline void pushAll(lua_State*) {
+    }
+
+    template <typename T, typename... Rest>
+    void pushAll(lua_State* lua, T const& value, Rest const&... rest) {
+      push(lua, value);
+      pushAll(lua, rest...);
+    }
+
+    /** pops the value at the top of the stack as a T */
+    template <typename T>
+    struct Pop {
+      static T pop(lua_State* lua) {
+        static_assert(std::is_arithmetic<T>::value, "can't pop this type off the Lua stack");
+
+        T value = (T)lua_tonumber(lua, -1);
+        lua_pop(lua, 1);
+        return value;
+      }
+    };
+
+    template <>
+    struct Pop<bool> {
+      static bool pop(lua_State* lua) {
+        bool value = lua_toboolean(lua, -1);
+        lua_pop(lua, 1);
+        return value;
+      }
+    };
+
+    template <>
+    struct Pop<std::string> {
+      static std::string pop(lua_State* lua) {
+        size_t length = 0;
+        const char* value = lua_tolstring(lua, -1, &length);
+        std::string result = value ? std::string(value, length) : std::string();
+        lua_pop(lua, 1);
+        return result;
+      }
+    };
+
+    template <>
+    struct Pop<void> {
+      static void pop(lua_State* lua) {
+        lua_pop(lua, 1);
+      }
+    };
+
+    template <typename T>
+    T pop(lua_State* lua) {
+      return Pop<T>::pop(lua);
+    }
+
+  } // namespace LuaStack
+} // namespace Hax
+
+/** Binds a C++ type to its tolua++ type name, use at global scope. */
+#define HAX_LUA_USERTYPE(type, type_name) \
+  namespace Hax { \
+    template <> \
+    struct LuaUsertype< type > { \
+      static const char* name() { return type_name; } \
+    }; \
+  }
+
+#endif // H_HAX_LUA_STACK_H
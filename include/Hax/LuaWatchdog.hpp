@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LUA_WATCHDOG_H
+#define H_HAX_LUA_WATCHDOG_H
+
+#include "Hax/Hax.hpp"
+
+#include <map>
+#include <vector>
+
+extern "C" {
+	#include "lua.h"
+}
+
+namespace Hax {
+
+  /**
+   * @class LuaWatchdog
+   *
+   * Keeps count of the instructions a Lua state runs, per call and per tick,
+   * against a budget for each, and of the time spent in every Lua function.
+   *
+   * The watchdog doesn't hook into the state itself; the owner installs a
+   * count hook firing every so many instructions and reports each firing
+   * with onCount(), aborting the running call when it says a budget has run
+   * out. See ScriptEngine's "Call Budget" and "Tick Budget".
+   *
+   * Function times are sampled: the time since the previous firing is put
+   * down to the function the hook interrupts.
+   */
+  class LuaWatchdog {
+  public:
+    enum Budget {
+      NoBudget = 0,
+      CallBudget,
+      TickBudget
+    };
+
+    struct function_t {
+      string_t  name;         /** "source:line", where it's defined */
+      uint64_t  instructions;
+      uint64_t  nanoseconds;
+    };
+
+    LuaWatchdog();
+    LuaWatchdog(const LuaWatchdog&) = delete;
+    LuaWatchdog& operator=(const LuaWatchdog&) = delete;
+    virtual ~LuaWatchdog();
+
+    /** The budgets in instructions, 0 for none. */
+    void setBudgets(uint64_t lCallBudget, uint64_t lTickBudget);
+
+    /**
+     * Calls nest when Lua calls back into C++ which calls Lua again; only the
+     * outermost one is held to the call budget.
+     */
+    void beginCall();
+    void endCall();
+
+    /** Starts counting the next tick against the tick budget. */
+    void beginTick();
+
+    /**
+     * Reports a firing of the count hook, lInstructions since the previous
+     * one, and returns the budget that ran out or NoBudget.
+     *
+     * Once a budget has run out every firing reports it until the call ends,
+     * so scripts can't pcall their way past it.
+     */
+    Budget onCount(lua_State*, lua_Debug*, int lInstructions);
+
+    /** Has the tick budget run out? Calls made until the next tick are refused. */
+    bool isTickSpent() const;
+
+    /** The budget the last call ran out of, NoBudget if it didn't. */
+    Budget getExceeded() const;
+
+    /** The functions sampled so far, the most time consuming first. */
+    std::vector<function_t> getFunctions() const;
+
+    /** Forgets about the sampled functions. */
+    void resetFunctions();
+
+  private:
+    uint64_t  mCallBudget;
+    uint64_t  mTickBudget;
+    uint64_t  mCallCount;
+    uint64_t  mTickCount;
+    int       mDepth;
+    Budget    mExceeded;
+
+    /** when the hook last fired, or the outermost call began */
+    uint64_t  mLastSample;
+
+    std::map<string_t, function_t> mFunctions;
+
+    /** the name of the sampled function, reused across firings */
+    string_t  mName;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_LUA_WATCHDOG_H
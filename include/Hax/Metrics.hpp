@@ -0,0 +1,175 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_METRICS_H
+#define H_HAX_METRICS_H
+
+#include "Hax/Hax.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <functional>
+
+namespace Hax {
+
+  /**
+   * @class Counter
+   *
+   * A monotonically increasing count, sharded over a handful of cache lines
+   * so that threads bumping the same counter rarely contend; reading it sums
+   * the shards.
+   */
+  class Counter {
+  public:
+    enum {
+      Shards = 16
+    };
+
+    Counter();
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    inline void inc(uint64_t n = 1) {
+      mShards[getShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+  private:
+    struct shard_t {
+      std::atomic<uint64_t> value;
+      char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    /** every thread is assigned a shard the first time it bumps a counter */
+    static unsigned getShard();
+
+    shard_t mShards[Shards];
+  };
+
+  /**
+   * @class Gauge
+   *
+   * A value that can go up and down, like a queue depth.
+   */
+  class Gauge {
+  public:
+    Gauge();
+    Gauge(const Gauge&) = delete;
+    Gauge& operator=(const Gauge&) = delete;
+
+    inline void set(int64_t v) { mValue.store(v, std::memory_order_relaxed); }
+    inline void add(int64_t n = 1) { mValue.fetch_add(n, std::memory_order_relaxed); }
+    inline void sub(int64_t n = 1) { mValue.fetch_sub(n, std::memory_order_relaxed); }
+
+    inline int64_t value() const { return mValue.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> mValue;
+  };
+
+  /**
+   * @class Histogram
+   *
+   * An HDR-style histogram of unsigned values (normally nanoseconds) using
+   * log-linear buckets: every power of two is split into 2^SubBucketBits
+   * linear buckets, so any recorded value is off by at most 1/16th of itself
+   * while the whole 64-bit range fits in under a thousand buckets.
+   *
+   * Recording is a couple of relaxed atomic increments and never allocates.
+   */
+  class Histogram {
+  public:
+    enum {
+      SubBucketBits = 4,
+      SubBuckets = 1 << SubBucketBits,
+      Buckets = (64 - SubBucketBits + 1) * SubBuckets
+    };
+
+    /**
+     * @param unit what a recorded value is worth when exported, e.g. 1e-9 for
+     * values recorded in nanoseconds and exported in seconds
+     */
+    explicit Histogram(double unit = 1e-9);
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    inline void record(uint64_t value) {
+      mBuckets[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+      mCount.fetch_add(1, std::memory_order_relaxed);
+      mSum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const;
+
+    /** the sum of the recorded values, in units */
+    double sum() const;
+
+    /** the value (in units) at the given quantile, e.g. 0.99 */
+    double quantile(double q) const;
+
+    double getUnit() const;
+
+    static unsigned getBucket(uint64_t value);
+
+    /** the highest value that falls into the bucket */
+    static uint64_t getBucketCeiling(unsigned bucket);
+
+  private:
+    double mUnit;
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mSum;
+    std::atomic<uint64_t> mBuckets[Buckets];
+  };
+
+  /**
+   * Records the time between its construction and destruction, in
+   * nanoseconds, into a histogram.
+   */
+  class ScopedTimer {
+  public:
+    inline explicit ScopedTimer(Histogram& histogram)
+    : mHistogram(histogram),
+      mStart(std::chrono::steady_clock::now())
+    {
+    }
+
+    inline ~ScopedTimer() {
+      mHistogram.record(elapsed());
+    }
+
+    /** nanoseconds since construction */
+    inline uint64_t elapsed() const {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - mStart).count();
+    }
+
+  private:
+    Histogram& mHistogram;
+    std::chrono::steady_clock::time_point mStart;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_METRICS_H
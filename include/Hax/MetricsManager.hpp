@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_METRICS_MANAGER_H
+#define H_HAX_METRICS_MANAGER_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/Logger.hpp"
+#include "Hax/Configurable.hpp"
+#include "Hax/Metrics.hpp"
+
+#include <map>
+#include <memory>
+#include <boost/thread.hpp>
+
+namespace Hax {
+
+  /**
+   * @class MetricsManager
+   *
+   * A registry of named counters, gauges and histograms that subsystems use to
+   * expose their runtime state, and that can be dumped in the Prometheus text
+   * exposition format.
+   *
+   * Metrics are registered once, normally when the owning object is built,
+   * and the returned references are kept and updated directly; registering a
+   * name that's already taken returns the existing metric. Names may carry a
+   * label set, e.g. "hax_event_parse_errors_total{type=\"bad_length\"}";
+   * metrics sharing a name are dumped as one family.
+   *
+   * Histograms are dumped as summaries (0.5, 0.9, 0.99 and 0.999 quantiles).
+   *
+   * The MetricsManager subscribes to the "Metrics" configuration context:
+   *  "Dump File": where the metrics are periodically written to, the file is
+   *               replaced atomically so it can be scraped at any time
+   *               (e.g. by node_exporter's textfile collector); empty disables
+   *               dumping, default: ""
+   *  "Dump Interval": default: 15s
+   */
+  class MetricsManager : public Logger, public Configurable {
+  public:
+
+    static MetricsManager& getSingleton();
+
+    virtual ~MetricsManager();
+    MetricsManager(const MetricsManager&) = delete;
+    MetricsManager& operator=(const MetricsManager&) = delete;
+
+    Counter&    counter(string_t const& name, string_t const& help);
+    Gauge&      gauge(string_t const& name, string_t const& help);
+    Histogram&  histogram(string_t const& name, string_t const& help, double unit = 1e-9);
+
+    /**
+     * Registers a metric whose value is computed when it's dumped; type is
+     * either "counter" or "gauge".
+     */
+    void callback(
+      string_t const& name,
+      string_t const& help,
+      string_t const& type,
+      std::function<double()> value);
+
+    /** Writes all the metrics to the stream in Prometheus text format. */
+    void dump(std::ostream&);
+
+    /** Writes the metrics to a temporary file then moves it over the path. */
+    bool dump(string_t const& path);
+
+    /** (Re)starts the dump thread based on the current settings. */
+    virtual void configure();
+
+    /** Stops the dump thread, writing the metrics one last time. */
+    void shutdown();
+
+  private:
+    explicit MetricsManager();
+    static MetricsManager* __instance;
+
+    struct metric_t {
+      string_t  help;
+      string_t  type;
+      std::unique_ptr<Counter>    counter;
+      std::unique_ptr<Gauge>      gauge;
+      std::unique_ptr<Histogram>  histogram;
+      std::function<double()>     callback;
+    };
+
+    typedef std::map<string_t, metric_t> metrics_t;
+
+    metric_t& getOrCreate(string_t const& name, string_t const& help, string_t const& type);
+
+    /** the dump thread */
+    void run(string_t path, uint64_t interval);
+
+    metrics_t       mMetrics;
+    boost::mutex    mMutex;
+    boost::thread   *mDumper;
+
+    struct config_t {
+      string_t DumpFile;
+      uint64_t DumpInterval;
+    } mConfig;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_METRICS_MANAGER_H
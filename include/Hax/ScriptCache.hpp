@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_SCRIPT_CACHE_H
+#define H_HAX_SCRIPT_CACHE_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/Logger.hpp"
+#include "Hax/Metrics.hpp"
+
+extern "C" {
+	#include "lua.h"
+}
+
+namespace Hax {
+
+  /**
+   * @class ScriptCache
+   *
+   * Keeps the compiled form of Lua scripts, as written by lua_dump(), in a
+   * directory so they needn't be lexed and compiled again on the next boot.
+   *
+   * Every entry is named after its script's path and records the script's
+   * modification time, size, and CRC-32, along with the Lua flavour it was
+   * compiled by; an entry is only used when all of them still match, so
+   * editing a script, or switching between Lua and LuaJIT, simply causes it
+   * to be compiled and cached again.
+   */
+  class ScriptCache : public Logger {
+  public:
+
+    /** The directory is created if it doesn't exist. */
+    explicit ScriptCache(string_t const& directory);
+    ScriptCache(const ScriptCache&) = delete;
+    ScriptCache& operator=(const ScriptCache&) = delete;
+    virtual ~ScriptCache();
+
+    /**
+     * Loads the script at path as a Lua chunk onto the stack, like
+     * luaL_loadfile(), off the cache when it's fresh. Otherwise the script
+     * is compiled and the cache entry (re)written.
+     *
+     * @return 0 on success, or a lua_load() error code with the message
+     * pushed onto the stack instead
+     */
+    int load(lua_State*, string_t const& path);
+
+    /**
+     * Compiles the script at path into the cache without running it, for
+     * precompiling scripts at packaging time; see hax-luac.
+     *
+     * @return false if the script couldn't be read, compiled, or cached
+     */
+    bool compile(lua_State*, string_t const& path);
+
+    /** Where the entry of the given script is kept. */
+    string_t getEntryPath(string_t const& path) const;
+
+  protected:
+    /** writes the compiled chunk at the top of the stack to the entry */
+    bool store(lua_State*, string_t const& path, string_t const& header);
+
+    string_t mDirectory;
+
+    Counter *mHits;
+    Counter *mMisses;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_SCRIPT_CACHE_H
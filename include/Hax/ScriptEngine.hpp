@@ -28,16 +28,32 @@
 #include "Hax/Logger.hpp"
 #include "Hax/EventListener.hpp"
 #include "Hax/Configurable.hpp"
+#include "Hax/LiveConfig.hpp"
+#include "Hax/Metrics.hpp"
+#include "Hax/LuaStack.hpp"
+#include "Hax/LuaFFI.hpp"
+
+#include <map>
+#include <vector>
+#include <bitset>
 
 // Lua
 extern "C" {
 	#include "lua.h"
 	#include "lualib.h"
+	#include "lauxlib.h"
 }
 
 #include "tolua++.h"
 
+HAX_LUA_USERTYPE(Hax::Event, "Hax::Event")
+
 namespace Hax {
+
+  class ScriptCache;
+  class LuaAllocator;
+  class LuaWatchdog;
+  class LuaProfiler;
   
 	/**
    * @class ScriptEngine
@@ -53,7 +69,15 @@ namespace Hax {
     public Configurable {
 	public:
 
-    ScriptEngine();
+    /**
+     * @param contexts
+     * The configuration contexts to subscribe to.
+     *
+     * @param attached
+     * Whether to bind to the EventManager; detached engines only see the
+     * events handed to them, like the states of a ScriptPool.
+     */
+    explicit ScriptEngine(std::vector<string_t> contexts = { "Script Engine" }, bool attached = true);
     ScriptEngine(const ScriptEngine& src) = delete;
     ScriptEngine& operator=(const ScriptEngine& rhs) = delete;
 		virtual ~ScriptEngine();
@@ -73,42 +97,118 @@ namespace Hax {
     /** Destroys the Lua state. */
 		virtual bool cleanup();
 
+    /**
+     * Spends up to the given budget, capped by "GC Idle Budget", on
+     * incremental garbage collection steps; see collectGarbage().
+     */
+    virtual void idle(uint64_t lBudgetNs);
+
+    /**
+     * Runs incremental garbage collection steps until the cycle completes or
+     * the budget runs out, so less of the collection is left for the steps
+     * Lua takes as it allocates in the middle of a tick.
+     */
+    void collectGarbage(uint64_t lBudgetNs);
+
     /** 
      * Loads and runs a Lua script found at the given path.
      *
+     * When "Bytecode Cache" names a directory, scripts are loaded off their
+     * compiled form in there whenever it's fresh; see ScriptCache.
+     *
      * Throws an exception of type Hax::ScriptError if the script
      * could not be loaded.
      */
 		void runScript(string_t const& inScriptPath);
 
     /**
-     * Invokes a Lua method called inFunc with the given argument set.
+     * A Lua function pinned in the Lua registry, see getCallback(). Invoking
+     * one is a lua_rawgeti and a lua_pcall, no name lookups involved.
+     */
+    typedef int callback_t;
+    enum { NoCallback = -1 };
+
+    /**
+     * Resolves a global Lua function by its dotted path, like "Hax.onEvent",
+     * and returns a handle to it. Asking for the same path again returns the
+     * same handle.
      *
-     * Argument passing should be done in pairs for every argument: its type
-     * as a string, then a pointer to the actual argument. 
+     * Handles stay valid for the engine's lifetime: they're re-resolved after
+     * every runScript() so scripts can (re)define their functions at any time.
+     * Invoking a handle whose function isn't defined fails with an error.
+     */
+    callback_t getCallback(string_t const& path);
+
+    /**
+     * Calls a Lua function with the given arguments and returns its result
+     * as an R, or R() if the call failed; R may be void.
      *
-     * For example, to pass 1 argument of type "Hax::Object" to the function "Greet":
-     * @code 
-     *   passToLua("Greet", 1, "Hax::Object", &my_object);
+     * The arguments are pushed according to their types, see LuaStack:
+     * numbers and strings as such, pointers and references to types bound
+     * with HAX_LUA_USERTYPE as tolua++ usertypes.
      *
-     * An exception of type ScriptError will be thrown if the specified
-     * method could not be found, or there was a problem invoking it.
+     * For example, to pass a Hax::Object to the Lua function "Greet":
+     * @code
+     *   callback_t greet = getCallback("Greet");
+     *   bool greeted = call<bool>(greet, my_object, "Hello");
+     * @endcode
      *
-     * @remarks
-     * The actual invocation is done by a "router" method called Hax.arbitrator
-     * that does the job of locating a method and passing the arguments in a
-     * manner Lua understands.
+     * Errors raised by the function are handled according to the
+     * "Error Handling" setting, see onError().
+     */
+    template <typename R, typename... Args>
+    R call(callback_t callback, Args const&... args) {
+      if (!pushCallback(callback))
+        return R();
+
+      LuaStack::pushAll(mLuaState, args...);
+
+      if (!callLua(sizeof...(Args)))
+        return R();
+
+      return LuaStack::pop<R>(mLuaState);
+    }
+
+    /** Like call() above, resolving the function with getCallback() first. */
+    template <typename R, typename... Args>
+    R call(string_t const& path, Args const&... args) {
+      return call<R>(getCallback(path), args...);
+    }
+
+    /**
+     * Whether events of the given UID are passed to Lua at all; they all are
+     * by default. Events that are filtered out never cross into Lua.
      *
-     * @return whatever the Lua method returns as boolean
+     * Scripts may also define a "Hax.EventFilter" array of the UIDs they
+     * handle; when they do, it replaces the filter after every runScript().
      */
-    virtual bool passToLua(const char* inFunc, int argc, ...);
+    void filterEvent(EventUID_T, bool wanted);
 
     /** The underlying Lua state. */
     lua_State* getLuaState();
 
-    /** Overriden from Hax::Configurable. */
-    virtual void setOption(string_t const&, string_t const&);
-    virtual void setDefaults();
+    /** The instruction counts, and the time spent in each Lua function. */
+    LuaWatchdog const& getWatchdog() const;
+
+    /**
+     * The sampling profiler, which is turned on and off at runtime by setting
+     * "Profile" to "True" and back to "False". It stops by itself after
+     * "Profile Duration" seconds, 30 by default or none if 0, and writes the
+     * folded stacks it sampled to "Profile Output"; detached engines, like
+     * the states of a ScriptPool, append their UID to the file name.
+     *
+     * A sample is taken every "Profile Interval" instructions, 10000 by
+     * default; see LuaProfiler.
+     */
+    LuaProfiler const& getProfiler() const;
+
+    /**
+     * Publishes the parsed settings, overridden from Hax::Configurable.
+     *
+     * Settings can be changed while the engine is running; toggling
+     * "Intercept Events" binds or unbinds the Lua event handler.
+     */
+    virtual void configure();
 
   protected:
     lua_State* mLuaState;
@@ -119,9 +219,29 @@ namespace Hax {
      *
      * If you want to override this default behaviour, set "Intercept Events" to "False"
      * in the "Script Engine" configuration context.
+     *
+     * With "Batch Events" set to "True", events are instead collected during
+     * the tick and handed over at once on the next update(), as an array
+     * passed to "Hax.onEvents"; the array is a single table reused across
+     * ticks, so handlers shouldn't keep it or the events around.
+     *
+     * On LuaJIT builds, setting "FFI Events" to "True" passes events as
+     * light userdata pointing to a hax_event_t instead, for scripts to read
+     * through the FFI; see LuaFFI.
+     *
+     * An event whose call ran out of an instruction budget is done with:
+     * it's counted as dropped rather than retried. Events are only left
+     * pending, for the next tick, when the call was refused because the
+     * tick had already spent its budget.
      */
 		virtual bool passToLua(const Event& inEvt);
 
+    /** Passes the events batched since the last update() to Lua. */
+    void flushEvents();
+
+    /** Re-resolves all of the callbacks, and reloads the event filter. */
+    void resolveCallbacks();
+
     /**
      * Retrieves the error message from the Lua stack, then decides
      * what to do with it based on the "Error Handling" setting.
@@ -130,9 +250,18 @@ namespace Hax {
      *  When it is set to "Exception", an exception of type ScriptError will be thrown
      *  When it is set to "Notify", an Event with UID::LuaError will be hooked
      *  When it is set to "Die", an assert(false) will be forced (default)
+     *
+     * Calls that ran out of their "Call Budget" or "Tick Budget" are aborted
+     * by the count hook with a distinct error: it is thrown as a
+     * ScriptBudgetError, or hooked with a "Budget" property set to "Call" or
+     * "Tick". The state is left intact and stays in service; calls made after
+     * the tick budget ran out are refused until the next tick.
      **/
     virtual void onError();
 
+    /** onError() for calls aborted by the count hook */
+    virtual void onBudgetExceeded(string_t const& lError);
+
     enum {
       CATCH_AND_DIE = 0,
       CATCH_AND_THROW,
@@ -142,11 +271,133 @@ namespace Hax {
     /** Is the Lua state corrupt? */
     bool fCorruptState;
 
-    struct {
-      char ErrorHandling;
+    /** Does the engine own mLuaState, and thus close it on cleanup()? */
+    bool fOwnsState;
+
+    /** Is the engine bound to the EventManager? */
+    bool fAttached;
+
+    /** the compiled scripts, if "Bytecode Cache" is set */
+    ScriptCache* mScriptCache;
+
+    /** the allocator of an owned state, if "Pool Allocator" is set */
+    LuaAllocator* mAllocator;
+
+    /**
+     * The lua_Hook installed in the state, finding the engine through the
+     * registry; see armHooks().
+     */
+    static void onHook(lua_State*, lua_Debug*);
+
+    /**
+     * Installs the count hook if there's a budget set or the profiler is
+     * running, removes it otherwise. Only called between ticks.
+     */
+    void armHooks();
+
+    /** starts or stops the profiler as "Profile" and its duration say */
+    void updateProfiler();
+
+    /** counts instructions against "Call Budget" and "Tick Budget" */
+    LuaWatchdog* mWatchdog;
+    Counter   *mBudgetErrors;
+    Counter   *mRefusedCalls;
+    Counter   *mDroppedEvents;
+
+    /**
+     * Was the last call refused for the tick having spent its budget, or
+     * aborted for running out of a budget? Reset by pushCallback().
+     */
+    bool fRefused;
+    bool fAborted;
+
+    /** whether an event the handler failed on is done with, see passToLua() */
+    bool isConsumed();
+
+    /** samples the stacks while "Profile" is on */
+    LuaProfiler* mProfiler;
+    bool fProfileRequested;
+
+    /** applies the "GC Pause" and "GC Step Multiplier" settings */
+    void tuneGC();
+
+    /** reports the state's memory to the gauges below */
+    void updateMemoryMetrics();
+
+    Gauge     *mMemory;
+    Gauge     *mArena;
+    Histogram *mGCTime;
+    Counter   *mGCCycles;
+
+    /**
+     * Pushes the function of a callback onto the stack, or logs an error if
+     * it isn't defined.
+     */
+    bool pushCallback(callback_t);
+
+    /**
+     * Calls the function pushed by pushCallback() with argc arguments pushed
+     * after it, leaving its one result on the stack if it succeeded.
+     */
+    bool callLua(int argc);
+
+    /** Resolves the path of a callback into a fresh registry reference. */
+    void resolveCallback(callback_t);
+
+    /** the callback paths and their registry references, by handle */
+    std::vector<string_t> mCallbackPaths;
+    std::vector<int>      mCallbackRefs;
+    std::map<string_t, callback_t> mCallbacks;
+
+    /** "Hax.onEvent", "Hax.onEvents", and "Hax.update" */
+    callback_t mOnEvent;
+    callback_t mOnEvents;
+    callback_t mOnUpdate;
+
+    /** the UIDs passed to Lua, see filterEvent() */
+    std::bitset<256> mEventFilter;
+
+    /** are events passed as flat hax_event_t views? see LuaFFI */
+    bool fFlatEvents;
+    std::vector<FlatEvent> mFlatEvents;
+
+    /** events waiting for flushEvents(), and the table they're passed in */
+    std::vector<Event> mBatch;
+    size_t mBatchSize;
+    int    mBatchTable;
+    size_t mBatchTableSize;
+    Histogram *mBatchSizes;
+
+    /** call() metrics, see MetricsManager */
+    Histogram *mCallTime;
+    Counter   *mCallErrors;
+
+    struct config_t {
+      int  ErrorHandling;
       bool InterceptEvents;
       bool TickScript;
-    } mConfig;
+      bool BatchEvents;
+      bool FFIEvents;
+      string_t BytecodeCache;
+      bool     PoolAllocator;
+      int      GCPause;
+      int      GCStepMultiplier;
+      int      GCIdleBudget;
+      int      CallBudget;
+      int      TickBudget;
+      int      BudgetInterval;
+      bool     Profile;
+      int      ProfileDuration;
+      int      ProfileInterval;
+      string_t ProfileOutput;
+    };
+
+    /** The settings as they're being parsed, only the configuring thread touches these. */
+    config_t mConfig;
+
+    /** The published settings, these are safe to read from any thread. */
+    LiveConfig<config_t> mLiveConfig;
 	};
 }
+
 #endif
@@ -0,0 +1,149 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_SCRIPT_POOL_H
+#define H_HAX_SCRIPT_POOL_H
+
+#include "Hax/Engine.hpp"
+#include "Hax/Logger.hpp"
+#include "Hax/EventListener.hpp"
+#include "Hax/Configurable.hpp"
+
+#include <map>
+#include <vector>
+#include <exception>
+#include <boost/thread.hpp>
+
+namespace Hax {
+
+  class ScriptEngine;
+  class WorkerPool;
+
+  /**
+   * @class ScriptPool
+   *
+   * Runs scripts on a number of independent Lua states in parallel. Every
+   * state is a detached ScriptEngine loaded with the same scripts, and every
+   * update() ticks all of them at once on a WorkerPool.
+   *
+   * Events are routed by their "Route By" property, "Entity" by default:
+   * all of the events carrying the same key go to the same state, either the
+   * one the key is pin()ned to or the one its hash falls on. Events without
+   * the property are handed to every state. A state hands its events to Lua
+   * in order, and keeps the first one it isn't done with (see
+   * ScriptEngine::passToLua()), along with the ones behind it, for its next
+   * tick.
+   *
+   * States share nothing; scripts that need to talk to each other hook
+   * Events onto the EventManager, which routes them on the next tick.
+   *
+   * The ScriptPool subscribes to the "Script Pool" configuration context;
+   * settings it doesn't know about are passed on to its ScriptEngines, so
+   * "Error Handling", "Batch Events", and friends can be set there too.
+   */
+  class ScriptPool
+  : public Engine,
+    public EventListener,
+    public Logger,
+    public Configurable {
+  public:
+
+    ScriptPool();
+    ScriptPool(const ScriptPool&) = delete;
+    ScriptPool& operator=(const ScriptPool&) = delete;
+    virtual ~ScriptPool();
+
+    /** Builds the Lua states and the workers. */
+    virtual bool setup();
+
+    /**
+     * Routes the pending events, then updates every state in parallel and
+     * waits for them. An exception raised by any state, like a ScriptError,
+     * is rethrown here once all of them are done.
+     */
+    virtual void update(unsigned long lTimeElapsed);
+
+    /** Destroys the Lua states and the workers. */
+    virtual bool cleanup();
+
+    /** Shares the idle budget out between the states, see ScriptEngine::idle(). */
+    virtual void idle(uint64_t lBudgetNs);
+
+    /** Runs the script in every state, see ScriptEngine::runScript(). */
+    void runScript(string_t const& inScriptPath);
+
+    /** Routes the events carrying the given key to a specific state. */
+    void pin(string_t const& key, size_t state);
+
+    /** The state the events carrying the given key are routed to. */
+    size_t getState(string_t const& key) const;
+
+    /** How many Lua states there are. */
+    size_t size() const;
+
+    /** One of the states, to bind functions into or export data to. */
+    ScriptEngine& getEngine(size_t state);
+
+    /**
+     * Settings meant for the ScriptEngines; once the states are set up they
+     * are applied to them right away, so "Profile" and the budgets can be
+     * changed while the pool is running.
+     */
+    virtual void setOption(string_t const& key, string_t const& value);
+
+    /** Publishes the settings passed on to the states, see ScriptEngine::configure(). */
+    virtual void configure();
+
+  protected:
+    class Shard;
+
+    /** the EventListener handler that queues events in the shards' inboxes */
+    bool route(const Event&);
+
+    /** the job running a shard's tick */
+    void run(Shard*, unsigned long lTimeElapsed);
+
+    std::vector<Shard*> mShards;
+    WorkerPool *mWorkers;
+
+    std::map<string_t, size_t> mPins;
+
+    /** settings meant for the ScriptEngines, applied to each one on setup() */
+    std::vector<std::pair<string_t, string_t>> mEngineOptions;
+
+    /** the running tick */
+    size_t mInFlight;
+    boost::mutex mInFlightMutex;
+    boost::condition_variable mShardsDone;
+    std::exception_ptr mError;
+
+    struct config_t {
+      int      States;
+      int      Workers;
+      string_t RouteBy;
+    } mConfig;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_SCRIPT_POOL_H
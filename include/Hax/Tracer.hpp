@@ -0,0 +1,165 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_TRACER_H
+#define H_HAX_TRACER_H
+
+#include "Hax/Hax.hpp"
+#include "Hax/Logger.hpp"
+#include "Hax/Configurable.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <boost/thread.hpp>
+
+namespace Hax {
+
+  /**
+   * @class Tracer
+   *
+   * Records timed scopes into per-thread ring buffers and exports them in the
+   * Chrome trace event format, which loads in chrome://tracing and Perfetto.
+   *
+   * Tracing is meant to be left on in production as a flight recorder: every
+   * thread keeps its most recent spans, older ones are overwritten, and the
+   * last "Window" seconds of all threads are written out on demand through
+   * dump(), or when the process receives SIGUSR2.
+   *
+   * Spans are recorded using the HAX_TRACE_SCOPE("name") macro, the name must
+   * be a string literal (only the pointer is kept). A span costs two clock
+   * reads and a few relaxed stores when tracing is on, and a single relaxed
+   * load when it's off. Building with HAX_TRACING undefined (the CMake
+   * HAX_TRACING option) compiles the spans out entirely.
+   *
+   * The Tracer subscribes to the "Tracer" configuration context:
+   *  "Enabled": default: false
+   *  "Window": how far back dumps go, default: 10s
+   *  "Ring Size": spans kept per thread, default: 16384
+   *  "Dump Directory": where SIGUSR2 dumps go, default: "."
+   *  "Dump On Signal": whether SIGUSR2 triggers a dump, default: true
+   */
+  class Tracer : public Logger, public Configurable {
+  public:
+
+    static Tracer& getSingleton();
+
+    virtual ~Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /** Turns recording on or off at runtime. */
+    static void setEnabled(bool);
+
+    static inline bool isEnabled() {
+      return gEnabled.load(std::memory_order_relaxed);
+    }
+
+    /** Nanoseconds since the tracer's epoch. */
+    static inline uint64_t now() {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - gEpoch).count();
+    }
+
+    /** Appends a finished span to the calling thread's ring. */
+    static void record(const char* name, uint64_t begin, uint64_t end);
+
+    /**
+     * A copy of the name that lives as long as the process, for spans named
+     * at runtime; asking for the same name again returns the same copy.
+     */
+    static const char* intern(string_t const& name);
+
+    /** Names the calling thread in the exported traces. */
+    static void setThreadName(const char* name);
+
+    /**
+     * Writes the spans of all threads that ended in the last window_seconds
+     * (0 for everything that's buffered) as a Chrome trace JSON object.
+     */
+    void dump(std::ostream&, uint64_t window_seconds);
+
+    /** Dumps the configured window into a file, returns false if it can't be written. */
+    bool dump(string_t const& path);
+
+    /** Applies the settings and (re)starts the signal watcher. */
+    virtual void configure();
+
+    /** Stops the signal watcher. */
+    void shutdown();
+
+  private:
+    explicit Tracer();
+    static Tracer* __instance;
+
+    /** polls for SIGUSR2 and dumps when it arrives */
+    void watch();
+
+    static std::atomic<bool> gEnabled;
+    static const std::chrono::steady_clock::time_point gEpoch;
+
+    boost::thread *mWatcher;
+
+    struct config_t {
+      bool      Enabled;
+      uint64_t  Window;
+      int       RingSize;
+      string_t  DumpDirectory;
+      bool      DumpOnSignal;
+    } mConfig;
+  };
+
+  /** Records the lifetime of the scope as a span; see HAX_TRACE_SCOPE. */
+  class TraceScope {
+  public:
+    inline explicit TraceScope(const char* name)
+    : mName(Tracer::isEnabled() ? name : 0),
+      mBegin(mName ? Tracer::now() : 0)
+    {
+    }
+
+    inline ~TraceScope() {
+      if (mName)
+        Tracer::record(mName, mBegin, Tracer::now());
+    }
+
+  private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char  *mName;
+    uint64_t    mBegin;
+  };
+
+} // namespace Hax
+
+#define HAX_TRACE_CONCAT_(a, b) a##b
+#define HAX_TRACE_CONCAT(a, b) HAX_TRACE_CONCAT_(a, b)
+
+#ifdef HAX_TRACING
+# define HAX_TRACE_SCOPE(name) Hax::TraceScope HAX_TRACE_CONCAT(__hax_trace_scope_, __LINE__)(name)
+#else
+# define HAX_TRACE_SCOPE(name)
+#endif
+
+#endif // H_HAX_TRACER_H
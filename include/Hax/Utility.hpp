@@ -27,6 +27,7 @@
 #include "Hax/Hax.hpp"
 
 #include <typeinfo>
+#include <algorithm>
 #include <sstream>
 #include <vector>
 #include <iostream>
@@ -401,6 +402,30 @@ namespace Utility {
     
     return true;
   }
+
+  /**
+   * 64-bit FNV-1a hash of a byte range; cheap and stable across runs and
+   * platforms, which makes it suitable for fingerprinting files on disk.
+   *
+   * Pass the result of a previous call as `seed` to hash a sequence of ranges.
+   */
+  inline static uint64_t
+  fnv1a_64(const char* data, size_t len, uint64_t seed = 14695981039346656037ULL)
+  {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < len; ++i) {
+      hash ^= (unsigned char)data[i];
+      hash *= 1099511628211ULL;
+    }
+
+    return hash;
+  }
+
+  inline static uint64_t
+  fnv1a_64(const string_t& str, uint64_t seed = 14695981039346656037ULL)
+  {
+    return fnv1a_64(str.data(), str.size(), seed);
+  }
 }
 }
 #endif
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_WORKER_POOL_H
+#define H_HAX_WORKER_POOL_H
+
+#include "Hax/Hax.hpp"
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <boost/thread.hpp>
+
+namespace Hax {
+
+  /**
+   * @class WorkerPool
+   *
+   * A fixed set of threads running submitted jobs. Every worker owns a
+   * deque of jobs: jobs submitted from a worker go onto its own deque and
+   * are run newest-first, while idle workers steal the oldest jobs off the
+   * others. Jobs submitted from outside the pool are spread round-robin.
+   *
+   * No ordering is guaranteed between jobs; callers that need some (like
+   * the EventManager keeping each listener's events in order) must not
+   * have two dependent jobs in flight at once.
+   */
+  class WorkerPool {
+  public:
+    typedef std::function<void()> job_t;
+
+    /** Spawns the given number of worker threads. */
+    explicit WorkerPool(size_t workers);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /** Runs the pending jobs, then joins the workers. */
+    virtual ~WorkerPool();
+
+    /** Queues a job; with no workers it runs right away on the caller. */
+    void submit(job_t const&);
+
+    /**
+     * Steals and runs one pending job on the calling thread, so a thread
+     * waiting on the pool can lend a hand instead of blocking.
+     *
+     * @return false if there was nothing to run
+     */
+    bool help();
+
+    size_t size() const;
+
+  private:
+    struct queue_t {
+      boost::mutex      mutex;
+      std::deque<job_t> jobs;
+    };
+
+    void run(size_t index);
+
+    /** pops from the home queue's back, or steals from another's front */
+    bool take(size_t home, job_t&);
+
+    std::vector<queue_t*>       mQueues;
+    std::vector<boost::thread*> mWorkers;
+    std::atomic<size_t>         mNext;
+
+    boost::mutex                mMutex;
+    boost::condition_variable   mWakeup;
+    size_t                      mPending; /** guarded by mMutex */
+    bool                        fRunning;
+  };
+
+} // namespace Hax
+
+#endif // H_HAX_WORKER_POOL_H
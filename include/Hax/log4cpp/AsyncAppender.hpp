@@ -0,0 +1,203 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LOG4CPP_ASYNC_APPENDER_H
+#define H_HAX_LOG4CPP_ASYNC_APPENDER_H
+
+#include <log4cpp/Portability.hh>
+#include <log4cpp/AppenderSkeleton.hh>
+#include <log4cpp/LoggingEvent.hh>
+
+#include "Hax/log4cpp/LineAppenders.hpp"
+
+#include <atomic>
+#include <boost/thread.hpp>
+
+using namespace log4cpp;
+namespace Hax {
+
+  /**
+   * @class AsyncAppender
+   *
+   * Moves the formatting and writing of log records off the logging thread.
+   *
+   * Records are pushed into a bounded lock-free ring buffer by the callers and
+   * handed to the wrapped device appender by a dedicated writer thread, which
+   * drains everything that's pending before it goes back to sleep. The writer
+   * is the ring's only consumer and the only thread that touches the device;
+   * everything else that needs the device (flush(), close(), setLayout())
+   * asks the writer to drain or to pause.
+   *
+   * When the buffer is full, the overflow policy decides what happens:
+   *  Block: the caller waits until the writer makes room
+   *  Drop: the record is discarded
+   *  Count: the record is discarded and the writer periodically logs how many
+   *         records were lost
+   *
+   * @note
+   * The wrapped device is owned by the async appender and is destroyed with it;
+   * setLayout() is forwarded to the device while the writer is paused.
+   */
+  class LOG4CPP_EXPORT AsyncAppender : public AppenderSkeleton {
+  public:
+
+    enum OverflowPolicy {
+      Block = 0,
+      Drop,
+      Count
+    };
+
+    /**
+     * @param capacity the number of records the buffer can hold, rounded up to
+     * the next power of two, and capped at MaxCapacity
+     */
+    AsyncAppender(const std::string& name, Appender* device, size_t capacity, OverflowPolicy policy);
+    virtual ~AsyncAppender();
+
+    /** Drains the pending records then re-opens the device. */
+    virtual bool reopen();
+
+    /** Drains the pending records then closes the device. */
+    virtual void close();
+
+    virtual bool requiresLayout() const;
+    virtual void setLayout(Layout* layout);
+
+    /**
+     * Has the writer write out all the records pushed before the call, and
+     * waits for it to be done.
+     */
+    void flush();
+
+    /** The number of records discarded because the buffer was full. */
+    uint64_t getDropped() const;
+
+    /** Flushes every live AsyncAppender. */
+    static void flushAll();
+
+    /**
+     * Stops the writer of every live AsyncAppender and writes the records
+     * still pending straight to the device's file, one "category: message"
+     * line each, bypassing the layout; devices that aren't a
+     * LineFileAppender get them written to fallback_fd instead. Only
+     * async-signal-safe calls are made; this is what the crash handler does.
+     */
+    static void dumpAll(int fallback_fd);
+
+    /**
+     * Installs handlers for the fatal signals that dump the pending records,
+     * see dumpAll(), then hand the signal over to whatever handler was there
+     * before, or to its default course. Only the first call installs them.
+     */
+    static void installCrashHandler();
+
+    enum {
+      MaxCapacity = 1 << 20
+    };
+
+  protected:
+    virtual void _append(const LoggingEvent& event);
+
+  private:
+    struct record_t {
+      std::string     category;
+      std::string     message;
+      std::string     ndc;
+      Priority::Value priority;
+      TimeStamp       timestamp;
+    };
+
+    struct slot_t {
+      std::atomic<size_t> seq;
+      record_t            record;
+    };
+
+    enum {
+      MaxInstances = 8,
+      IdleWaitMs = 10,
+      DropReportIntervalMs = 5000,
+      CrashSpins = 1 << 20
+    };
+
+    bool push(const LoggingEvent& event);
+
+    /**
+     * writes the record at the head of the buffer, if any, to the device;
+     * only the writer calls this, or whoever is left once it's gone
+     */
+    bool pop();
+
+    /** pops until the buffer is empty or the process is crashing */
+    bool drain();
+
+    /** the writer thread */
+    void run();
+
+    /** parks the writer between two records, and lets it go */
+    void pause();
+    void resume();
+
+    /** see dumpAll() */
+    void dump(int fallback_fd);
+
+    void reportDropped();
+
+    Appender        *mDevice;
+    OverflowPolicy  mPolicy;
+
+    /** the device, if it writes to a file the crash dump can go to */
+    LineFileAppender *mFileDevice;
+
+    slot_t              *mSlots;
+    size_t              mMask;
+
+    // keep the producers' and the consumer's cursors on separate cache lines
+    char                mPad0[64];
+    std::atomic<size_t> mEnqueuePos;
+    char                mPad1[64];
+    std::atomic<size_t> mDequeuePos;
+    char                mPad2[64];
+
+    std::atomic<uint64_t> mDropped;
+    uint64_t              mReportedDropped;
+
+    boost::thread       *mWriter;
+    boost::mutex        mMutex;
+    boost::condition_variable mWakeup;  /** the writer waits on this */
+    boost::condition_variable mDone;    /** flush() and pause() wait on this */
+    std::atomic<bool>   fRunning;
+    std::atomic<bool>   fIdle;
+
+    /** guarded by mMutex */
+    bool                fPauseRequested;
+    bool                fPaused;
+
+    /** the writer is inside the device, and the process is going down */
+    std::atomic<bool>   fWriting;
+    std::atomic<bool>   fCrashed;
+
+    static std::atomic<AsyncAppender*> gInstances[MaxInstances];
+  };
+}
+
+#endif // H_HAX_LOG4CPP_ASYNC_APPENDER_H
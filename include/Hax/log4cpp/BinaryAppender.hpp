@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LOG4CPP_BINARY_APPENDER_H
+#define H_HAX_LOG4CPP_BINARY_APPENDER_H
+
+#include <log4cpp/Portability.hh>
+#include <log4cpp/AppenderSkeleton.hh>
+#include <log4cpp/LoggingEvent.hh>
+
+#include "Hax/log4cpp/BinaryLog.hpp"
+
+#include <cstdio>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+using namespace log4cpp;
+namespace Hax {
+
+  /**
+   * @class BinaryAppender
+   *
+   * Writes compact binary records to a file instead of formatted text; see
+   * BinaryLog for the format and the hax-logcat tool for turning a file back
+   * into text or JSON.
+   *
+   * Contexts and message format strings are interned in a string table that
+   * is written to the file the first time they're seen, after which a record
+   * costs a few bytes plus its numeric arguments. Once the table holds
+   * MaxFormats format strings, new messages are written literally.
+   *
+   * Like RollingFileAppender, the file is rotated to "<file>.1" once it grows
+   * past the given size; every file starts with its own header and table.
+   *
+   * @note
+   * Binary records carry no formatting, so the appender takes ownership of
+   * any layout it's given and ignores it. The file is flushed after records
+   * of ERROR priority or worse, and when closed.
+   */
+  class LOG4CPP_EXPORT BinaryAppender : public AppenderSkeleton {
+  public:
+    BinaryAppender(const std::string& name, const std::string& path, uint64_t max_size);
+    virtual ~BinaryAppender();
+
+    virtual bool reopen();
+    virtual void close();
+
+    virtual bool requiresLayout() const;
+    virtual void setLayout(Layout* layout);
+
+  protected:
+    virtual void _append(const LoggingEvent& event);
+
+  private:
+    enum {
+      MaxFormats = 1 << 16,
+      /* digit runs longer than this may not fit in 64 bits, they're kept as text */
+      MaxArgDigits = 19,
+      BufferSize = 64 * 1024
+    };
+
+    typedef std::unordered_map<std::string, uint32_t> table_t;
+
+    bool open();
+    void rotate();
+
+    /** interns the string, writing its definition if it's new */
+    uint32_t intern(std::string const& value);
+
+    /**
+     * Splits the message into mFormat and mArgs; returns false if it has to be
+     * written literally.
+     */
+    bool tokenize(std::string const& message);
+
+    std::string mPath;
+    uint64_t    mMaxSize;
+    uint64_t    mSize;
+    FILE        *mFile;
+    Layout      *mLayout;
+
+    table_t     mStrings;
+    uint32_t    mFormatCount;
+    uint64_t    mLastTimestamp;
+
+    /* reused between records to avoid allocating */
+    std::string           mBuffer;
+    std::string           mFormat;
+    std::vector<uint64_t> mArgs;
+
+    boost::mutex mMutex;
+  };
+}
+
+#endif // H_HAX_LOG4CPP_BINARY_APPENDER_H
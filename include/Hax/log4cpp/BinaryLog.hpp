@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LOG4CPP_BINARY_LOG_H
+#define H_HAX_LOG4CPP_BINARY_LOG_H
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace Hax {
+
+  /**
+   * The on-disk format written by BinaryAppender and read by hax-logcat.
+   *
+   * A file is a sequence of tagged entries, every integer is an unsigned LEB128
+   * varint (signed ones are zigzag encoded first):
+   *
+   *  'H' "AXL" version                     file header, resets the string table
+   *  'S' id length bytes                   defines a string table entry
+   *  'E' dt priority context format argc args...
+   *                                        a record whose message is the format
+   *                                        string with every Placeholder
+   *                                        replaced by the next argument
+   *  'L' dt priority context length bytes  a record with a literal message
+   *
+   * dt is the signed distance in nanoseconds from the previous record's
+   * timestamp (the first record of a file is relative to the epoch). The
+   * context and format ids refer to strings defined earlier in the file.
+   *
+   * Format strings are derived from the messages themselves: every run of
+   * decimal digits becomes a Placeholder and is stored as a binary argument,
+   * so messages that only differ in their numbers share a format string.
+   */
+  namespace BinaryLog {
+
+    static const char     Magic[] = "HAXL";
+    static const uint8_t  Version = 1;
+
+    /** stands for a numeric argument in a format string */
+    static const char     Placeholder = '\x1f';
+
+    enum {
+      TagHeader   = 'H',
+      TagString   = 'S',
+      TagEvent    = 'E',
+      TagLiteral  = 'L'
+    };
+
+    inline void putVarint(std::string& out, uint64_t v) {
+      while (v >= 0x80) {
+        out += (char)((v & 0x7f) | 0x80);
+        v >>= 7;
+      }
+      out += (char)v;
+    }
+
+    inline uint64_t zigzag(int64_t v) {
+      return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t v) {
+      return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    struct record_t {
+      uint64_t    timestamp;  /** nanoseconds since the epoch */
+      int         priority;
+      std::string context;
+      std::string message;
+    };
+
+    /**
+     * Decodes records out of a binary log stream. Concatenated files (e.g.
+     * a rotated log followed by the current one) are read as one.
+     */
+    class Reader {
+    public:
+      explicit Reader(std::istream&);
+
+      /**
+       * Decodes the next record into the given one; returns false at the end
+       * of the stream or if it's malformed, see getError().
+       */
+      bool next(record_t&);
+
+      /** empty unless next() stopped on a malformed stream */
+      std::string const& getError() const;
+
+    private:
+      bool readVarint(uint64_t&);
+      bool readString(std::string&);
+      bool readId(std::string const*&);
+      bool fail(const char* error);
+
+      std::istream&             mIn;
+      std::vector<std::string>  mStrings;
+      uint64_t                  mLastTimestamp;
+      bool                      fHeader;
+      std::string               mError;
+    };
+
+  }
+}
+
+#endif // H_HAX_LOG4CPP_BINARY_LOG_H
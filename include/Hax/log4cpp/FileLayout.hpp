@@ -25,22 +25,20 @@
 #define H_HAX_LOG4CPP_FILE_LAYOUT_H
 
 #include <log4cpp/Portability.hh>
-#include <log4cpp/Layout.hh>
+#include "Hax/log4cpp/LineLayout.hpp"
 #include <memory>
 
 using namespace log4cpp;
 namespace Hax {
 
-  class LOG4CPP_EXPORT FileLayout : public Layout {
+  /**
+   * Formats the message in style:<br>
+   * "HH:MM:SS [P] ndc: message"
+   **/
+  class LOG4CPP_EXPORT FileLayout : public LineLayout {
   public:
     FileLayout();
     virtual ~FileLayout();
-
-    /**
-     * Formats the message in style:<br>
-     * "timeStamp priority category ndc: message"
-     **/
-    virtual std::string format(const LoggingEvent& event);
   };
 }
 
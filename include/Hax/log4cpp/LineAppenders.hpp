@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LOG4CPP_LINE_APPENDERS_H
+#define H_HAX_LOG4CPP_LINE_APPENDERS_H
+
+#include <log4cpp/Portability.hh>
+#include <log4cpp/RollingFileAppender.hh>
+#include <log4cpp/OstreamAppender.hh>
+
+#include "Hax/log4cpp/LineLayout.hpp"
+
+using namespace log4cpp;
+namespace Hax {
+
+  /**
+   * @class LineFileAppender
+   *
+   * A RollingFileAppender that writes the lines of a LineLayout straight
+   * out of the layout's per-thread buffer using LineLayout::formatLine(),
+   * instead of the copy Layout::format() returns. Any other layout is
+   * handled like RollingFileAppender does.
+   */
+  class LOG4CPP_EXPORT LineFileAppender : public RollingFileAppender {
+  public:
+    LineFileAppender(const std::string& name, const std::string& fileName, size_t maxFileSize);
+    virtual ~LineFileAppender();
+
+    virtual void setLayout(Layout* layout);
+
+    /** The descriptor of the file, a plain read that's safe in a signal handler. */
+    inline int getFd() const { return _fd; }
+
+  protected:
+    virtual void _append(const LoggingEvent& event);
+
+    /** the layout, if it's a LineLayout */
+    LineLayout* mLineLayout;
+  };
+
+  /**
+   * @class LineStreamAppender
+   *
+   * The OstreamAppender counterpart of LineFileAppender.
+   */
+  class LOG4CPP_EXPORT LineStreamAppender : public OstreamAppender {
+  public:
+    LineStreamAppender(const std::string& name, std::ostream* stream);
+    virtual ~LineStreamAppender();
+
+    virtual void setLayout(Layout* layout);
+
+  protected:
+    virtual void _append(const LoggingEvent& event);
+
+    /** the layout, if it's a LineLayout */
+    LineLayout* mLineLayout;
+  };
+}
+
+#endif // H_HAX_LOG4CPP_LINE_APPENDERS_H
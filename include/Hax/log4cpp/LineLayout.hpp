@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LOG4CPP_LINE_LAYOUT_H
+#define H_HAX_LOG4CPP_LINE_LAYOUT_H
+
+#include <log4cpp/Portability.hh>
+#include <log4cpp/Layout.hh>
+#include <log4cpp/LoggingEvent.hh>
+#include <string>
+#include <time.h>
+
+using namespace log4cpp;
+namespace Hax {
+
+  /**
+   * @class LineLayout
+   *
+   * Base for the single-line Hax layouts, formats records in style:<br>
+   * "[HH:MM:SS ][P] ndc: message\n"
+   *
+   * Every thread formats into its own reusable buffer, so once the buffer has
+   * grown to fit the longest line no formatting allocates. The timestamp is
+   * kept per thread too and is only recomputed (using localtime_r) when the
+   * wall clock moves on to the next second.
+   *
+   * @note
+   * log4cpp::Layout::format() returns by value, so it has to copy the line out
+   * of the buffer; the file and stdout devices use formatLine() instead, see
+   * LineFileAppender.
+   */
+  class LOG4CPP_EXPORT LineLayout : public Layout {
+  public:
+    virtual ~LineLayout();
+
+    virtual std::string format(const LoggingEvent& event);
+
+    /**
+     * Formats the event into the calling thread's buffer and returns it; the
+     * reference is valid until the next formatLine() call from this thread.
+     */
+    const std::string& formatLine(const LoggingEvent& event);
+
+    /** length of the string returned by getTimestamp() */
+    static const size_t TimestampLength = 9;
+
+  protected:
+    explicit LineLayout(bool timestamp);
+
+    /**
+     * Returns "HH:MM:SS " for the given time, refreshed at most once a second
+     * per thread.
+     */
+    static const char* getTimestamp(time_t now);
+
+    bool fTimestamp;
+  };
+}
+
+#endif // END OF H_HAX_LOG4CPP_LINE_LAYOUT_H
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#ifndef H_HAX_LOG4CPP_RATE_LIMIT_FILTER_H
+#define H_HAX_LOG4CPP_RATE_LIMIT_FILTER_H
+
+#include <log4cpp/Portability.hh>
+#include <log4cpp/Filter.hh>
+#include <log4cpp/Appender.hh>
+#include <log4cpp/LoggingEvent.hh>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+using namespace log4cpp;
+namespace Hax {
+
+  /**
+   * @class RateLimitFilter
+   *
+   * Keeps a single logging context (the NDC of a Logger's category) from
+   * flooding the log device.
+   *
+   * Every context gets a token bucket that refills at a number of messages
+   * per second up to a burst size, and records that find the bucket empty are
+   * denied. Messages less severe than WARN can additionally be sampled, only
+   * 1 in N of them gets through.
+   *
+   * The number of suppressed messages per context is written to the reporting
+   * appender, if one is set, at most once per report interval; the report is
+   * sent along with the first record that's logged once the interval is up.
+   * Records of the "LogMgr" context, which the reports use, are never
+   * suppressed.
+   */
+  class LOG4CPP_EXPORT RateLimitFilter : public Filter {
+  public:
+
+    struct rule_t {
+      /** messages per second, 0 means unlimited */
+      double    rate;
+      /** the most messages that can go through at once, at least 1 */
+      double    burst;
+      /** keep 1 in N of the messages below WARN, 1 keeps all */
+      unsigned  sample;
+
+      inline rule_t() : rate(0), burst(0), sample(1) {}
+    };
+
+    RateLimitFilter();
+    virtual ~RateLimitFilter();
+
+    /** The rule for contexts that don't have their own. */
+    void setDefaultRule(rule_t const&);
+
+    void setRule(std::string const& context, rule_t const&);
+
+    /**
+     * Where the suppression reports go; the appender must outlive the filter,
+     * which is normally the case as the appender owns it.
+     */
+    void setReportAppender(Appender*, unsigned interval_seconds);
+
+  protected:
+    virtual Decision _decide(const LoggingEvent& event);
+
+  private:
+    typedef std::chrono::steady_clock steady_t;
+
+    struct state_t {
+      rule_t              rule;
+      double              tokens;
+      steady_t::time_point last_refill;
+      uint64_t            seen;
+      uint64_t            limited;
+      uint64_t            sampled;
+    };
+
+    typedef std::unordered_map<std::string, state_t> states_t;
+
+    state_t& getState(std::string const& context, steady_t::time_point now);
+
+    /** logs, and resets, the suppression counters; mMutex must NOT be held */
+    void report();
+
+    rule_t    mDefault;
+    std::unordered_map<std::string, rule_t> mRules;
+    states_t  mStates;
+
+    Appender  *mReportAppender;
+    steady_t::duration    mReportInterval;
+    steady_t::time_point  mNextReport;
+
+    boost::mutex mMutex;
+  };
+}
+
+#endif // H_HAX_LOG4CPP_RATE_LIMIT_FILTER_H
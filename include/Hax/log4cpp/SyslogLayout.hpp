@@ -25,7 +25,7 @@
 #define H_HAX_LOG4CPP_SYSLOG_LAYOUT_H
 
 #include <log4cpp/Portability.hh>
-#include <log4cpp/Layout.hh>
+#include "Hax/log4cpp/LineLayout.hpp"
 #include <log4cpp/Priority.hh>
 #include <memory>
 
@@ -34,18 +34,14 @@ namespace Hax {
 
   /**
    * Logs messages to Syslog.
+   *
+   * Same as FileLayout but without the timestamp, syslog stamps records itself.
    **/
-  class LOG4CPP_EXPORT SyslogLayout : public Layout {
+  class LOG4CPP_EXPORT SyslogLayout : public LineLayout {
   public:
     SyslogLayout();
     virtual ~SyslogLayout();
 
-    /**
-     * Formats the message in style:<br>
-     * "timeStamp priority category ndc: message"
-     **/
-    virtual std::string format(const LoggingEvent& event);
-
   protected:
   };
 }
@@ -22,6 +22,7 @@
  */
 
 #include "Hax/Archiver.hpp"
+#include "Hax/MetricsManager.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -189,6 +190,45 @@ namespace Hax {
   }
   static ICompressProgress g_ProgressCallback = { &OnProgress };
 
+  /** the metrics of one direction, "encode" or "decode" */
+  struct archiver_pass_metrics_t {
+    Counter   &bytes_in;
+    Counter   &bytes_out;
+    Histogram &time;
+    Gauge     &throughput;
+
+    archiver_pass_metrics_t(MetricsManager& metrics, string_t const& op)
+    : bytes_in(metrics.counter("hax_archiver_input_bytes_total{op=\"" + op + "\"}", "Bytes fed to the Archiver")),
+      bytes_out(metrics.counter("hax_archiver_output_bytes_total{op=\"" + op + "\"}", "Bytes produced by the Archiver")),
+      time(metrics.histogram("hax_archiver_seconds{op=\"" + op + "\"}", "Time spent in an Archiver pass")),
+      throughput(metrics.gauge("hax_archiver_throughput_bytes_per_second{op=\"" + op + "\"}", "Input bytes per second of the last Archiver pass"))
+    {
+    }
+
+    void record(uint64_t in, uint64_t out, uint64_t ns) {
+      bytes_in.inc(in);
+      bytes_out.inc(out);
+      time.record(ns);
+      if (ns)
+        throughput.set((int64_t)(in * 1000000000.0 / ns));
+    }
+  };
+
+  static archiver_pass_metrics_t& getEncodeMetrics() {
+    static archiver_pass_metrics_t metrics(MetricsManager::getSingleton(), "encode");
+    return metrics;
+  }
+
+  static archiver_pass_metrics_t& getDecodeMetrics() {
+    static archiver_pass_metrics_t metrics(MetricsManager::getSingleton(), "decode");
+    return metrics;
+  }
+
+  static uint64_t nanoseconds_since(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+
   int Archiver::encodeLzma(
     std::vector<unsigned char> &outBuf,
     const std::vector<unsigned char> &inBuf)
@@ -202,14 +242,17 @@ namespace Hax {
     props.dictSize = 1 << 16; // 64 KB
     props.writeEndMark = 1; // 0 or 1
 
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     int res = LzmaEncode(
       &outBuf[LZMA_PROPS_SIZE], &destLen,
       &inBuf[0], inBuf.size(),
       &props, &outBuf[0], &propsSize, props.writeEndMark,
       &g_ProgressCallback, &g_Alloc, &g_Alloc);
     assert(res == SZ_OK && propsSize == LZMA_PROPS_SIZE);
-    if (res == SZ_OK)
+    if (res == SZ_OK) {
       outBuf.resize(propsSize + destLen);
+      getEncodeMetrics().record(inBuf.size(), outBuf.size(), nanoseconds_since(start));
+    }
 
     return (res == SZ_OK && propsSize == LZMA_PROPS_SIZE) ? 1 : 0;
   }
@@ -224,12 +267,15 @@ namespace Hax {
     size_t srcLen = inBuf.size() - LZMA_PROPS_SIZE;
 
     std::cout << "decoding " << srcLen << "b of encoded data out to " << dstLen << " predicted raw bytes\n";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     SRes res = LzmaUncompress(
       &outBuf[0], &dstLen,
       &inBuf[LZMA_PROPS_SIZE], &srcLen,
       &inBuf[0], LZMA_PROPS_SIZE);
     assert(res == SZ_OK);
     outBuf.resize(dstLen); // If uncompressed data can be smaller
+    if (res == SZ_OK)
+      getDecodeMetrics().record(inBuf.size(), dstLen, nanoseconds_since(start));
     return res == SZ_OK ? 1 : 0;
   }
   Archiver::Archiver() {
@@ -255,8 +301,16 @@ namespace Hax {
     if (OutFile_Open(&outStream.file, dest) != 0)
       return PrintError(rs, "Can not open output file");
 
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     int res = Decode(&outStream.s, &inStream.s);
 
+    if (res == SZ_OK) {
+      UInt64 srcSize = 0, destSize = 0;
+      File_GetLength(&inStream.file, &srcSize);
+      File_GetLength(&outStream.file, &destSize);
+      getDecodeMetrics().record(srcSize, destSize, nanoseconds_since(start));
+    }
+
     File_Close(&outStream.file);
     File_Close(&inStream.file);
 
@@ -300,9 +354,13 @@ namespace Hax {
       srcSize = new UInt64();
     }
     File_GetLength(&inStream.file, srcSize);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     int res = Encode(&outStream.s, &inStream.s, *srcSize, rs);
     File_GetLength(&outStream.file, destSize);
 
+    if (res == SZ_OK)
+      getEncodeMetrics().record(*srcSize, *destSize, nanoseconds_since(start));
+
     File_Close(&outStream.file);
     File_Close(&inStream.file);
 
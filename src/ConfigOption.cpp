@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/ConfigOption.hpp"
+#include "Hax/Utility.hpp"
+
+#include <cassert>
+
+namespace Hax {
+
+  ConfigOption::ConfigOption(string_t const& name, Type type, void* field)
+  : mName(name),
+    mType(type),
+    mField(field),
+    fHasDefault(false)
+  {
+  }
+
+  ConfigOption::~ConfigOption()
+  {
+  }
+
+  string_t const& ConfigOption::getName() const
+  {
+    return mName;
+  }
+
+  ConfigOption::Type ConfigOption::getType() const
+  {
+    return mType;
+  }
+
+  ConfigOption& ConfigOption::defaultsTo(string_t const& value)
+  {
+    mDefault = value;
+    fHasDefault = true;
+
+    reset();
+
+    return *this;
+  }
+
+  ConfigOption& ConfigOption::value(string_t const& name, int value)
+  {
+    assert(mType == Enum);
+
+    mEnumValues[name] = value;
+
+    return *this;
+  }
+
+  void ConfigOption::reset()
+  {
+    if (fHasDefault)
+      assign(ConfigValue(mDefault));
+  }
+
+  bool ConfigOption::assign(ConfigValue const& value)
+  {
+    // use the form the value was decoded into when it was parsed, if it fits
+    switch (mType) {
+      case Boolean:
+        if (value.type == ConfigValue::Boolean)
+          (*(bool*)mField) = (value.number != 0);
+        else
+          (*(bool*)mField) = Utility::boolify(value.raw);
+
+        return true;
+
+      case Integer:
+        if (value.type == ConfigValue::Integer) {
+          (*(int*)mField) = (int)value.number;
+          return true;
+        }
+
+        try {
+          (*(int*)mField) = Utility::convertTo<int>(value.raw);
+        } catch (BadConversion&) {
+          return false;
+        }
+
+        return true;
+
+      case Bytes:
+        if (value.type == ConfigValue::Bytes || value.type == ConfigValue::Integer) {
+          (*(uint64_t*)mField) = (uint64_t)value.number;
+          return true;
+        }
+
+        return Utility::string_to_bytes(value.raw, (uint64_t*)mField);
+
+      case Duration:
+        if (value.type == ConfigValue::Duration || value.type == ConfigValue::Integer) {
+          (*(uint64_t*)mField) = (uint64_t)value.number;
+          return true;
+        } else {
+          timespec ts;
+          if (!Utility::string_to_seconds(value.raw, &ts))
+            return false;
+
+          (*(uint64_t*)mField) = (uint64_t)ts.tv_sec;
+          return true;
+        }
+
+      case Enum:
+        {
+          std::map<string_t, int>::const_iterator finder = mEnumValues.find(value.raw);
+          if (finder == mEnumValues.end())
+            return false;
+
+          (*(int*)mField) = finder->second;
+          return true;
+        }
+
+      case String:
+        (*(string_t*)mField) = value.raw;
+        return true;
+    }
+
+    return false;
+  }
+
+} // namespace Hax
@@ -0,0 +1,313 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/ConfigSnapshot.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <cassert>
+
+namespace Hax {
+
+  namespace {
+
+    const char      SnapshotMagic[4] = { 'H', 'A', 'X', 'C' };
+    const uint16_t  SnapshotByteOrder = 0x0102;
+
+    template <typename T>
+    inline void write_pod(string_t& out, T value)
+    {
+      out.append((const char*)&value, sizeof(T));
+    }
+
+    inline void write_str(string_t& out, string_t const& str)
+    {
+      write_pod<uint32_t>(out, (uint32_t)str.size());
+      out.append(str);
+    }
+
+    /** a bounds-checked reader over a mapped snapshot */
+    struct cursor_t {
+      const char *pos, *end;
+
+      template <typename T>
+      inline bool read_pod(T* out)
+      {
+        if ((size_t)(end - pos) < sizeof(T))
+          return false;
+
+        memcpy(out, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+      }
+
+      inline bool read_str(const char** out, uint32_t* len)
+      {
+        if (!read_pod(len) || (size_t)(end - pos) < *len)
+          return false;
+
+        (*out) = pos;
+        pos += *len;
+        return true;
+      }
+    };
+  }
+
+  ConfigSnapshot::ConfigSnapshot()
+  : mFile(0),
+    mRegion(0),
+    mBody(0),
+    mBodySize(0),
+    mNrContexts(0)
+  {
+  }
+
+  ConfigSnapshot::~ConfigSnapshot()
+  {
+    unmap();
+  }
+
+  void ConfigSnapshot::unmap()
+  {
+    if (mRegion)
+      delete mRegion;
+    if (mFile)
+      delete mFile;
+
+    mRegion = 0;
+    mFile = 0;
+    mBody = 0;
+    mBodySize = 0;
+    mNrContexts = 0;
+  }
+
+  void ConfigSnapshot::addSource(string_t const& uri, string_t const& data)
+  {
+    source_t src;
+    src.uri = uri;
+    src.hash = Utility::fnv1a_64(data);
+
+    mSources.push_back(src);
+  }
+
+  void ConfigSnapshot::beginContext(string_t const& context)
+  {
+    context_t ctx;
+    ctx.name = context;
+    ctx.complete = true;
+
+    mContexts.push_back(ctx);
+  }
+
+  void ConfigSnapshot::suspendContext()
+  {
+    if (!mContexts.empty())
+      mContexts.back().complete = false;
+  }
+
+  void ConfigSnapshot::record(string_t const& key, string_t const& value)
+  {
+    assert(!mContexts.empty());
+
+    mContexts.back().options.push_back(std::make_pair(key, ConfigValue(value)));
+  }
+
+  std::vector<ConfigSnapshot::source_t> const& ConfigSnapshot::getSources() const
+  {
+    return mSources;
+  }
+
+  uint64_t ConfigSnapshot::getSourcesHash() const
+  {
+    uint64_t hash = Utility::fnv1a_64("", 0);
+    for (auto src : mSources)
+      hash = Utility::fnv1a_64((const char*)&src.hash, sizeof(src.hash), hash);
+
+    return hash;
+  }
+
+  bool ConfigSnapshot::save(string_t const& path) const
+  {
+    string_t out;
+
+    out.append(SnapshotMagic, sizeof(SnapshotMagic));
+    write_pod<uint16_t>(out, Version);
+    write_pod<uint16_t>(out, SnapshotByteOrder);
+    write_pod<uint64_t>(out, getSourcesHash());
+    write_pod<uint32_t>(out, (uint32_t)mSources.size());
+    write_pod<uint32_t>(out, (uint32_t)mContexts.size());
+
+    for (auto src : mSources) {
+      write_str(out, src.uri);
+      write_pod<uint64_t>(out, src.hash);
+    }
+
+    for (auto ctx : mContexts) {
+      write_str(out, ctx.name);
+      write_pod<uint8_t>(out, ctx.complete ? 1 : 0);
+      write_pod<uint32_t>(out, (uint32_t)ctx.options.size());
+
+      for (auto option : ctx.options) {
+        write_str(out, option.first);
+        write_pod<uint8_t>(out, (uint8_t)option.second.type);
+        write_pod<int64_t>(out, option.second.number);
+        write_str(out, option.second.raw);
+      }
+    }
+
+    std::ofstream fh(path.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!fh.is_open() || !fh.good())
+      return false;
+
+    fh.write(out.data(), out.size());
+    fh.close();
+
+    return !fh.fail();
+  }
+
+  bool ConfigSnapshot::load(string_t const& path)
+  {
+    using namespace boost::interprocess;
+
+    unmap();
+    mSources.clear();
+    mContexts.clear();
+
+    try {
+      mFile = new file_mapping(path.c_str(), read_only);
+      mRegion = new mapped_region(*mFile, read_only);
+    } catch (interprocess_exception&) {
+      unmap();
+      return false;
+    }
+
+    cursor_t cursor;
+    cursor.pos = (const char*)mRegion->get_address();
+    cursor.end = cursor.pos + mRegion->get_size();
+
+    char magic[4];
+    uint16_t version, byte_order;
+    uint64_t hash;
+    uint32_t nr_sources;
+
+    if (!cursor.read_pod(&magic) || memcmp(magic, SnapshotMagic, sizeof(magic)) != 0
+      || !cursor.read_pod(&version) || version != Version
+      || !cursor.read_pod(&byte_order) || byte_order != SnapshotByteOrder
+      || !cursor.read_pod(&hash)
+      || !cursor.read_pod(&nr_sources)
+      || !cursor.read_pod(&mNrContexts))
+    {
+      unmap();
+      return false;
+    }
+
+    for (uint32_t i = 0; i < nr_sources; ++i) {
+      const char* uri;
+      uint32_t len;
+      source_t src;
+
+      if (!cursor.read_str(&uri, &len) || !cursor.read_pod(&src.hash)) {
+        unmap();
+        return false;
+      }
+
+      src.uri = string_t(uri, len);
+      mSources.push_back(src);
+    }
+
+    if (hash != getSourcesHash()) {
+      unmap();
+      mSources.clear();
+      return false;
+    }
+
+    mBody = cursor.pos;
+    mBodySize = cursor.end - cursor.pos;
+
+    // validate the layout of the contexts once so apply() can trust it
+    for (uint32_t i = 0; i < mNrContexts; ++i) {
+      const char* str;
+      uint32_t len, nr_options;
+      uint8_t complete;
+      if (!cursor.read_str(&str, &len) || !cursor.read_pod(&complete) || !cursor.read_pod(&nr_options)) {
+        unmap();
+        return false;
+      }
+
+      for (uint32_t j = 0; j < nr_options; ++j) {
+        uint8_t type;
+        int64_t number;
+        if (!cursor.read_str(&str, &len)
+          || !cursor.read_pod(&type) || type > ConfigValue::Duration
+          || !cursor.read_pod(&number)
+          || !cursor.read_str(&str, &len))
+        {
+          unmap();
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  void ConfigSnapshot::apply(Visitor& visitor) const
+  {
+    if (!mBody)
+      return;
+
+    cursor_t cursor;
+    cursor.pos = mBody;
+    cursor.end = mBody + mBodySize;
+
+    for (uint32_t i = 0; i < mNrContexts; ++i) {
+      const char* str;
+      uint32_t len, nr_options;
+      uint8_t complete;
+      cursor.read_str(&str, &len);
+      cursor.read_pod(&complete);
+      cursor.read_pod(&nr_options);
+
+      visitor.onContextStart(string_t(str, len));
+
+      for (uint32_t j = 0; j < nr_options; ++j) {
+        const char* key, *raw;
+        uint32_t key_len, raw_len;
+        uint8_t type;
+        int64_t number;
+
+        cursor.read_str(&key, &key_len);
+        cursor.read_pod(&type);
+        cursor.read_pod(&number);
+        cursor.read_str(&raw, &raw_len);
+
+        visitor.onOption(
+          string_t(key, key_len),
+          ConfigValue(string_t(raw, raw_len), (ConfigValue::Type)type, number));
+      }
+
+      visitor.onContextEnd(complete != 0);
+    }
+  }
+
+} // namespace Hax
@@ -23,6 +23,9 @@
 
 #include "Hax/Configurable.hpp"
 #include "Hax/Configurator.hpp"
+#include "Hax/LogManager.hpp"
+
+#include <cassert>
 
 namespace Hax {
 
@@ -75,5 +78,78 @@ namespace Hax {
       
     return false;
   }
+
+  void Configurable::setOption(string_t const& key, string_t const& value)
+  {
+    HAX_LOG->warnStream()
+      << "unknown '" << mCurrentCtx << "' config setting '" << key << "' => '" << value << "', discarding";
+  }
+
+  void Configurable::applyOption(string_t const& key, ConfigValue const& value)
+  {
+    std::unordered_map<string_t, size_t>::const_iterator finder = mOptionIndex.find(key);
+    if (finder == mOptionIndex.end())
+      return setOption(key, value.raw);
+
+    ConfigOption& option = mOptions[finder->second];
+    if (!option.assign(value)) {
+      HAX_LOG->warnStream()
+        << "invalid value '" << value.raw << "' for '" << mCurrentCtx
+        << "' config setting '" << option.getName() << "', discarding";
+    }
+  }
+
+  void Configurable::setDefaults()
+  {
+    for (auto& option : mOptions)
+      option.reset();
+  }
+
+  ConfigOption& Configurable::registerOption(
+    string_t const& key,
+    ConfigOption::Type type,
+    void* field,
+    std::vector<string_t> const& aliases)
+  {
+    assert(mOptionIndex.find(key) == mOptionIndex.end());
+
+    mOptions.push_back(ConfigOption(key, type, field));
+    mOptionIndex[key] = mOptions.size() - 1;
+
+    for (auto alias : aliases)
+      mOptionIndex[alias] = mOptions.size() - 1;
+
+    return mOptions.back();
+  }
+
+  ConfigOption& Configurable::defineOption(string_t const& key, bool* field, std::vector<string_t> aliases)
+  {
+    return registerOption(key, ConfigOption::Boolean, field, aliases);
+  }
+
+  ConfigOption& Configurable::defineOption(string_t const& key, int* field, std::vector<string_t> aliases)
+  {
+    return registerOption(key, ConfigOption::Integer, field, aliases);
+  }
+
+  ConfigOption& Configurable::defineOption(string_t const& key, string_t* field, std::vector<string_t> aliases)
+  {
+    return registerOption(key, ConfigOption::String, field, aliases);
+  }
+
+  ConfigOption& Configurable::defineBytesOption(string_t const& key, uint64_t* field, std::vector<string_t> aliases)
+  {
+    return registerOption(key, ConfigOption::Bytes, field, aliases);
+  }
+
+  ConfigOption& Configurable::defineDurationOption(string_t const& key, uint64_t* field, std::vector<string_t> aliases)
+  {
+    return registerOption(key, ConfigOption::Duration, field, aliases);
+  }
+
+  ConfigOption& Configurable::defineEnumOption(string_t const& key, int* field, std::vector<string_t> aliases)
+  {
+    return registerOption(key, ConfigOption::Enum, field, aliases);
+  }
   
 }
@@ -23,6 +23,7 @@
 
 #include "Hax/Configurator.hpp"
 #include "Hax/FileManager.hpp"
+#include "Hax/Utility.hpp"
 
 namespace Hax {
 
@@ -53,7 +54,7 @@ namespace Hax {
     }
     
     mSubs.insert(std::make_pair(ctx, cfg));
-    HAX_LOG->infoStream() << "subscribed a Configurable service '" << ctx << "'";
+    HAX_LOG_INFO(HAX_LOG) << "subscribed a Configurable service '" << ctx << "'";
     //~ std::cout << "subscribed a Configurable service '" << ctx << "'\n";
   }
 
@@ -105,7 +106,10 @@ namespace Hax {
   : Logger("Configurator"),
     mData(data),
     mDepth(0),
-    mCurrSub(0)
+    mCurrSub(0),
+    mSnapshot(0),
+    fCompiling(false),
+    fFailed(false)
   {
   }
   
@@ -113,7 +117,10 @@ namespace Hax {
   : Logger("Configurator"),
     mData(),
     mDepth(0),
-    mCurrSub(nullptr)
+    mCurrSub(nullptr),
+    mSnapshot(0),
+    fCompiling(false),
+    fFailed(false)
   {
     // TODO: read file contents into string
     FileManager::getSingleton().loadFile(fh, mData);
@@ -126,13 +133,77 @@ namespace Hax {
     
   void Configurator::run()
   {
-    mLog->infoStream() << "configuring subscribers from JSON sheet";
-    //~ mLog->debugStream() << "JSON data: \n" << mData;
- 
+    HAX_LOG_INFO(mLog) << "configuring subscribers from JSON sheet";
+    //~ HAX_LOG_DEBUG(mLog) << "JSON data: \n" << mData;
+
+    if (!parse())
+      return;
+
+    HAX_LOG_INFO(mLog) << "configuration was successful";    
+  }
+
+  bool Configurator::run(string_t const& snapshot_path)
+  {
+    ConfigSnapshot snapshot;
+    if (!snapshot.load(snapshot_path)) {
+      HAX_LOG_NOTICE(mLog) << "no usable configuration snapshot at '" << snapshot_path << "', parsing JSON sheet";
+      run();
+      return false;
+    }
+
+    if (!isFresh(snapshot)) {
+      HAX_LOG_NOTICE(mLog) << "configuration snapshot '" << snapshot_path << "' is stale, parsing JSON sheet";
+      run();
+      return false;
+    }
+
+    HAX_LOG_INFO(mLog) << "configuring subscribers from snapshot '" << snapshot_path << "'";
+
+    snapshot.apply(*this);
+
+    HAX_LOG_INFO(mLog) << "configuration was successful";
+    return true;
+  }
+
+  bool Configurator::compile(string_t const& out_path)
+  {
+    HAX_LOG_INFO(mLog) << "compiling JSON sheet into snapshot '" << out_path << "'";
+
+    ConfigSnapshot snapshot;
+    snapshot.addSource("", mData);
+
+    mSnapshot = &snapshot;
+    fCompiling = true;
+
+    bool success = parse();
+
+    mSnapshot = 0;
+    fCompiling = false;
+
+    if (!success) {
+      mLog->errorStream() << "JSON sheet could not be compiled, no snapshot was written";
+      return false;
+    }
+
+    if (!snapshot.save(out_path)) {
+      mLog->errorStream() << "unable to write configuration snapshot to '" << out_path << "'";
+      return false;
+    }
+
+    HAX_LOG_INFO(mLog)
+      << "configuration snapshot written, compiled from "
+      << snapshot.getSources().size() << " sheet(s)";
+
+    return true;
+  }
+
+  bool Configurator::parse()
+  {
     yajl_status stat;
     yajl_handle hnd(yajl_alloc(&cfg_callbacks, NULL, this));
     yajl_config(hnd, yajl_allow_comments, 1);
     
+    fFailed = false;
     stat = yajl_parse(hnd, (const unsigned char*)mData.c_str(), mData.size());
 
     if (stat != yajl_status_ok) {
@@ -143,14 +214,69 @@ namespace Hax {
         << stat << "} => " << yajl_error;
       yajl_free_error(hnd, yajl_error);
       yajl_free(hnd);
-      return;
+      return false;
     }
     
     yajl_free(hnd);
-    
-    mLog->infoStream() << "configuration was successful";    
+
+    return !fFailed;
+  }
+
+  bool Configurator::isFresh(ConfigSnapshot const& snapshot)
+  {
+    std::vector<ConfigSnapshot::source_t> const& sources = snapshot.getSources();
+
+    // the first source must be the root sheet, which is the one we hold
+    if (sources.empty() || !sources.front().uri.empty())
+      return false;
+
+    for (auto src : sources) {
+      if (src.uri.empty()) {
+        if (Utility::fnv1a_64(mData) != src.hash)
+          return false;
+
+        continue;
+      }
+
+      string_t data;
+      if (!FileManager::getSingleton().getRemote(src.uri, data)
+        || Utility::fnv1a_64(data) != src.hash)
+        return false;
+    }
+
+    return true;
+  }
+
+  void Configurator::onContextStart(string_t const& ctx)
+  {
+    subs_t::iterator finder = mSubs.find(ctx);
+    mCurrCtx = ctx;
+
+    if (finder != mSubs.end()) {
+      mCurrSub = finder->second;
+      mCurrSub->mCurrentCtx = mCurrCtx;
+
+      HAX_LOG_INFO(mLog) << "configuring '" << mCurrCtx << "'";
+    } else {
+      mLog->warnStream() << "no subscribed configurable for context '" << mCurrCtx << "', skipping config";
+    }
+  }
+
+  void Configurator::onOption(string_t const& key, ConfigValue const& value)
+  {
+    if (mCurrSub)
+      mCurrSub->applyOption(key, value);
   }
 
+  void Configurator::onContextEnd(bool complete)
+  {
+    // an interrupted context is configured once it's resumed and done with
+    if (mCurrSub && complete)
+      mCurrSub->configure();
+
+    mCurrSub = NULL;
+    mCurrCtx.clear();
+  }
 
   int Configurator::__onJsonMapStart()
   {
@@ -166,16 +292,23 @@ namespace Hax {
     if (isReserved(mCurrKey))
       return yajl_continue;
     
-    if (!mCurrSub) {
-      subs_t::iterator finder = mSubs.find(mCurrKey);
+    // keys at the top level denote contexts, the ones nested in them are options
+    if (mDepth == 1) {
       mCurrCtx = mCurrKey;
 
+      if (mSnapshot)
+        mSnapshot->beginContext(mCurrCtx);
+
+      if (fCompiling)
+        return yajl_continue;
+
+      subs_t::iterator finder = mSubs.find(mCurrKey);
       if (finder != mSubs.end())
       {
         mCurrSub = finder->second;
         mCurrSub->mCurrentCtx = mCurrCtx;
         
-        mLog->infoStream() << "configuring '" << mCurrKey << "'";
+        HAX_LOG_INFO(mLog) << "configuring '" << mCurrKey << "'";
       } else {
         mLog->warnStream() << "no subscribed configurable for context '" << mCurrKey << "', skipping config";
       }
@@ -191,20 +324,43 @@ namespace Hax {
       mCurrVal.clear();
       mCurrVal = string_t((const char*)val, len);
             
-      mLog->infoStream() << "including external config file: " << mCurrVal;
+      HAX_LOG_INFO(mLog) << "including external config file: " << mCurrVal;
       string_t data;
       if (FileManager::getSingleton().getRemote(mCurrVal, data)) {
         Configurator cfg(data);
-        cfg.run();
+
+        if (mSnapshot) {
+          // the parse doesn't configure the context we're in until its end
+          if (mDepth == 2)
+            mSnapshot->suspendContext();
+
+          mSnapshot->addSource(mCurrVal, data);
+          cfg.mSnapshot = mSnapshot;
+          cfg.fCompiling = fCompiling;
+        }
+
+        if (!cfg.parse())
+          fFailed = true;
+
+        // options following the include belong to the context we're in, if any
+        if (mSnapshot && mDepth == 2)
+          mSnapshot->beginContext(mCurrCtx);
+      } else if (fCompiling) {
+        mLog->errorStream() << "unable to resolve included config file: " << mCurrVal;
+        fFailed = true;
       }
       return yajl_continue;
     }
 
+    if (mSnapshot && mDepth == 2) {
+      mSnapshot->record(mCurrKey, string_t((const char*)val, len));
+    }
+
     if (mCurrSub) {
       mCurrVal.clear();
       mCurrVal = string_t((const char*)val, len);
       
-      mCurrSub->setOption(mCurrKey, mCurrVal);
+      mCurrSub->applyOption(mCurrKey, ConfigValue(mCurrVal));
     }
     
     return yajl_continue;
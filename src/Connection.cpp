@@ -22,9 +22,44 @@
  */
 
 #include "Connection.hpp"
+#include "MetricsManager.hpp"
+#include "Tracer.hpp"
 
 namespace Hax {
 
+namespace {
+  /** shared by all connections, registered by the first one */
+  struct connection_metrics_t {
+    Counter   &bytes_in;
+    Counter   &bytes_out;
+    Counter   &messages_in;
+    Counter   &messages_out;
+    Counter   &write_errors;
+    Histogram &write_time;
+
+    connection_metrics_t(MetricsManager& metrics)
+    : bytes_in(metrics.counter("hax_connection_received_bytes_total", "Bytes read from client connections")),
+      bytes_out(metrics.counter("hax_connection_sent_bytes_total", "Bytes written to client connections")),
+      messages_in(metrics.counter("hax_connection_received_messages_total", "Events parsed off client connections")),
+      messages_out(metrics.counter("hax_connection_sent_messages_total", "Events written to client connections")),
+      write_errors(metrics.counter("hax_connection_write_errors_total", "Failed writes to client connections")),
+      write_time(metrics.histogram("hax_connection_write_seconds", "Time spent blocked writing an event to a connection"))
+    {
+      for (int error = 0; error < EventParseError::Count; ++error)
+        metrics.callback(
+          string_t("hax_event_parse_errors_total{type=\"") + Event::getParseErrorName(error) + "\"}",
+          "Inbound events that failed to parse",
+          "counter",
+          boost::bind(&Event::getParseErrors, error));
+    }
+  };
+
+  connection_metrics_t& getMetrics() {
+    static connection_metrics_t metrics(MetricsManager::getSingleton());
+    return metrics;
+  }
+}
+
 Connection::Connection(boost::asio::io_service& io_service)
   : socket_(io_service),
     strand_(io_service),
@@ -101,7 +136,11 @@ void Connection::handle_read(
   std::size_t bytes_transferred)
 {
   if (!e) {
+    getMetrics().bytes_in.inc(bytes_transferred);
+
     while (request_.size() > 0 && inbound.fromStream(request_)) {
+      getMetrics().messages_in.inc();
+
       //bool result = ;
       //if (result) {
         //request_.consume(bytes_transferred);
@@ -126,6 +165,8 @@ void Connection::send(const Event& evt) {
 }
 
   void Connection::do_send(Event &evt) {
+    HAX_TRACE_SCOPE("Connection::do_send");
+
     //std::cout << "outbound buffer has " << response_.size() << "bytes (expected 0)";
 
     boost::system::error_code ec;
@@ -135,7 +176,11 @@ void Connection::send(const Event& evt) {
     outbound = Event(evt);
     outbound.toStream(response_);
 
-    size_t n = boost::asio::write(socket_, response_.data(), boost::asio::transfer_all(), ec);
+    size_t n;
+    {
+      ScopedTimer timer(getMetrics().write_time);
+      n = boost::asio::write(socket_, response_.data(), boost::asio::transfer_all(), ec);
+    }
     //std::cout << "sent " << n << "bytes of data, buffer now has " << response_.size() << "\n";
     /*this->async_write(outbound,
      boost::bind(&Connection::handle_write, shared_from_this(),
@@ -144,9 +189,13 @@ void Connection::send(const Event& evt) {
     if (!ec) {
       //std::cout << " - sent " << n << "bytes (out of" << response_.size() << "b)\n";
       response_.consume(n);
+      getMetrics().bytes_out.inc(n);
+      getMetrics().messages_out.inc();
       //std::cout << " cleared response buf ( " << response_.size() << ")\n";
-    } else
+    } else {
+      getMetrics().write_errors.inc();
       stop();
+    }
 
   }
 
@@ -0,0 +1,398 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/EngineScheduler.hpp"
+#include "Hax/MetricsManager.hpp"
+#include "Hax/Tracer.hpp"
+
+#include <map>
+#include <chrono>
+
+namespace Hax {
+
+  EngineScheduler::EngineScheduler()
+  : Logger("Scheduler"),
+    Configurable({ "Engine Scheduler" }),
+    mWorkers(0),
+    mRemaining(0),
+    fRunning(false),
+    mDroppedSteps(0)
+  {
+    defineOption("Timestep", &mConfig.Timestep, { "timestep" }).defaultsTo("16");
+    defineOption("Max Catch Up", &mConfig.MaxCatchUp, { "max catch up" }).defaultsTo("5");
+    defineOption("Workers", &mConfig.Workers, { "workers" }).defaultsTo("0");
+  }
+
+  EngineScheduler::~EngineScheduler()
+  {
+    delete mWorkers;
+
+    for (entry_t* entry : mEngines)
+      delete entry;
+  }
+
+  void EngineScheduler::add(
+    string_t const& name,
+    Engine* engine,
+    unsigned tick_rate,
+    std::vector<string_t> depends_on,
+    uint64_t budget_us,
+    bool parallel)
+  {
+    entry_t* entry = new entry_t();
+    entry->name = name;
+    entry->trace_name = Tracer::intern(name);
+    entry->engine = engine;
+    entry->tick_rate = tick_rate;
+    entry->accumulator = 0;
+    entry->ticks = 0;
+    entry->budget_ns = budget_us * 1000;
+    entry->parallel = parallel;
+    entry->depends_on = depends_on;
+    entry->runs = 0;
+    entry->pending = 0;
+    entry->updates = 0;
+    entry->overruns = 0;
+    entry->last_ns = 0;
+    entry->max_ns = 0;
+    entry->total_ns = 0;
+    entry->update_time = &MetricsManager::getSingleton().histogram(
+      "hax_engine_update_seconds{engine=\"" + name + "\"}",
+      "Time spent in Engine::update() per engine");
+
+    mEngines.push_back(entry);
+
+    const unsigned timestep = (unsigned)std::max(mConfig.Timestep, 1);
+    if ((uint64_t)tick_rate * timestep > 1000) {
+      mLog->warnStream() << "engine '" << name << "' ticks at " << tick_rate
+        << "Hz but a timestep of " << timestep << "ms only fits up to "
+        << 1000 / timestep << "Hz; it will be updated several times back to back on some steps";
+    }
+  }
+
+  bool EngineScheduler::setup()
+  {
+    std::map<string_t, size_t> indices;
+    for (size_t i = 0; i < mEngines.size(); ++i)
+      indices[mEngines[i]->name] = i;
+
+    for (size_t i = 0; i < mEngines.size(); ++i) {
+      entry_t* entry = mEngines[i];
+      entry->requires.clear();
+      entry->dependents.clear();
+    }
+
+    for (size_t i = 0; i < mEngines.size(); ++i) {
+      for (string_t const& dependency : mEngines[i]->depends_on) {
+        std::map<string_t, size_t>::const_iterator found = indices.find(dependency);
+        if (found == indices.end()) {
+          mLog->errorStream() << "engine '" << mEngines[i]->name
+            << "' depends on an unknown engine '" << dependency << "'";
+          return false;
+        }
+
+        mEngines[i]->requires.push_back(found->second);
+        mEngines[found->second]->dependents.push_back(i);
+      }
+    }
+
+    // order the engines so that every one comes after its dependencies
+    mOrder.clear();
+    std::vector<size_t> unmet(mEngines.size());
+    for (size_t i = 0; i < mEngines.size(); ++i)
+      if (!(unmet[i] = mEngines[i]->requires.size()))
+        mOrder.push_back(i);
+
+    for (size_t cursor = 0; cursor < mOrder.size(); ++cursor)
+      for (size_t dependent : mEngines[mOrder[cursor]]->dependents)
+        if (--unmet[dependent] == 0)
+          mOrder.push_back(dependent);
+
+    if (mOrder.size() != mEngines.size()) {
+      mLog->errorStream() << "the engine dependencies are cyclic";
+      return false;
+    }
+
+    bool any_parallel = false;
+    for (entry_t* entry : mEngines)
+      any_parallel = any_parallel || entry->parallel;
+
+    delete mWorkers;
+    mWorkers = 0;
+    if (any_parallel && mConfig.Workers > 0)
+      mWorkers = new WorkerPool(mConfig.Workers);
+
+    for (size_t index : mOrder) {
+      entry_t* entry = mEngines[index];
+      if (!entry->engine->setup()) {
+        mLog->errorStream() << "engine '" << entry->name << "' could not be set up";
+        return false;
+      }
+    }
+
+    HAX_LOG_INFO(mLog) << "scheduling " << mEngines.size() << " engines every "
+      << mConfig.Timestep << "ms using " << (mWorkers ? mWorkers->size() : 0) << " workers";
+
+    return true;
+  }
+
+  bool EngineScheduler::cleanup()
+  {
+    delete mWorkers;
+    mWorkers = 0;
+
+    bool success = true;
+    for (std::vector<size_t>::reverse_iterator index = mOrder.rbegin(); index != mOrder.rend(); ++index)
+      success = mEngines[*index]->engine->cleanup() && success;
+
+    return success;
+  }
+
+  void EngineScheduler::run()
+  {
+    typedef std::chrono::steady_clock steady_t;
+
+    fRunning = true;
+
+    const uint64_t step_ns = (uint64_t)std::max(mConfig.Timestep, 1) * 1000000ULL;
+    const int max_catch_up = std::max(mConfig.MaxCatchUp, 1);
+
+    uint64_t accumulator_ns = step_ns;
+    steady_t::time_point last = steady_t::now();
+
+    while (fRunning) {
+      steady_t::time_point now = steady_t::now();
+      accumulator_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+      last = now;
+
+      int steps = 0;
+      while (accumulator_ns >= step_ns && steps < max_catch_up) {
+        step();
+        accumulator_ns -= step_ns;
+        ++steps;
+      }
+
+      // too far behind, give up on the backlog rather than spiral
+      if (accumulator_ns >= step_ns) {
+        mDroppedSteps += accumulator_ns / step_ns;
+        accumulator_ns %= step_ns;
+      }
+
+      // lend whatever is left of the frame to the engines, then sleep it off
+      steady_t::time_point deadline = last + std::chrono::nanoseconds(step_ns - accumulator_ns);
+      for (size_t index : mOrder) {
+        now = steady_t::now();
+        if (now >= deadline)
+          break;
+
+        mEngines[index]->engine->idle((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count());
+      }
+
+      now = steady_t::now();
+      if (now < deadline)
+        boost::this_thread::sleep(boost::posix_time::microseconds(
+          (long)std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count()));
+    }
+  }
+
+  void EngineScheduler::stop()
+  {
+    fRunning = false;
+  }
+
+  void EngineScheduler::step()
+  {
+    HAX_TRACE_SCOPE("EngineScheduler::step");
+
+    const uint64_t timestep = (uint64_t)std::max(mConfig.Timestep, 1);
+
+    // find out which engines are due, and how many times; a step is worth
+    // tick_rate * timestep thousandths of an update, kept exact so that no
+    // rate drifts however it divides into the timestep
+    size_t due = 0;
+    for (entry_t* entry : mEngines) {
+      if (!entry->tick_rate) {
+        entry->runs = 1;
+        ++due;
+        continue;
+      }
+
+      entry->accumulator += entry->tick_rate * timestep;
+      entry->runs = entry->accumulator / 1000;
+      entry->accumulator %= 1000;
+
+      if (entry->runs)
+        ++due;
+    }
+
+    if (!due)
+      return;
+
+    {
+      boost::mutex::scoped_lock lock(mStepMutex);
+
+      mReady.clear();
+      mRemaining = due;
+
+      for (size_t index : mOrder) {
+        entry_t* entry = mEngines[index];
+        if (!entry->runs)
+          continue;
+
+        entry->pending = 0;
+        for (size_t dependency : entry->requires)
+          if (mEngines[dependency]->runs)
+            ++entry->pending;
+
+        if (!entry->pending)
+          mReady.push_back(index);
+      }
+    }
+
+    std::vector<size_t> local;
+    for (;;) {
+      {
+        boost::mutex::scoped_lock lock(mStepMutex);
+        while (mReady.empty() && mRemaining > 0)
+          mStepProgress.wait(lock);
+
+        if (mReady.empty())
+          break;
+
+        local.clear();
+        for (size_t index : mReady) {
+          if (mWorkers && mEngines[index]->parallel)
+            mWorkers->submit(boost::bind(&EngineScheduler::update, this, index));
+          else
+            local.push_back(index);
+        }
+
+        mReady.clear();
+      }
+
+      for (size_t index : local)
+        update(index);
+    }
+
+    std::exception_ptr error;
+    {
+      boost::mutex::scoped_lock lock(mStepMutex);
+      error = mError;
+      mError = std::exception_ptr();
+    }
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  void EngineScheduler::update(size_t index)
+  {
+    entry_t* entry = mEngines[index];
+
+    for (uint64_t run = 0; run < entry->runs; ++run) {
+      // the n-th update in a second is handed the milliseconds between the
+      // n-th and the n+1-th tick, so they add up to 1000 each second
+      unsigned long period = (unsigned long)std::max(mConfig.Timestep, 1);
+      if (entry->tick_rate) {
+        period = (unsigned long)((entry->ticks + 1) * 1000 / entry->tick_rate - entry->ticks * 1000 / entry->tick_rate);
+        entry->ticks = (entry->ticks + 1) % entry->tick_rate;
+      }
+
+      uint64_t begin = Tracer::now();
+
+      try {
+        entry->engine->update(period);
+      } catch (...) {
+        boost::mutex::scoped_lock lock(mStepMutex);
+        if (!mError)
+          mError = std::current_exception();
+
+        break;
+      }
+
+      uint64_t end = Tracer::now();
+
+#ifdef HAX_TRACING
+      if (Tracer::isEnabled())
+        Tracer::record(entry->trace_name, begin, end);
+#endif
+
+      uint64_t elapsed = end - begin;
+      entry->update_time->record(elapsed);
+      entry->updates.fetch_add(1, std::memory_order_relaxed);
+      entry->last_ns.store(elapsed, std::memory_order_relaxed);
+      entry->total_ns.fetch_add(elapsed, std::memory_order_relaxed);
+      if (elapsed > entry->max_ns.load(std::memory_order_relaxed))
+        entry->max_ns.store(elapsed, std::memory_order_relaxed);
+
+      if (entry->budget_ns && elapsed > entry->budget_ns) {
+        entry->overruns.fetch_add(1, std::memory_order_relaxed);
+        HAX_LOG_WARN(mLog) << "engine '" << entry->name << "' went over its budget: "
+          << elapsed / 1000 << "us out of " << entry->budget_ns / 1000 << "us";
+      }
+    }
+
+    onUpdated(index);
+  }
+
+  void EngineScheduler::onUpdated(size_t index)
+  {
+    {
+      boost::mutex::scoped_lock lock(mStepMutex);
+
+      --mRemaining;
+      for (size_t dependent : mEngines[index]->dependents) {
+        entry_t* entry = mEngines[dependent];
+        if (entry->runs && --entry->pending == 0)
+          mReady.push_back(dependent);
+      }
+    }
+
+    mStepProgress.notify_all();
+  }
+
+  EngineScheduler::stats_t EngineScheduler::getStats(string_t const& name) const
+  {
+    stats_t stats = { 0, 0, 0, 0, 0 };
+
+    for (entry_t const* entry : mEngines) {
+      if (entry->name != name)
+        continue;
+
+      stats.updates = entry->updates.load(std::memory_order_relaxed);
+      stats.overruns = entry->overruns.load(std::memory_order_relaxed);
+      stats.last_ns = entry->last_ns.load(std::memory_order_relaxed);
+      stats.max_ns = entry->max_ns.load(std::memory_order_relaxed);
+      stats.total_ns = entry->total_ns.load(std::memory_order_relaxed);
+      break;
+    }
+
+    return stats;
+  }
+
+  uint64_t EngineScheduler::getDroppedSteps() const
+  {
+    return mDroppedSteps.load();
+  }
+
+} // namespace Hax
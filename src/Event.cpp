@@ -23,13 +23,116 @@
 
 #include "Hax/Event.hpp"
 #include "Hax/Utility.hpp"
-#include <boost/thread/mutex.hpp>
+#include "Hax/Logger.hpp"
+
+#include <atomic>
+#include <chrono>
 
 namespace Hax {
 
   using Utility::stringify;
-  
-  boost::mutex global_stream_lock;
+
+  namespace {
+
+    /**
+     * Parse error counters of a single thread; only the owning thread writes
+     * to them, readers sum the counters of all slots. Slots are never freed,
+     * a thread that exits releases its slot to the next new thread and the
+     * counts it accumulated stay in the totals.
+     */
+    struct parse_counters_t {
+      std::atomic<uint64_t> counts[EventParseError::Count];
+      std::atomic<bool>     in_use;
+      parse_counters_t      *next;
+
+      /* error logging throttle, touched only by the owning thread */
+      std::chrono::steady_clock::time_point last_logged;
+      uint64_t              unlogged;
+    };
+
+    std::atomic<parse_counters_t*> gParseCounters(0);
+
+    struct thread_parse_counters_t {
+      parse_counters_t *slot;
+
+      thread_parse_counters_t() {
+        for (slot = gParseCounters.load(); slot; slot = slot->next) {
+          bool free = false;
+          if (slot->in_use.compare_exchange_strong(free, true))
+            return;
+        }
+
+        slot = new parse_counters_t();
+        for (int i = 0; i < EventParseError::Count; ++i)
+          slot->counts[i].store(0, std::memory_order_relaxed);
+        slot->in_use.store(true);
+        slot->unlogged = 0;
+
+        slot->next = gParseCounters.load();
+        while (!gParseCounters.compare_exchange_weak(slot->next, slot))
+          ;
+      }
+
+      ~thread_parse_counters_t() {
+        slot->in_use.store(false);
+      }
+    };
+
+    thread_local thread_parse_counters_t tParseCounters;
+
+    /* a thread logs at most one parse error per interval */
+    const std::chrono::seconds ParseErrorLogInterval(1);
+
+    log_t* getParseLog() {
+      static Logger logger("Event");
+      return logger.getLog();
+    }
+  }
+
+  /**
+   * Counts the parse error and tells whether it should be logged; when it
+   * should, out_suppressed holds the number of errors this thread didn't log
+   * since the last one that was.
+   */
+  static bool recordParseError(int error, uint64_t& out_suppressed) {
+    parse_counters_t* counters = tParseCounters.slot;
+    counters->counts[error].fetch_add(1, std::memory_order_relaxed);
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - counters->last_logged < ParseErrorLogInterval) {
+      ++counters->unlogged;
+      return false;
+    }
+
+    out_suppressed = counters->unlogged;
+    counters->unlogged = 0;
+    counters->last_logged = now;
+    return true;
+  }
+
+  uint64_t Event::getParseErrors(int error) {
+    uint64_t total = 0;
+    for (parse_counters_t* slot = gParseCounters.load(); slot; slot = slot->next) {
+      if (error >= 0 && error < EventParseError::Count)
+        total += slot->counts[error].load(std::memory_order_relaxed);
+      else
+        for (int i = 0; i < EventParseError::Count; ++i)
+          total += slot->counts[i].load(std::memory_order_relaxed);
+    }
+
+    return total;
+  }
+
+  const char* Event::getParseErrorName(int error) {
+    switch (error) {
+      case EventParseError::TooShort:          return "too_short";
+      case EventParseError::FailedSanityCheck: return "failed_sanity_check";
+      case EventParseError::BadLength:         return "bad_length";
+      case EventParseError::ChecksumMismatch:  return "checksum_mismatch";
+      default:
+        return "unknown";
+    }
+  }
 
   const char* Event::Footer = "\r\n\r\n";
   const uint32_t Event::MaxLength = 65563;
@@ -168,18 +271,16 @@ namespace Hax {
 
     int bytes_received = in.size();
     if (bytes_received < Event::HeaderLength + Event::FooterLength -2 /* debug */) {
-      global_stream_lock.lock();
-      std::cerr
-        << "message is too short (" << bytes_received
-        << " out of " << Event::HeaderLength + Event::FooterLength << "!!\n";
-      global_stream_lock.unlock();
+      uint64_t suppressed;
+      if (recordParseError(EventParseError::TooShort, suppressed)) {
+        HAX_LOG_WARN(getParseLog())
+          << "message is too short (" << bytes_received
+          << " out of " << Event::HeaderLength + Event::FooterLength << " bytes)"
+          << " [" << suppressed << " more parse errors since the last report]";
+      }
       return false;
     }
 
-    global_stream_lock.lock();
-    //~ std::cout << " + received " << bytes_received << "bytes of data\n";
-    global_stream_lock.unlock();
-
     //char sp1;
     unsigned char uid, feedback, flags;
     uint32_t length;
@@ -203,33 +304,31 @@ namespace Hax {
     if ((this->UID <= EventUID::Unassigned || this->UID >= EventUID::SanityCheck)
         || (this->Length > Event::MaxLength)
         || (this->Feedback < EventFeedback::Unassigned || this->Feedback >= EventFeedback::SanityCheck)) {
-      global_stream_lock.lock();
-      std::cerr << "request failed header sanity check\n";
-      global_stream_lock.unlock();
+      uint64_t suppressed;
+      if (recordParseError(EventParseError::FailedSanityCheck, suppressed)) {
+        HAX_LOG_WARN(getParseLog())
+          << "request failed header sanity check"
+          << " [" << suppressed << " more parse errors since the last report]";
+      }
       return false;
     }
 
     // there must be N+sizeof(int) bytes of properties where N > in_bytes - signature
     if (this->Length > 0 && (bytes_received - Event::HeaderLength - Event::FooterLength < this->Length+sizeof(int))) {
-      global_stream_lock.lock();
-      std::cerr << "invalid properties length: " << this->Length << "\n";
-      global_stream_lock.unlock();
+      uint64_t suppressed;
+      if (recordParseError(EventParseError::BadLength, suppressed)) {
+        HAX_LOG_WARN(getParseLog())
+          << "invalid properties length: " << this->Length
+          << " [" << suppressed << " more parse errors since the last report]";
+      }
       return false;
     }
 
-    global_stream_lock.lock();
-    //std::cout << " + received event uid : " << (int)this->UID << "(" << __uidToString(this->UID) << ")" << " and length: " << this->Length << "\n";
-    global_stream_lock.unlock();
-
     // parse properties
     if (this->Length > 0) {
       if ((this->Options & Event::Compressed) == Event::Compressed) {
         is >> this->Rawsize;
         is.get();
-
-        global_stream_lock.lock();
-        //std::cout << "a compressed event, raw size: " << this->Rawsize << "\n";
-        global_stream_lock.unlock();
       }
 
       int checksum;
@@ -243,10 +342,13 @@ namespace Hax {
       // verify CRC checksum
       this->Checksum = Event::__CRC32(props);
       if (this->Checksum != checksum) {
-        global_stream_lock.lock();
-        std::cerr << "CRC mismatch, aborting: " << this->Checksum << " vs " << checksum << " for " << props << " => " << props.size() << "\n";
-        global_stream_lock.unlock();
-        //delete props;
+        uint64_t suppressed;
+        if (recordParseError(EventParseError::ChecksumMismatch, suppressed)) {
+          HAX_LOG_WARN(getParseLog())
+            << "CRC mismatch, aborting: " << this->Checksum << " vs " << checksum
+            << " for " << props.size() << " bytes of properties"
+            << " [" << suppressed << " more parse errors since the last report]";
+        }
         return false;
       }
 
@@ -266,9 +368,6 @@ namespace Hax {
     }
 
     // skip the footer
-    //global_stream_lock.lock();
-    //std::cout << in.size() << " bytes left\n";
-    //global_stream_lock.unlock();
     //assert(in.size() == Event::FooterLength);
     in.consume(Event::FooterLength);
 
@@ -310,9 +409,6 @@ namespace Hax {
     if (!props.empty()) {
       if ((this->Options & Event::Compressed) == Event::Compressed) {
         stream << (uint32_t)this->Rawsize << " ";
-        global_stream_lock.lock();
-        //std::cout << "dumping raw size of compressed event: " << this->Rawsize << "\n";
-        global_stream_lock.unlock();
       }
 
       stream << Event::__CRC32(props) << " ";
@@ -326,9 +422,6 @@ namespace Hax {
       //~ << "->" << stringify((uint16_t)props.size()) << ")\n";
 
     stream << Event::Footer;
-    //global_stream_lock.lock();
-    //std::cout << "post-dump: " << out.size() << "bytes \n";
-    //global_stream_lock.unlock();
   }
 
   std::string Event::__uidToString(unsigned char uid) {
@@ -23,73 +23,119 @@
 
 #include "Hax/EventListener.hpp"
 #include "Hax/EventManager.hpp"
+#include "Hax/MetricsManager.hpp"
+#include "Hax/Tracer.hpp"
 
 namespace Hax {
 
   int EventListener::gUIDGenerator = 0;
 
-	EventListener::EventListener() {
+  /** events queued in all the listeners, waiting to be processed */
+  static Gauge& getBacklog() {
+    static Gauge& backlog =
+      MetricsManager::getSingleton().gauge("hax_event_listener_backlog", "Events waiting in listener queues");
+    return backlog;
+  }
+
+	EventListener::EventListener()
+  : fRetrying(false),
+    fDispatching(false),
+    mAffinity(OwnerThread),
+    fScheduled(false)
+  {
     mUID = ++gUIDGenerator;
 	}
 
 	EventListener::~EventListener() {
+    getBacklog().sub(mEvents.size());
     mEvtHandlers.clear();
-    mTracker.clear();
+    mPending.clear();
     //while (!mEvents.empty())
     //  mEvents.pop();
 	}
 
-	bool EventListener::processEvents() {
+	bool EventListener::processEvents(size_t budget) {
     if (mEvents.empty())
       return true;
 
-    const Event& evt = mEvents.front();
+    HAX_TRACE_SCOPE("EventListener::processEvents");
+
+    for (size_t processed = 0; !mEvents.empty(); ++processed) {
+      if (budget && processed == budget)
+        return false;
+
+      if (!dispatch(mEvents.front()))
+        return false;
 
-    //~ std::cout << "processing an evt " << (int)evt.UID << ": " << Event::_uid_to_string(evt.UID) << "\n";
-    // fill our tracker with the handlers listening to this event
-    if (mEvtHandlers.find(evt.UID) == mEvtHandlers.end() &&
-        mEvtHandlers.find(EventUID::Unassigned) == mEvtHandlers.end()) {
-      std::cout << "ERROR!! found no handlers!!\n";
       mEvents.pop();
-      return true; // there r no handlers
+      getBacklog().sub();
+    }
+
+    return true;
+  }
+
+  bool EventListener::dispatch(const Event& evt) {
+    // a fresh event: every handler bound to it, or to all events, is pending
+    if (!fRetrying) {
+      mPending.clear();
+
+      EventHandlers_T::const_iterator handlers;
+      if (evt.UID != EventUID::Unassigned &&
+          (handlers = mEvtHandlers.find(evt.UID)) != mEvtHandlers.end())
+        for (size_t i = 0; i < handlers->second.size(); ++i)
+          mPending.push_back(pending_t(evt.UID, i, mBindGenerations[evt.UID]));
+
+      if ((handlers = mEvtHandlers.find(EventUID::Unassigned)) != mEvtHandlers.end())
+        for (size_t i = 0; i < handlers->second.size(); ++i)
+          mPending.push_back(pending_t(EventUID::Unassigned, i, mBindGenerations[EventUID::Unassigned]));
+
+      if (mPending.empty())
+        return true; // there r no handlers
     }
 
-    // if the tracker isn't empty, it means one of the handlers wasn't done with
-    // an earlier event
-    if (mTracker.empty()) {
-      EventHandlers_T::iterator finder = mEvtHandlers.find(evt.UID);
-      if (finder != mEvtHandlers.end()) {
-        std::vector<EventHandler_T>* handlers = &(finder->second);
-        std::vector<EventHandler_T>::const_iterator handler;
-        for (handler = handlers->begin();
-             handler != handlers->end();
-             ++handler)
-          mTracker.push_back(*handler);
+    // now call the pending handlers, and keep the ones that aren't done
+    fDispatching = true;
 
+    size_t kept = 0, i = 0;
+    try {
+      for (; i < mPending.size(); ++i) {
+        EventHandler_T* handler = getHandler(mPending[i]);
+        if (handler && !(*handler)(evt))
+          mPending[kept++] = mPending[i];
       }
+    } catch (...) {
+      // the handler that threw is still pending, and so are the ones after it
+      mPending.erase(mPending.begin() + kept, mPending.begin() + i);
+
+      fDispatching = false;
+      mRetired.clear();
 
-      std::vector<EventHandler_T>::const_iterator handler;
-      // handlers listening to all events
-      for (handler = mEvtHandlers.find(EventUID::Unassigned)->second.begin();
-           handler != mEvtHandlers.find(EventUID::Unassigned)->second.end();
-           ++handler)
-        mTracker.push_back((*handler));
+      fRetrying = true;
+      throw;
     }
 
-    // now call all the handlers, and remove the event only if they're all done
-    bool done = true;
-    for (tracker_t::iterator handler = mTracker.begin(); handler != mTracker.end(); ++handler)
-      if ( (*handler)(evt) ) {
-        tracker_t::iterator tmp = handler;
-        ++handler;
-        mTracker.erase(tmp);
-      } else
-        done = false;
-
-    if (done)
-      mEvents.pop();
+    mPending.erase(mPending.begin() + kept, mPending.end());
 
-    return done;
+    fDispatching = false;
+    mRetired.clear();
+
+    fRetrying = !mPending.empty();
+    return !fRetrying;
+  }
+
+  EventListener::EventHandler_T* EventListener::getHandler(pending_t const& pending) {
+    EventHandlers_T::iterator handlers = mEvtHandlers.find(pending.uid);
+    if (handlers == mEvtHandlers.end() ||
+        pending.index >= handlers->second.size() ||
+        pending.generation != mBindGenerations[pending.uid])
+      return 0; // unbound in the meantime
+
+    return &handlers->second[pending.index];
+  }
+
+  void EventListener::retire(EventHandlers_T::iterator handlers) {
+    if (fDispatching)
+      mRetired.push_back(std::move(handlers->second));
   }
 
   void EventListener::doSubscribe(EventUID_T evt) {
@@ -101,6 +147,7 @@ namespace Hax {
 
   void EventListener::enqueue(const Event& inEvt) {
     mEvents.push(inEvt);
+    getBacklog().add();
   }
 
   void EventListener::bind(EventUID_T inUID, EventHandler_T inHandler) {
@@ -112,13 +159,29 @@ namespace Hax {
       lBinder = mEvtHandlers.insert(make_pair(inUID, std::vector<EventHandler_T>())).first;
     }
 
-    lBinder->second.push_back( inHandler );
+    // growing the vector would move the handler that may be running now
+    std::vector<EventHandler_T>& handlers = lBinder->second;
+    if (fDispatching && handlers.size() == handlers.capacity()) {
+      std::vector<EventHandler_T> grown;
+      grown.reserve(handlers.capacity() * 2 + 1);
+      grown.insert(grown.end(), handlers.begin(), handlers.end());
+      retire(lBinder);
+      handlers.swap(grown);
+    }
+
+    handlers.push_back( inHandler );
     doSubscribe(inUID);
   }
 
 
   void EventListener::unbind(EventUID_T inUID) {
-    mEvtHandlers.erase(inUID);
+    EventHandlers_T::iterator handlers = mEvtHandlers.find(inUID);
+    if (handlers != mEvtHandlers.end()) {
+      retire(handlers);
+      mEvtHandlers.erase(handlers);
+      ++mBindGenerations[inUID];
+    }
+
     doUnsubscribe(inUID);
   }
 
@@ -129,6 +192,8 @@ namespace Hax {
       ++pair)
     {
       EventManager::getSingleton().unsubscribe(pair->first, this);
+      retire(pair);
+      ++mBindGenerations[pair->first];
     }
     mEvtHandlers.clear();
   }
@@ -137,6 +202,14 @@ namespace Hax {
     return mUID;
   }
 
+  void EventListener::setAffinity(Affinity affinity) {
+    mAffinity = affinity;
+  }
+
+  EventListener::Affinity EventListener::getAffinity() const {
+    return mAffinity;
+  }
+
   bool EventListener::isBound(EventUID_T inUID) const {
     return mEvtHandlers.find(inUID) != mEvtHandlers.end();
   }
@@ -23,24 +23,43 @@
 
 #include "Hax/EventManager.hpp"
 #include "Hax/EventListener.hpp"
+#include "Hax/MetricsManager.hpp"
+#include "Hax/Tracer.hpp"
+#include "Hax/WorkerPool.hpp"
 
 namespace Hax {
 
 	EventManager* EventManager::mInstance = NULL;
 
 	EventManager::EventManager()
-  : Logger("EventMgr")
+  : Logger("EventMgr"),
+    mPending(0),
+    mWorkers(0),
+    mInFlight(0)
   {
-		mLog->noticeStream() << "up and running";
+    mLaneWeights[EventLane::Critical] = 8;
+    mLaneWeights[EventLane::Major] = 4;
+    mLaneWeights[EventLane::Minor] = 1;
+    for (int lane = 0; lane < EventLane::Count; ++lane)
+      mLaneCredits[lane] = mLaneWeights[lane];
+
+    MetricsManager& metrics = MetricsManager::getSingleton();
+    mHooked = &metrics.counter("hax_events_hooked_total", "Events hooked onto the EventManager queue");
+    mDelivered = &metrics.counter("hax_event_deliveries_total", "Events enqueued to listeners");
+    mCoalesced = &metrics.counter("hax_events_coalesced_total", "Hooked events that replaced a pending one");
+    mQueueDepth = &metrics.gauge("hax_event_queue_depth", "Events waiting in the EventManager queue");
+    mFanOut = &metrics.histogram("hax_event_fanout", "Listeners an event is delivered to", 1);
+    mDispatchTime = &metrics.histogram("hax_event_dispatch_seconds", "Time spent delivering an event to its listeners");
+
+		HAX_LOG_NOTICE(mLog) << "up and running";
 	}
 
 	EventManager::~EventManager()
 	{
-		mLog->infoStream() << "shutting down";
+		HAX_LOG_INFO(mLog) << "shutting down";
 
 		// clean up events
-		while (!mEvents.empty())
-			mEvents.pop();
+		clear();
 
 		// clean up Listeners
 
@@ -67,6 +86,7 @@ namespace Hax {
 
   void EventManager::unsubscribe(unsigned char evt, EventListener* inListener)
   {
+    boost::mutex::scoped_lock lock(mSubscriptionsMutex);
     if (mSubscriptions.find(evt) == mSubscriptions.end())
     {
       mLog->warnStream() << "attempting to unbind an unsubscribed event " << (int)evt;
@@ -84,10 +104,120 @@ namespace Hax {
       }
 
   }
+  void EventManager::hook(const Event& inEvt)
+  {
+    boost::mutex::scoped_lock lock(mEventsMutex);
+    mHooked->inc();
+
+    std::map<EventUID_T, std::string>::const_iterator key = mCoalesceKeys.find(inEvt.UID);
+    if (key != mCoalesceKeys.end() && inEvt.hasProperty(key->second)) {
+      std::pair<EventUID_T, std::string> id(inEvt.UID, inEvt.getProperty(key->second));
+
+      std::map<std::pair<EventUID_T, std::string>, Event*>::iterator pending = mCoalescing.find(id);
+      if (pending != mCoalescing.end()) {
+        *pending->second = inEvt;
+        mCoalesced->inc();
+        return;
+      }
+
+      std::deque<Event>& lane = mLanes[getLane(inEvt.UID)];
+      lane.push_back(inEvt);
+      mCoalescing.insert(std::make_pair(id, &lane.back()));
+    }
+    else
+      mLanes[getLane(inEvt.UID)].push_back(inEvt);
+
+    ++mPending;
+    mQueueDepth->add();
+  }
+
+  int EventManager::getLane(EventUID_T evt) const
+  {
+    std::map<EventUID_T, int>::const_iterator lane = mLaneAssignments.find(evt);
+    return lane == mLaneAssignments.end() ? (int)EventLane::Major : lane->second;
+  }
+
+  void EventManager::setLane(EventUID_T evt, int lane)
+  {
+    if (lane < 0 || lane >= EventLane::Count) {
+      mLog->warnStream() << "ignoring an invalid lane " << lane << " for event " << (int)evt;
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mEventsMutex);
+    mLaneAssignments[evt] = lane;
+  }
+
+  void EventManager::setLaneWeight(int lane, unsigned weight)
+  {
+    if (lane < 0 || lane >= EventLane::Count) {
+      mLog->warnStream() << "ignoring the weight of an invalid lane " << lane;
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mEventsMutex);
+    mLaneWeights[lane] = std::max(weight, 1u);
+    mLaneCredits[lane] = std::min(mLaneCredits[lane], mLaneWeights[lane]);
+  }
+
+  void EventManager::coalesce(EventUID_T evt, std::string const& key)
+  {
+    boost::mutex::scoped_lock lock(mEventsMutex);
+
+    // forget about the pending events of this UID, they'll just be dispatched
+    std::map<std::pair<EventUID_T, std::string>, Event*>::iterator pending = mCoalescing.begin();
+    while (pending != mCoalescing.end()) {
+      if (pending->first.first == evt)
+        mCoalescing.erase(pending++);
+      else
+        ++pending;
+    }
+
+    if (key.empty())
+      mCoalesceKeys.erase(evt);
+    else
+      mCoalesceKeys[evt] = key;
+  }
+
+  int EventManager::nextLane()
+  {
+    if (!mPending)
+      return -1;
+
+    // weighted round robin: a lane may go as long as it has credits left, and
+    // once every busy lane has spent its credits a new round begins
+    for (int round = 0; round < 2; ++round) {
+      for (int lane = 0; lane < EventLane::Count; ++lane)
+        if (!mLanes[lane].empty() && mLaneCredits[lane]) {
+          --mLaneCredits[lane];
+          return lane;
+        }
+
+      for (int lane = 0; lane < EventLane::Count; ++lane)
+        mLaneCredits[lane] = mLaneWeights[lane];
+    }
+
+    return -1;
+  }
+
   void EventManager::update() {
-    if (!mEvents.empty())
+    HAX_TRACE_SCOPE("EventManager::update");
+
     {
-      subscription_t::iterator subs = mSubscriptions.find(mEvents.front().UID);
+      boost::mutex::scoped_lock lock(mEventsMutex);
+
+      int lane = nextLane();
+      if (lane == -1)
+        return;
+
+      std::deque<Event>& events = mLanes[lane];
+
+      ScopedTimer timer(*mDispatchTime);
+      uint64_t fanout = 0;
+
+      // lock order: mEventsMutex, then mSubscriptionsMutex
+      boost::mutex::scoped_lock subscriptions(mSubscriptionsMutex);
+      subscription_t::iterator subs = mSubscriptions.find(events.front().UID);
       if (subs != mSubscriptions.end()) {
         subscribers_t *handlers = &(subs->second);
         subscribers_t::iterator handler;
@@ -97,7 +227,8 @@ namespace Hax {
              //~ std::cout
               //~ << "enqueued an evt " << (int)mEvents.front().UID
               //~ << " to a listener " << (*handler)->getUID() << "\n";
-             (*handler)->enqueue(mEvents.front());
+             deliver(*handler, events.front());
+             ++fanout;
            }
          }
 
@@ -111,17 +242,129 @@ namespace Hax {
           //~ std::cout
             //~ << "enqueued an evt " << (int)mEvents.front().UID
             //~ << " to a full listener " << (*handler)->getUID() << "\n";
-          (*handler)->enqueue(mEvents.front());
+          deliver(*handler, events.front());
+          ++fanout;
         }
       }
+      subscriptions.unlock();
 
-      mEvents.pop();
+      std::map<EventUID_T, std::string>::const_iterator key = mCoalesceKeys.find(events.front().UID);
+      if (key != mCoalesceKeys.end() && events.front().hasProperty(key->second)) {
+        std::map<std::pair<EventUID_T, std::string>, Event*>::iterator pending =
+          mCoalescing.find(std::make_pair(events.front().UID, events.front().getProperty(key->second)));
+        if (pending != mCoalescing.end() && pending->second == &events.front())
+          mCoalescing.erase(pending);
+      }
+
+      events.pop_front();
+      --mPending;
+      mQueueDepth->sub();
+      mDelivered->inc(fanout);
+      mFanOut->record(fanout);
+    }
+
+    if (mScheduled.empty())
+      return;
+
+    // the job system mode: process the AnyThread listeners on the pool, and
+    // help out while waiting for them
+    mInFlight = mScheduled.size();
+    for (EventListener* listener : mScheduled)
+      mWorkers->submit(boost::bind(&EventManager::process, this, listener));
+
+    {
+      boost::mutex::scoped_lock lock(mInFlightMutex);
+      while (mInFlight) {
+        lock.unlock();
+        bool helped = mWorkers->help();
+        lock.lock();
+
+        if (!helped && mInFlight)
+          mJobsDone.wait(lock);
+      }
     }
+
+    for (EventListener* listener : mScheduled)
+      listener->fScheduled = false;
+
+    mScheduled.clear();
+
+    // the jobs are all done, so a handler that threw can be reported now
+    std::exception_ptr error;
+    {
+      boost::mutex::scoped_lock lock(mInFlightMutex);
+      std::swap(error, mJobError);
+    }
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  void EventManager::deliver(EventListener* listener, const Event& evt)
+  {
+    listener->enqueue(evt);
+
+    if (mWorkers && listener->mAffinity == EventListener::AnyThread && !listener->fScheduled) {
+      listener->fScheduled = true;
+      mScheduled.push_back(listener);
+    }
+  }
+
+  void EventManager::process(EventListener* listener)
+  {
+    // nothing may escape a job: it'd terminate a worker, or leave update()
+    // with jobs in flight when it's the one running it
+    std::exception_ptr error;
+    try {
+      listener->processEvents();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mInFlightMutex);
+      if (error && !mJobError)
+        mJobError = error;
+
+      --mInFlight;
+    }
+
+    mJobsDone.notify_all();
+  }
+
+  void EventManager::setWorkerPool(WorkerPool* pool)
+  {
+    mWorkers = pool;
+  }
+
+  bool EventManager::setup()
+  {
+    fSetup = true;
+    return true;
+  }
+
+  void EventManager::update(unsigned long)
+  {
+    update();
+  }
+
+  bool EventManager::cleanup()
+  {
+    clear();
+    fSetup = false;
+    return true;
   }
 
   void EventManager::clear()
   {
-    while (!mEvents.empty())
-      mEvents.pop();
+    boost::mutex::scoped_lock lock(mEventsMutex);
+
+    mQueueDepth->sub(mPending);
+
+    for (int lane = 0; lane < EventLane::Count; ++lane)
+      mLanes[lane].clear();
+
+    mCoalescing.clear();
+    mPending = 0;
   }
 }
@@ -44,6 +44,7 @@ namespace Hax {
     mSuffix = "linux";
 #   endif
 
+    defineOption("DistFromRoot", &mConfig.DistFromRoot, { "dist from root" }).defaultsTo("1");
   }
 
   FileManager::~FileManager()
@@ -66,14 +67,14 @@ namespace Hax {
 
     bool dontOverride = false;
 
-    mLog->infoStream() << "Resolving paths...";
+    HAX_LOG_INFO(mLog) << "Resolving paths...";
 
     // locate the binary and build its path
     
     // 1. Linux:
 #   if HAX_PLATFORM == HAX_PLATFORM_LINUX
 
-    mLog->infoStream() << "Platform: Linux";
+    HAX_LOG_INFO(mLog) << "Platform: Linux";
     
     // use binreloc and boost::filesystem to build up our paths
     int brres = br_init(0);
@@ -121,7 +122,7 @@ namespace Hax {
     // root is HAX_DISTANCE_FROM_ROOT directories up from the binary's
     path_t lRoot = mBinPath;
     int i;
-    for (i=0; i < Utility::convertTo<int>(mConfig.DistFromRoot); ++i) {
+    for (i=0; i < mConfig.DistFromRoot; ++i) {
       lRoot = lRoot.remove_leaf();
     }
 
@@ -156,20 +157,6 @@ namespace Hax {
     std::cout << "Log path: " <<  mLogPath << '\n';
   }
 
-  void FileManager::setOption(string_t const& key, string_t const& value)
-  {
-    if (key == "DistFromRoot" || key == "dist from root") {
-      mConfig.DistFromRoot = value;
-    }
-    else {
-      std::cerr << "unknown FileManager config setting '" << key << "' => '" << value << "', discarding";
-    }
-  }
-
-  void FileManager::setDefaults() {
-    mConfig.DistFromRoot = "1";
-  }
-  
   path_t const& FileManager::getRootPath()  const { return mRootPath; }
   path_t const& FileManager::getResourcesPath()   const { return mResPath; }
   path_t const& FileManager::getResPath()   const { return getResourcesPath(); }
@@ -200,7 +187,7 @@ namespace Hax {
     
     out_buf.erase(out_buf.size()-1,1);
     
-    mLog->debugStream() << "read file into memory: \n" << out_buf;
+    HAX_LOG_DEBUG(mLog) << "read file into memory: \n" << out_buf;
     return true;
   }
   
@@ -11,6 +11,8 @@
 #include "Hax/FileManager.hpp"
 #include "Hax/LogManager.hpp"
 #include "Hax/Configurator.hpp"
+#include "Hax/MetricsManager.hpp"
+#include "Hax/Tracer.hpp"
 
 namespace Hax {
   
@@ -23,10 +25,17 @@ namespace Hax {
     LogManager::getSingleton().configure();
     
     Configurator::subscribe(&LogManager::getSingleton(), "Log Manager");    
+
+    // these subscribe to their contexts when they're built, which has to
+    // happen before the configuration is parsed
+    MetricsManager::getSingleton();
+    Tracer::getSingleton();
   }
   
   void HaxCleanup()
   {
+    Tracer::getSingleton().shutdown();
+    MetricsManager::getSingleton().shutdown();
     LogManager::getSingleton().cleanup();    
   }
   
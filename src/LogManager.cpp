@@ -25,11 +25,15 @@
 #include "Hax/Utility.hpp"
 #include "Hax/FileManager.hpp"
 #include <map>
+#include <algorithm>
 
 namespace Hax {
 
   LogManager* LogManager::__instance = 0;
 
+  /** the "async buffer" used when the setting is out of range */
+  static const int DefaultAsyncBuffer = 8192;
+
   LogManager::LogManager()
   : Configurable(),
     mAppender(0),
@@ -39,9 +43,92 @@ namespace Hax {
     mAnonymousLog(0),
     mCategoryName("Hax")    
   {   
+    defineEnumOption("device", &mConfig.device, { "log interface", "log device" })
+      .value("file", DEVICE_FILE)
+      .value("stdout", DEVICE_STDOUT)
+      .value("syslog", DEVICE_SYSLOG)
+      .value("binary", DEVICE_BINARY)
+      .defaultsTo("stdout");
+    defineEnumOption("level", &mConfig.level, { "log level" })
+      .value("debug",  log4cpp::Priority::DEBUG)
+      .value("notice", log4cpp::Priority::NOTICE)
+      .value("info",   log4cpp::Priority::INFO)
+      .value("warn",   log4cpp::Priority::WARN)
+      .value("error",  log4cpp::Priority::ERROR)
+      .defaultsTo("debug");
+    defineOption("dir", &mConfig.dir, { "log directory", "directory" }).defaultsTo("log");
+    defineOption("filename", &mConfig.filename, { "log filename" }).defaultsTo("Hax.log");
+    defineBytesOption("filesize", &mConfig.filesize, { "log filesize" }).defaultsTo("10M");
+    defineOption("app_name", &mConfig.app_name, { "app name" }).defaultsTo("Hax");
+    defineOption("app_version", &mConfig.app_version, { "app version", "version" }).defaultsTo("v0.0.rv0");
+    defineOption("app_website", &mConfig.app_website, { "app website", "website" }).defaultsTo("http://www.hax.com");
+    defineOption("log header", &mConfig.header).defaultsTo("true");
+    defineOption("async", &mConfig.async, { "async logging" }).defaultsTo("false");
+    defineOption("async buffer", &mConfig.async_buffer, { "async buffer size" }).defaultsTo("8192");
+    defineEnumOption("overflow policy", &mConfig.overflow, { "async overflow policy" })
+      .value("block", AsyncAppender::Block)
+      .value("drop",  AsyncAppender::Drop)
+      .value("count", AsyncAppender::Count)
+      .defaultsTo("block");
+    defineOption("rate limit", &mConfig.rate_limit, { "log rate limit" }).defaultsTo("0");
+    defineOption("rate burst", &mConfig.rate_burst, { "log rate burst" }).defaultsTo("0");
+    defineOption("sample rate", &mConfig.sample_rate, { "log sample rate" }).defaultsTo("1");
+    defineOption("rate limits", &mConfig.rate_limits).defaultsTo("");
+    defineOption("sample rates", &mConfig.sample_rates).defaultsTo("");
+    defineDurationOption("suppression report", &mConfig.suppression_report, { "suppression report interval" })
+      .defaultsTo("10s");
+
+    mLiveConfig.publish(mConfig);
+
     init();
   }
 
+  /**
+   * Parses "Context=N[/burst], ..." overrides into the rules; N is the rate
+   * limit, or the sample rate when sampling.
+   */
+  static bool parse_log_rules(
+    string_t const& spec,
+    bool sampling,
+    RateLimitFilter::rule_t const& defaults,
+    std::map<string_t, RateLimitFilter::rule_t>& out_rules)
+  {
+    std::map<string_t, RateLimitFilter::rule_t> rules(out_rules);
+
+    for (string_t const& entry : Utility::split(spec, ',')) {
+      string_t rule_spec = Utility::trim(entry);
+      if (rule_spec.empty())
+        continue;
+
+      size_t eq = rule_spec.find('=');
+      if (eq == string_t::npos)
+        return false;
+
+      string_t context = Utility::trim(rule_spec.substr(0, eq));
+      std::vector<string_t> values = Utility::split(rule_spec.substr(eq + 1), '/');
+      if (context.empty() || values.empty() || values.size() > (sampling ? 1u : 2u))
+        return false;
+
+      if (!rules.count(context))
+        rules[context] = defaults;
+
+      RateLimitFilter::rule_t& rule = rules[context];
+      try {
+        if (sampling) {
+          rule.sample = Utility::convertTo<unsigned>(Utility::trim(values[0]));
+        } else {
+          rule.rate = Utility::convertTo<double>(Utility::trim(values[0]));
+          rule.burst = values.size() > 1 ? Utility::convertTo<double>(Utility::trim(values[1])) : 0;
+        }
+      } catch (BadConversion&) {
+        return false;
+      }
+    }
+
+    out_rules.swap(rules);
+    return true;
+  }
+
   LogManager::~LogManager()
   {
   }
@@ -97,21 +184,13 @@ namespace Hax {
     
   void LogManager::configure()
   {
+    // there's no update to reclaim from; the level is read with one copy, so
+    // a whole reload period is grace enough for any reader of the last one
+    mLiveConfig.quiesce();
+    mLiveConfig.publish(mConfig);
+
     // set the logging level
-    std::map< string_t, log4cpp::Priority::Value > str2prio;
-    str2prio.insert(std::make_pair("debug",  log4cpp::Priority::DEBUG));
-    str2prio.insert(std::make_pair("notice", log4cpp::Priority::NOTICE));
-    str2prio.insert(std::make_pair("info",   log4cpp::Priority::INFO));
-    str2prio.insert(std::make_pair("warn",   log4cpp::Priority::WARN));
-    str2prio.insert(std::make_pair("error",  log4cpp::Priority::ERROR));
-    
-    if (str2prio.find(mConfig.level) == str2prio.end()) {
-      std::cerr << "invalid logging level '" << mConfig.level << "', falling back to DEBUG\n";
-      
-      mConfig.level = "debug";
-    }
-    
-    mCategory->setPriority(str2prio[mConfig.level]);
+    mCategory->setPriority(mConfig.level);
 
     // remove the current appender
     if (mAppender) {
@@ -121,41 +200,79 @@ namespace Hax {
     
     // create the new appender
     bool using_syslog = false;
-    if (mConfig.device == "syslog")
+    if (mConfig.device == DEVICE_SYSLOG)
     {
       mAppender =	new log4cpp::SyslogAppender("SyslogAppender", mCategoryName);
       using_syslog = true;
     }
-    else if (mConfig.device == "stdout")
+    else if (mConfig.device == DEVICE_STDOUT)
     {
-      mAppender =	new log4cpp::OstreamAppender("STDOUTAppender", &std::cout);
+      mAppender =	new LineStreamAppender("STDOUTAppender", &std::cout);
     }
     else
     {
-      uint64_t filesz = 0;
-      if (!Utility::string_to_bytes(mConfig.filesize, &filesz)) {
-        std::cerr << "invalid log filesize '" << mConfig.filesize << ", defaulting to 10M\n";
-        filesz = 10 * 1024 * 1024;
-      }
-
       // make sure the directory exists
       FileManager& fmgr = FileManager::getSingleton();
       path_t mLogPath = fmgr.getRootPath() / path_t(mConfig.dir);
       if (!boost::filesystem::exists(mLogPath))
         boost::filesystem::create_directory(mLogPath);
             
-      mAppender =	
-      new log4cpp::RollingFileAppender(
-        "RollingFileAppender", 
-        mLogPath.make_preferred().string() + "/" + mConfig.filename,
-        filesz);
+      string_t log_file = mLogPath.make_preferred().string() + "/" + mConfig.filename;
+
+      if (mConfig.device == DEVICE_BINARY)
+        mAppender = new BinaryAppender("BinaryAppender", log_file, mConfig.filesize);
+      else
+        mAppender =	
+        new LineFileAppender(
+          "RollingFileAppender", 
+          log_file,
+          mConfig.filesize);
     }
     
+    // hand the device over to a writer thread; a bad buffer size is reported
+    // once the new appender is up
+    int async_buffer = std::min(mConfig.async_buffer, (int)AsyncAppender::MaxCapacity);
+    if (async_buffer <= 0)
+      async_buffer = DefaultAsyncBuffer;
+
+    if (mConfig.async) {
+      mAppender = new AsyncAppender(
+        "AsyncAppender",
+        mAppender,
+        (size_t)async_buffer,
+        (AsyncAppender::OverflowPolicy)mConfig.overflow);
+
+      AsyncAppender::installCrashHandler();
+    }
+
     // register the appender
     mCategory->addAppender(mAppender);
 
+    // keep noisy contexts in check; the filter goes on the outermost appender
+    // so that suppressed records aren't even queued when logging asynchronously
+    std::map<string_t, RateLimitFilter::rule_t> rules;
+    RateLimitFilter::rule_t defaults;
+    defaults.rate = mConfig.rate_limit;
+    defaults.burst = mConfig.rate_burst;
+    defaults.sample = mConfig.sample_rate;
+
+    if (!parse_log_rules(mConfig.rate_limits, false, defaults, rules))
+      mLog->warnStream() << "malformed 'rate limits' setting '" << mConfig.rate_limits << "', ignoring";
+    if (!parse_log_rules(mConfig.sample_rates, true, defaults, rules))
+      mLog->warnStream() << "malformed 'sample rates' setting '" << mConfig.sample_rates << "', ignoring";
+
+    if (defaults.rate > 0 || defaults.sample > 1 || !rules.empty()) {
+      RateLimitFilter* filter = new RateLimitFilter();
+      filter->setDefaultRule(defaults);
+      for (auto const& rule : rules)
+        filter->setRule(rule.first, rule.second);
+      filter->setReportAppender(mAppender, (unsigned)mConfig.suppression_report);
+
+      mAppender->setFilter(filter);
+    }
+
     // assign a vanilla appender layout for header logging
-    if (!mConfig.silent) {
+    if (mConfig.header) {
       mLayout = new VanillaLayout();
       mAppender->setLayout(mLayout);
   
@@ -167,8 +284,8 @@ namespace Hax {
       mLog->errorStream() << "\n+                         (" << mConfig.app_website << ")                             +";
       mLog->errorStream() << "\n+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+\n";
     
+      // the appender owns the layout and frees it once it's replaced
       mAppender->close();
-      delete mLayout;
     }
     
     // assign the real appender layout
@@ -180,71 +297,30 @@ namespace Hax {
     mAppender->setLayout(mLayout);
     mAppender->reopen();
     
-    mLog->getStream(str2prio[mConfig.level]) << "logging level set to " << mConfig.level;
+    mLog->getStream(mConfig.level)
+      << "logging level set to " << log4cpp::Priority::getPriorityName(mConfig.level);
     
-    if (mConfig.device == "file") {
-      mLog->getStream(str2prio[mConfig.level]) 
-      << "log file will be rotated every " << mConfig.filesize;
+    if (mConfig.device == DEVICE_FILE || mConfig.device == DEVICE_BINARY) {
+      mLog->getStream(mConfig.level) 
+      << "log file will be rotated every " << mConfig.filesize << " bytes";
     }
-  }
 
-  void LogManager::setOption(string_t const& key, string_t const& value)
-  {
-    if (key == "device" || key == "log interface" || key == "log device" || key == "device")
-    {
-      if (value == "syslog")
-        mConfig.device = value;
-      else if (value == "stdout")
-        mConfig.device = value;
-      else if (value == "file")
-        mConfig.device = value;
-      else {
-        mLog->warnStream() << "unknown logging mechanism specified '" << value << "', falling back to 'file'";
-        mConfig.device = "file";
-      }
-    }
-    else if (key == "filesize" || key == "log filesize" || key == "filesize") {
-      mConfig.filesize = value;
-    }
-    else if (key == "filename" || key == "log filename" || key == "filename") {
-      mConfig.filename = value;
-    }
-    else if (key == "dir" || key == "log directory" || key == "directory") {
-      mConfig.dir = value;
-    }
-    else if (key == "level" || key == "log level" || key == "level") {
-      mConfig.level = value;
-    }
-    else if (key == "app_name" || key == "app name") {
-      mConfig.app_name = value;
-    }
-    else if (key == "app_version" || key == "app version" || key == "version") {
-      mConfig.app_version = value;
-    }
-    else if (key == "app_website" || key == "app website" || key == "website") {
-      mConfig.app_website = value;
-    }
-    else if (key == "log header") {
-      mConfig.silent = (value == "false") ? true : false;
-    }
-    else {
-      mLog->warnStream() << "unknown LogManager config setting '" << key << "' => '" << value << "', discarding";
+    if (mConfig.async) {
+      if (async_buffer != mConfig.async_buffer)
+        mLog->warnStream()
+        << "invalid 'async buffer' setting " << mConfig.async_buffer
+        << ", it must be between 1 and " << (int)AsyncAppender::MaxCapacity << "; using " << async_buffer;
+
+      mLog->getStream(mConfig.level)
+      << "logging asynchronously, buffering up to " << async_buffer << " records";
     }
   }
 
-  void LogManager::setDefaults() {
-    mConfig.device = "stdout";
-    mConfig.dir = "log";
-    mConfig.filename = "Hax.log";
-    mConfig.level = "debug";
-    mConfig.filesize = "10M";
-    mConfig.app_name = "Hax";
-    mConfig.app_version = "v0.0.rv0";
-    mConfig.app_website = "http://www.hax.com";
-    mConfig.silent = false;    
+  void LogManager::setSilent(bool inFlag) {
+    mConfig.header = !inFlag;
   }
 
-  void LogManager::setSilent(bool inFlag) {
-    mConfig.silent = inFlag;
+  int LogManager::getLevel() const {
+    return mLiveConfig->level;
   }
 } // namespace Hax
@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/LuaAllocator.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace Hax {
+
+  LuaAllocator::LuaAllocator()
+  : mCursor(0),
+    mEnd(0),
+    mBytes(0),
+    mPeakBytes(0),
+    mChunkBytes(0)
+  {
+    for (size_t i = 0; i < Classes; ++i)
+      mFree[i] = 0;
+  }
+
+  LuaAllocator::~LuaAllocator()
+  {
+    for (char* chunk : mChunks)
+      free(chunk);
+  }
+
+  void* LuaAllocator::allocate(void* ud, void* ptr, size_t osize, size_t nsize)
+  {
+    LuaAllocator* allocator = (LuaAllocator*)ud;
+
+    void* block;
+    if (nsize == 0) {
+      allocator->release(ptr, osize);
+      block = 0;
+    }
+    else if (!ptr)
+      block = allocator->alloc(nsize);
+    else
+      block = allocator->resize(ptr, osize, nsize);
+
+    // a failed allocation leaves the old block in place
+    if (block || nsize == 0) {
+      size_t bytes = allocator->mBytes.load(std::memory_order_relaxed) + nsize - (ptr ? osize : 0);
+      allocator->mBytes.store(bytes, std::memory_order_relaxed);
+
+      if (bytes > allocator->mPeakBytes.load(std::memory_order_relaxed))
+        allocator->mPeakBytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    return block;
+  }
+
+  void* LuaAllocator::alloc(size_t size)
+  {
+    if (size > MaxPooled)
+      return malloc(size);
+
+    size_t index = getClass(size);
+    if (block_t* block = mFree[index]) {
+      mFree[index] = block->next;
+      return block;
+    }
+
+    // carve a new block off the current chunk, or a new chunk
+    size_t block_size = (index + 1) * Granularity;
+    if (mCursor + block_size > mEnd) {
+      char* chunk = (char*)malloc(ChunkSize);
+      if (!chunk)
+        return 0;
+
+      mChunks.push_back(chunk);
+      mCursor = chunk;
+      mEnd = chunk + ChunkSize;
+      mChunkBytes.store(mChunkBytes.load(std::memory_order_relaxed) + ChunkSize, std::memory_order_relaxed);
+    }
+
+    void* block = mCursor;
+    mCursor += block_size;
+    return block;
+  }
+
+  void LuaAllocator::release(void* ptr, size_t size)
+  {
+    if (!ptr)
+      return;
+
+    if (size > MaxPooled) {
+      free(ptr);
+      return;
+    }
+
+    block_t* block = (block_t*)ptr;
+    size_t index = getClass(size);
+    block->next = mFree[index];
+    mFree[index] = block;
+  }
+
+  void* LuaAllocator::resize(void* ptr, size_t osize, size_t nsize)
+  {
+    if (osize > MaxPooled && nsize > MaxPooled)
+      return realloc(ptr, nsize);
+
+    if (osize <= MaxPooled && nsize <= MaxPooled && getClass(osize) == getClass(nsize))
+      return ptr;
+
+    void* block = alloc(nsize);
+    if (!block) {
+      // Lua assumes shrinking never fails; the old block is big enough
+      return nsize < osize ? ptr : 0;
+    }
+
+    memcpy(block, ptr, std::min(osize, nsize));
+    release(ptr, osize);
+    return block;
+  }
+
+  size_t LuaAllocator::getBytes() const
+  {
+    return mBytes.load(std::memory_order_relaxed);
+  }
+
+  size_t LuaAllocator::getPeakBytes() const
+  {
+    return mPeakBytes.load(std::memory_order_relaxed);
+  }
+
+  size_t LuaAllocator::getChunkBytes() const
+  {
+    return mChunkBytes.load(std::memory_order_relaxed);
+  }
+
+} // namespace Hax
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/LuaExporter.hpp"
+
+namespace Hax {
+
+  /** the registry key of the per-type userdata caches */
+  static char gCachesKey;
+
+  void LuaExporterBase::pushCache(lua_State* lua, const char* data_type)
+  {
+    lua_pushlightuserdata(lua, &gCachesKey);
+    lua_rawget(lua, LUA_REGISTRYINDEX);
+
+    if (lua_isnil(lua, -1)) {
+      lua_pop(lua, 1);
+      lua_newtable(lua);
+
+      lua_pushlightuserdata(lua, &gCachesKey);
+      lua_pushvalue(lua, -2);
+      lua_rawset(lua, LUA_REGISTRYINDEX);
+    }
+
+    lua_getfield(lua, -1, data_type);
+
+    if (lua_isnil(lua, -1)) {
+      lua_pop(lua, 1);
+      lua_newtable(lua);
+
+      // weak values: the exports and the scripts hold on to the userdata
+      lua_createtable(lua, 0, 1);
+      lua_pushstring(lua, "v");
+      lua_setfield(lua, -2, "__mode");
+      lua_setmetatable(lua, -2);
+
+      lua_pushvalue(lua, -1);
+      lua_setfield(lua, -3, data_type);
+    }
+
+    lua_remove(lua, -2);
+  }
+
+  void LuaExporterBase::pushCached(lua_State* lua, int cache, void* object, const char* data_type)
+  {
+    lua_pushlightuserdata(lua, object);
+    lua_rawget(lua, cache);
+
+    if (!lua_isnil(lua, -1))
+      return;
+
+    lua_pop(lua, 1);
+    tolua_pushusertype(lua, object, data_type);
+
+    lua_pushlightuserdata(lua, object);
+    lua_pushvalue(lua, -2);
+    lua_rawset(lua, cache);
+  }
+
+} // namespace Hax
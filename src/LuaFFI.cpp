@@ -0,0 +1,135 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/LuaFFI.hpp"
+
+extern "C" {
+	#include "lauxlib.h"
+}
+
+namespace Hax {
+
+  FlatEvent::FlatEvent()
+  {
+    mEvent.uid = 0;
+    mEvent.options = 0;
+    mEvent.feedback = 0;
+    mEvent.length = 0;
+    mEvent.property_count = 0;
+    mEvent.properties = 0;
+  }
+
+  hax_event_t const* FlatEvent::assign(const Event& evt)
+  {
+    mProperties.resize(evt.Properties.size());
+
+    size_t i = 0;
+    for (Event::property_t::const_iterator property = evt.Properties.begin();
+         property != evt.Properties.end();
+         ++property, ++i)
+    {
+      hax_property_t& flat = mProperties[i];
+      flat.key = property->first.data();
+      flat.key_length = (uint32_t)property->first.size();
+      flat.value = property->second.data();
+      flat.value_length = (uint32_t)property->second.size();
+    }
+
+    mEvent.uid = evt.UID;
+    mEvent.options = evt.Options;
+    mEvent.feedback = evt.Feedback;
+    mEvent.length = evt.Length;
+    mEvent.property_count = (uint32_t)mProperties.size();
+    mEvent.properties = mProperties.empty() ? 0 : &mProperties[0];
+
+    return &mEvent;
+  }
+
+  hax_event_t const* FlatEvent::get() const
+  {
+    return &mEvent;
+  }
+
+  namespace LuaFFI {
+
+    const char* CDef =
+      "typedef struct {"
+      "  const char* key;"
+      "  uint32_t    key_length;"
+      "  const char* value;"
+      "  uint32_t    value_length;"
+      "} hax_property_t;"
+      "typedef struct {"
+      "  uint8_t               uid;"
+      "  uint8_t               options;"
+      "  uint8_t               feedback;"
+      "  uint32_t              length;"
+      "  uint32_t              property_count;"
+      "  const hax_property_t* properties;"
+      "} hax_event_t;"
+      "int memcmp(const void*, const void*, size_t);";
+
+    /** run with the cdef string as its argument */
+    static const char* Prelude =
+      "local ffi = require('ffi')\n"
+      "ffi.cdef(...)\n"
+      "local event_ptr = ffi.typeof('const hax_event_t*')\n"
+      "Hax = Hax or {}\n"
+      "function Hax.flatEvent(ptr)\n"
+      "  return ffi.cast(event_ptr, ptr)\n"
+      "end\n"
+      "function Hax.flatProperty(evt, name)\n"
+      "  local length = #name\n"
+      "  for i = 0, evt.property_count - 1 do\n"
+      "    local p = evt.properties[i]\n"
+      "    if p.key_length == length and ffi.C.memcmp(p.key, name, length) == 0 then\n"
+      "      return ffi.string(p.value, p.value_length)\n"
+      "    end\n"
+      "  end\n"
+      "  return nil\n"
+      "end\n";
+
+    bool open(lua_State* lua)
+    {
+#ifdef HAX_LUAJIT
+      if (luaL_loadstring(lua, Prelude) != 0) {
+        lua_pop(lua, 1);
+        return false;
+      }
+
+      lua_pushstring(lua, CDef);
+      if (lua_pcall(lua, 1, 0, 0) != 0) {
+        lua_pop(lua, 1);
+        return false;
+      }
+
+      return true;
+#else
+      (void)lua;
+      (void)Prelude;
+      return false;
+#endif
+    }
+
+  } // namespace LuaFFI
+} // namespace Hax
@@ -0,0 +1,161 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/LuaProfiler.hpp"
+#include "Hax/Tracer.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+namespace Hax {
+
+  LuaProfiler::LuaProfiler()
+  : fRunning(false),
+    mDeadline(0),
+    mLastSample(0),
+    mSamples(0)
+  {
+  }
+
+  LuaProfiler::~LuaProfiler()
+  {
+  }
+
+  void LuaProfiler::start(uint64_t lDurationNs)
+  {
+    mStacks.clear();
+    mLines.clear();
+    mSamples = 0;
+
+    mLastSample = Tracer::now();
+    mDeadline = lDurationNs ? mLastSample + lDurationNs : 0;
+    fRunning = true;
+  }
+
+  void LuaProfiler::stop()
+  {
+    fRunning = false;
+  }
+
+  bool LuaProfiler::isRunning() const
+  {
+    return fRunning;
+  }
+
+  bool LuaProfiler::isDue() const
+  {
+    return fRunning && mDeadline && Tracer::now() >= mDeadline;
+  }
+
+  void LuaProfiler::resume()
+  {
+    mLastSample = Tracer::now();
+  }
+
+  void LuaProfiler::onCount(lua_State* lua, lua_Debug* /* ar */)
+  {
+    uint64_t now = Tracer::now();
+    uint64_t elapsed = now > mLastSample ? now - mLastSample : 0;
+    mLastSample = now;
+    ++mSamples;
+
+    // walk the stack from the interrupted function outwards
+    lua_Debug frame;
+    size_t depth = 0;
+    char line[16];
+
+    for (int level = 0; depth < MaxDepth && lua_getstack(lua, level, &frame); ++level) {
+      if (!lua_getinfo(lua, "Sln", &frame))
+        break;
+
+      if (depth == mFrames.size())
+        mFrames.push_back(string_t());
+
+      string_t& label = mFrames[depth++];
+
+      if (frame.what[0] == 'C') {
+        label.assign("[C] ");
+        label.append(frame.name ? frame.name : "?");
+        continue;
+      }
+
+      snprintf(line, sizeof(line), ":%d", frame.currentline);
+
+      label.assign(frame.what[0] == 'm' ? "main" : (frame.name ? frame.name : "?"));
+      label.append("@");
+      label.append(frame.short_src);
+      label.append(line);
+
+      // the line the interrupted function is running
+      if (depth == 1) {
+        mStack.assign(frame.short_src);
+        mStack.append(line);
+        mLines[mStack] += elapsed;
+      }
+    }
+
+    if (!depth)
+      return;
+
+    // folded stacks list the outermost frame first
+    mStack.clear();
+    for (size_t i = depth; i > 0; --i) {
+      mStack.append(mFrames[i - 1]);
+      if (i > 1)
+        mStack.append(";");
+    }
+
+    mStacks[mStack] += elapsed;
+  }
+
+  uint64_t LuaProfiler::getSamples() const
+  {
+    return mSamples;
+  }
+
+  std::vector<std::pair<string_t, uint64_t>> LuaProfiler::getLines() const
+  {
+    std::vector<std::pair<string_t, uint64_t>> lines(mLines.begin(), mLines.end());
+
+    std::sort(lines.begin(), lines.end(), [](std::pair<string_t, uint64_t> const& a, std::pair<string_t, uint64_t> const& b) {
+      return a.second > b.second;
+    });
+
+    return lines;
+  }
+
+  bool LuaProfiler::write(string_t const& path) const
+  {
+    std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!out.is_open())
+      return false;
+
+    // flame graphs want integral weights, sub-microsecond stacks still count
+    for (std::pair<string_t const, uint64_t> const& stack : mStacks)
+      out << stack.first << ' ' << std::max<uint64_t>(stack.second / 1000, 1) << '\n';
+
+    return out.good();
+  }
+
+} // namespace Hax
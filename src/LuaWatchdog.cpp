@@ -0,0 +1,140 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/LuaWatchdog.hpp"
+#include "Hax/Tracer.hpp"
+
+#include <cstdio>
+#include <algorithm>
+
+namespace Hax {
+
+  LuaWatchdog::LuaWatchdog()
+  : mCallBudget(0),
+    mTickBudget(0),
+    mCallCount(0),
+    mTickCount(0),
+    mDepth(0),
+    mExceeded(NoBudget),
+    mLastSample(0)
+  {
+  }
+
+  LuaWatchdog::~LuaWatchdog()
+  {
+  }
+
+  void LuaWatchdog::setBudgets(uint64_t lCallBudget, uint64_t lTickBudget)
+  {
+    mCallBudget = lCallBudget;
+    mTickBudget = lTickBudget;
+  }
+
+  void LuaWatchdog::beginCall()
+  {
+    if (mDepth++)
+      return;
+
+    mCallCount = 0;
+    mExceeded = NoBudget;
+    mLastSample = Tracer::now();
+  }
+
+  void LuaWatchdog::endCall()
+  {
+    if (mDepth)
+      --mDepth;
+  }
+
+  void LuaWatchdog::beginTick()
+  {
+    mTickCount = 0;
+  }
+
+  LuaWatchdog::Budget LuaWatchdog::onCount(lua_State* lua, lua_Debug* ar, int lInstructions)
+  {
+    uint64_t now = Tracer::now();
+
+    if (lua_getinfo(lua, "S", ar)) {
+      char line[16];
+      snprintf(line, sizeof(line), ":%d", ar->linedefined);
+      mName.assign(ar->short_src);
+      mName.append(line);
+
+      std::map<string_t, function_t>::iterator function = mFunctions.find(mName);
+      if (function == mFunctions.end())
+        function = mFunctions.insert(std::make_pair(mName, function_t { mName, 0, 0 })).first;
+
+      function->second.instructions += lInstructions;
+      if (mLastSample && now > mLastSample)
+        function->second.nanoseconds += now - mLastSample;
+    }
+
+    mLastSample = now;
+
+    // scripts run by runScript() aren't calls
+    if (!mDepth)
+      return NoBudget;
+
+    mCallCount += lInstructions;
+    mTickCount += lInstructions;
+
+    if (mCallBudget && mCallCount > mCallBudget)
+      mExceeded = CallBudget;
+    else if (mTickBudget && mTickCount > mTickBudget)
+      mExceeded = TickBudget;
+
+    return mExceeded;
+  }
+
+  bool LuaWatchdog::isTickSpent() const
+  {
+    return mTickBudget && mTickCount > mTickBudget;
+  }
+
+  LuaWatchdog::Budget LuaWatchdog::getExceeded() const
+  {
+    return mExceeded;
+  }
+
+  std::vector<LuaWatchdog::function_t> LuaWatchdog::getFunctions() const
+  {
+    std::vector<function_t> functions;
+    functions.reserve(mFunctions.size());
+
+    for (std::pair<string_t const, function_t> const& function : mFunctions)
+      functions.push_back(function.second);
+
+    std::sort(functions.begin(), functions.end(), [](function_t const& a, function_t const& b) {
+      return a.nanoseconds > b.nanoseconds;
+    });
+
+    return functions;
+  }
+
+  void LuaWatchdog::resetFunctions()
+  {
+    mFunctions.clear();
+  }
+
+} // namespace Hax
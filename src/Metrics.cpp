@@ -0,0 +1,138 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/Metrics.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace Hax {
+
+  static std::atomic<unsigned> gNextShard(0);
+
+  Counter::Counter()
+  {
+    for (int i = 0; i < Shards; ++i)
+      mShards[i].value.store(0, std::memory_order_relaxed);
+  }
+
+  unsigned Counter::getShard()
+  {
+    static thread_local unsigned tShard = gNextShard.fetch_add(1, std::memory_order_relaxed) % Shards;
+    return tShard;
+  }
+
+  uint64_t Counter::value() const
+  {
+    uint64_t total = 0;
+    for (int i = 0; i < Shards; ++i)
+      total += mShards[i].value.load(std::memory_order_relaxed);
+
+    return total;
+  }
+
+  Gauge::Gauge()
+  : mValue(0)
+  {
+  }
+
+  Histogram::Histogram(double unit)
+  : mUnit(unit),
+    mCount(0),
+    mSum(0)
+  {
+    for (int i = 0; i < Buckets; ++i)
+      mBuckets[i].store(0, std::memory_order_relaxed);
+  }
+
+  unsigned Histogram::getBucket(uint64_t value)
+  {
+    if (value < SubBuckets)
+      return (unsigned)value;
+
+#ifdef __GNUC__
+    unsigned magnitude = 63 - __builtin_clzll(value);
+#else
+    unsigned magnitude = 0;
+    for (uint64_t v = value; v >>= 1;)
+      ++magnitude;
+#endif
+    unsigned shift = magnitude - SubBucketBits;
+    unsigned sub = (unsigned)(value >> shift) - SubBuckets;
+
+    return (shift + 1) * SubBuckets + sub;
+  }
+
+  uint64_t Histogram::getBucketCeiling(unsigned bucket)
+  {
+    if (bucket < SubBuckets)
+      return bucket;
+
+    unsigned shift = bucket / SubBuckets - 1;
+    uint64_t floor = (uint64_t)(SubBuckets + bucket % SubBuckets) << shift;
+
+    return floor + (((uint64_t)1 << shift) - 1);
+  }
+
+  uint64_t Histogram::count() const
+  {
+    return mCount.load(std::memory_order_relaxed);
+  }
+
+  double Histogram::sum() const
+  {
+    return mSum.load(std::memory_order_relaxed) * mUnit;
+  }
+
+  double Histogram::getUnit() const
+  {
+    return mUnit;
+  }
+
+  double Histogram::quantile(double q) const
+  {
+    // the buckets are read one by one while they may still be bumped, so
+    // count them rather than trusting mCount
+    uint64_t counts[Buckets];
+    uint64_t total = 0;
+    for (int i = 0; i < Buckets; ++i)
+      total += (counts[i] = mBuckets[i].load(std::memory_order_relaxed));
+
+    if (total == 0)
+      return std::numeric_limits<double>::quiet_NaN();
+
+    uint64_t rank = (uint64_t)std::ceil(q * total);
+    if (rank == 0)
+      rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < Buckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank)
+        return getBucketCeiling(i) * mUnit;
+    }
+
+    return getBucketCeiling(Buckets - 1) * mUnit;
+  }
+
+} // namespace Hax
@@ -0,0 +1,234 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/MetricsManager.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+namespace Hax {
+
+  MetricsManager* MetricsManager::__instance = 0;
+
+  MetricsManager::MetricsManager()
+  : Logger("Metrics"),
+    Configurable({ "Metrics" }),
+    mDumper(0)
+  {
+    defineOption("Dump File", &mConfig.DumpFile, { "dump file" }).defaultsTo("");
+    defineDurationOption("Dump Interval", &mConfig.DumpInterval, { "dump interval" }).defaultsTo("15s");
+  }
+
+  MetricsManager::~MetricsManager()
+  {
+    shutdown();
+  }
+
+  MetricsManager& MetricsManager::getSingleton() {
+    if (!__instance)
+      __instance = new MetricsManager();
+
+    return *__instance;
+  }
+
+  MetricsManager::metric_t& MetricsManager::getOrCreate(
+    string_t const& name,
+    string_t const& help,
+    string_t const& type)
+  {
+    metrics_t::iterator entry = mMetrics.find(name);
+    if (entry != mMetrics.end()) {
+      assert(entry->second.type == type);
+      return entry->second;
+    }
+
+    metric_t& metric = mMetrics[name];
+    metric.help = help;
+    metric.type = type;
+
+    return metric;
+  }
+
+  Counter& MetricsManager::counter(string_t const& name, string_t const& help)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    metric_t& metric = getOrCreate(name, help, "counter");
+    if (!metric.counter)
+      metric.counter.reset(new Counter());
+
+    return *metric.counter;
+  }
+
+  Gauge& MetricsManager::gauge(string_t const& name, string_t const& help)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    metric_t& metric = getOrCreate(name, help, "gauge");
+    if (!metric.gauge)
+      metric.gauge.reset(new Gauge());
+
+    return *metric.gauge;
+  }
+
+  Histogram& MetricsManager::histogram(string_t const& name, string_t const& help, double unit)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    metric_t& metric = getOrCreate(name, help, "summary");
+    if (!metric.histogram)
+      metric.histogram.reset(new Histogram(unit));
+
+    return *metric.histogram;
+  }
+
+  void MetricsManager::callback(
+    string_t const& name,
+    string_t const& help,
+    string_t const& type,
+    std::function<double()> value)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    getOrCreate(name, help, type).callback = value;
+  }
+
+  /**
+   * Splits "name{labels}" into the family name and the label list (without
+   * the braces).
+   */
+  static void split_metric_name(string_t const& name, string_t& family, string_t& labels)
+  {
+    size_t brace = name.find('{');
+    if (brace == string_t::npos) {
+      family = name;
+      labels.clear();
+      return;
+    }
+
+    family = name.substr(0, brace);
+    labels = name.substr(brace + 1, name.size() - brace - 2);
+  }
+
+  void MetricsManager::dump(std::ostream& out)
+  {
+    static const double Quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    boost::mutex::scoped_lock lock(mMutex);
+
+    out.precision(std::numeric_limits<double>::digits10);
+
+    string_t last_family, family, labels;
+    for (metrics_t::const_iterator entry = mMetrics.begin(); entry != mMetrics.end(); ++entry) {
+      metric_t const& metric = entry->second;
+
+      split_metric_name(entry->first, family, labels);
+      if (family != last_family) {
+        out << "# HELP " << family << " " << metric.help << "\n";
+        out << "# TYPE " << family << " " << metric.type << "\n";
+        last_family = family;
+      }
+
+      if (metric.callback)
+        out << entry->first << " " << metric.callback() << "\n";
+      else if (metric.counter)
+        out << entry->first << " " << metric.counter->value() << "\n";
+      else if (metric.gauge)
+        out << entry->first << " " << metric.gauge->value() << "\n";
+      else if (metric.histogram) {
+        string_t prefix = labels.empty() ? "{" : "{" + labels + ",";
+        string_t suffix = labels.empty() ? "" : "{" + labels + "}";
+
+        for (double q : Quantiles)
+          out << family << prefix << "quantile=\"" << q << "\"} " << metric.histogram->quantile(q) << "\n";
+
+        out << family << "_sum" << suffix << " " << metric.histogram->sum() << "\n";
+        out << family << "_count" << suffix << " " << metric.histogram->count() << "\n";
+      }
+    }
+  }
+
+  bool MetricsManager::dump(string_t const& path)
+  {
+    string_t tmp_path = path + ".tmp";
+
+    {
+      std::ofstream fh(tmp_path.c_str(), std::ios::out | std::ios::trunc);
+      if (!fh.is_open()) {
+        mLog->errorStream() << "unable to write metrics to '" << tmp_path << "'";
+        return false;
+      }
+
+      dump(fh);
+    }
+
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+      mLog->errorStream() << "unable to move metrics into '" << path << "'";
+      return false;
+    }
+
+    return true;
+  }
+
+  void MetricsManager::configure()
+  {
+    shutdown();
+
+    if (mConfig.DumpFile.empty())
+      return;
+
+    uint64_t interval = mConfig.DumpInterval ? mConfig.DumpInterval : 1;
+
+    HAX_LOG_INFO(mLog) << "dumping metrics to '" << mConfig.DumpFile
+      << "' every " << interval << " seconds";
+
+    mDumper = new boost::thread(boost::bind(&MetricsManager::run, this, mConfig.DumpFile, interval));
+  }
+
+  void MetricsManager::shutdown()
+  {
+    if (!mDumper)
+      return;
+
+    mDumper->interrupt();
+    mDumper->join();
+    delete mDumper;
+    mDumper = 0;
+  }
+
+  void MetricsManager::run(string_t path, uint64_t interval)
+  {
+    try {
+      for (;;) {
+        boost::this_thread::sleep(boost::posix_time::seconds((long)interval));
+        dump(path);
+      }
+    } catch (boost::thread_interrupted&) {
+      // one last time so the file reflects the final state
+      dump(path);
+    }
+  }
+
+} // namespace Hax
@@ -0,0 +1,241 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/ScriptCache.hpp"
+#include "Hax/MetricsManager.hpp"
+
+extern "C" {
+	#include "lauxlib.h"
+}
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+
+namespace Hax {
+
+  namespace {
+
+    /** bumped whenever the entry layout changes */
+    const char* Magic = "HAXC1";
+
+#ifdef HAX_LUAJIT
+    const char* Flavour = "LuaJIT";
+#else
+    const char* Flavour = "Lua 5.1";
+#endif
+
+    bool readFile(string_t const& path, string_t& out)
+    {
+      std::ifstream fh(path.c_str(), std::ios::in | std::ios::binary);
+      if (!fh.is_open())
+        return false;
+
+      std::ostringstream buffer;
+      buffer << fh.rdbuf();
+      out = buffer.str();
+      return true;
+    }
+
+    /**
+     * The first line of an entry, identifying the source it was compiled
+     * from; the bytecode follows it.
+     */
+    string_t describe(string_t const& path, string_t const& source)
+    {
+      boost::crc_32_type crc;
+      crc.process_bytes(source.data(), source.size());
+
+      std::ostringstream header;
+      header << Magic << " " << Flavour
+        << " " << (int64_t)boost::filesystem::last_write_time(path)
+        << " " << source.size()
+        << " " << std::hex << crc.checksum()
+        << "\n";
+
+      return header.str();
+    }
+
+    int write(lua_State*, const void* data, size_t size, void* out)
+    {
+      ((string_t*)out)->append((const char*)data, size);
+      return 0;
+    }
+  }
+
+  ScriptCache::ScriptCache(string_t const& directory)
+  : Logger("ScriptCache"),
+    mDirectory(directory)
+  {
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(mDirectory, ec))
+      boost::filesystem::create_directories(mDirectory, ec);
+
+    if (ec)
+      mLog->errorStream() << "unable to create the script cache at '" << mDirectory << "': " << ec.message();
+
+    MetricsManager& metrics = MetricsManager::getSingleton();
+    mHits = &metrics.counter("hax_script_cache_hits_total", "Scripts loaded off the bytecode cache");
+    mMisses = &metrics.counter("hax_script_cache_misses_total", "Scripts compiled because their cache entry was missing or stale");
+  }
+
+  ScriptCache::~ScriptCache()
+  {
+  }
+
+  string_t ScriptCache::getEntryPath(string_t const& path) const
+  {
+    boost::crc_32_type crc;
+    crc.process_bytes(path.data(), path.size());
+
+    std::ostringstream entry;
+    entry << boost::filesystem::path(path).filename().string()
+      << "." << std::hex << std::setw(8) << std::setfill('0') << crc.checksum()
+      << ".luac";
+
+    return (boost::filesystem::path(mDirectory) / entry.str()).string();
+  }
+
+  int ScriptCache::load(lua_State* lua, string_t const& path)
+  {
+    string_t source;
+    if (!readFile(path, source)) {
+      lua_pushfstring(lua, "cannot open %s", path.c_str());
+      return LUA_ERRFILE;
+    }
+
+    const string_t chunkname = "@" + path;
+    const string_t header = describe(path, source);
+
+    string_t entry;
+    if (readFile(getEntryPath(path), entry) &&
+        entry.size() > header.size() &&
+        entry.compare(0, header.size(), header) == 0)
+    {
+      int ec = luaL_loadbuffer(lua, entry.data() + header.size(), entry.size() - header.size(), chunkname.c_str());
+      if (ec == 0) {
+        mHits->inc();
+        return 0;
+      }
+
+      // a corrupt entry, or bytecode from a different build; recompile it
+      HAX_LOG_DEBUG(mLog) << "discarding the cache entry of '" << path << "': " << lua_tostring(lua, -1);
+      lua_pop(lua, 1);
+    }
+
+    mMisses->inc();
+
+    int ec = luaL_loadbuffer(lua, source.data(), source.size(), chunkname.c_str());
+    if (ec == 0)
+      store(lua, path, header);
+
+    return ec;
+  }
+
+  bool ScriptCache::compile(lua_State* lua, string_t const& path)
+  {
+    string_t source;
+    if (!readFile(path, source)) {
+      mLog->errorStream() << "unable to read script '" << path << "'";
+      return false;
+    }
+
+    const string_t chunkname = "@" + path;
+    if (luaL_loadbuffer(lua, source.data(), source.size(), chunkname.c_str()) != 0) {
+      mLog->errorStream() << "unable to compile script '" << path << "': " << lua_tostring(lua, -1);
+      lua_pop(lua, 1);
+      return false;
+    }
+
+    bool stored = store(lua, path, describe(path, source));
+    lua_pop(lua, 1);
+
+    return stored;
+  }
+
+  bool ScriptCache::store(lua_State* lua, string_t const& path, string_t const& header)
+  {
+    string_t entry = header;
+    if (lua_dump(lua, &write, &entry) != 0) {
+      mLog->warnStream() << "unable to dump the bytecode of '" << path << "'";
+      return false;
+    }
+
+    // write it aside then move it in place so a reader never sees half of it;
+    // the temporary name is unique, other processes may be storing it too
+    string_t entry_path = getEntryPath(path);
+    const string_t pattern = entry_path + ".XXXXXX";
+    std::vector<char> tmp_name(pattern.c_str(), pattern.c_str() + pattern.size() + 1);
+
+    int fd = mkstemp(&tmp_name[0]);
+    if (fd == -1) {
+      mLog->warnStream() << "unable to create a temporary cache entry for '" << path << "' next to '" << entry_path << "'";
+      return false;
+    }
+
+    string_t tmp_path(&tmp_name[0]);
+    fchmod(fd, 0644);
+
+    const char* data = entry.data();
+    size_t left = entry.size();
+    while (left) {
+      ssize_t written = ::write(fd, data, left);
+      if (written == -1 && errno == EINTR)
+        continue;
+
+      if (written <= 0) {
+        mLog->warnStream() << "unable to write the cache entry of '" << path << "' to '" << tmp_path << "'";
+        close(fd);
+        remove(tmp_path.c_str());
+        return false;
+      }
+
+      data += written;
+      left -= (size_t)written;
+    }
+
+    if (close(fd) != 0) {
+      mLog->warnStream() << "unable to write the cache entry of '" << path << "' to '" << tmp_path << "'";
+      remove(tmp_path.c_str());
+      return false;
+    }
+
+    if (rename(tmp_path.c_str(), entry_path.c_str()) != 0) {
+      mLog->warnStream() << "unable to move the cache entry of '" << path << "' to '" << entry_path << "'";
+      remove(tmp_path.c_str());
+      return false;
+    }
+
+    HAX_LOG_DEBUG(mLog) << "cached the bytecode of '" << path << "' in '" << entry_path << "'";
+    return true;
+  }
+
+} // namespace Hax
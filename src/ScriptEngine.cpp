@@ -23,40 +23,165 @@
 
 #include "Hax/ScriptEngine.hpp"
 #include "Hax/EventManager.hpp"
+#include "Hax/MetricsManager.hpp"
+#include "Hax/ScriptCache.hpp"
+#include "Hax/LuaAllocator.hpp"
+#include "Hax/LuaWatchdog.hpp"
+#include "Hax/LuaProfiler.hpp"
+#include "Hax/Tracer.hpp"
 #include "Hax/Utility.hpp"
 
-#include <stdarg.h>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
 #include <boost/bind.hpp>
 
 TOLUA_API int  tolua_Hax_open (lua_State* tolua_S);
 
 namespace Hax {
 
-	ScriptEngine::ScriptEngine()
+  /** what luaL_newstate() installs, for the states we create ourselves */
+  static int onPanic(lua_State* lua) {
+    std::cerr << "PANIC: unprotected error in call to Lua API (" << lua_tostring(lua, -1) << ")\n";
+    return 0;
+  }
+
+  /** the registry key of the engine running a state, for onHook() */
+  static char gEngineKey;
+
+	ScriptEngine::ScriptEngine(std::vector<string_t> contexts, bool attached)
   : Logger("Script Engine"),
-    Configurable({ "Script Engine" })
+    Configurable(contexts)
   {
     mLuaState = 0;
     fCorruptState = false;
+    fOwnsState = false;
+    fAttached = attached;
+    mScriptCache = 0;
+    mAllocator = 0;
+    mWatchdog = new LuaWatchdog();
+    mProfiler = new LuaProfiler();
+    fProfileRequested = false;
+    fRefused = false;
+    fAborted = false;
 		fSetup = false;
+    fFlatEvents = false;
+    mBatchSize = 0;
+    mBatchTable = LUA_NOREF;
+    mBatchTableSize = 0;
+    mEventFilter.set();
+
+    defineOption("Intercept Events", &mConfig.InterceptEvents).defaultsTo("true");
+    defineOption("Tick Script", &mConfig.TickScript).defaultsTo("true");
+    defineOption("Batch Events", &mConfig.BatchEvents).defaultsTo("false");
+    defineOption("FFI Events", &mConfig.FFIEvents).defaultsTo("false");
+    defineOption("Bytecode Cache", &mConfig.BytecodeCache).defaultsTo("");
+    defineOption("Pool Allocator", &mConfig.PoolAllocator).defaultsTo("true");
+    defineOption("GC Pause", &mConfig.GCPause).defaultsTo("200");
+    defineOption("GC Step Multiplier", &mConfig.GCStepMultiplier).defaultsTo("200");
+    defineOption("GC Idle Budget", &mConfig.GCIdleBudget).defaultsTo("1000");
+    defineOption("Call Budget", &mConfig.CallBudget).defaultsTo("0");
+    defineOption("Tick Budget", &mConfig.TickBudget).defaultsTo("0");
+    defineOption("Budget Interval", &mConfig.BudgetInterval).defaultsTo("1000");
+    defineOption("Profile", &mConfig.Profile).defaultsTo("false");
+    defineOption("Profile Duration", &mConfig.ProfileDuration).defaultsTo("30");
+    defineOption("Profile Interval", &mConfig.ProfileInterval).defaultsTo("10000");
+    defineOption("Profile Output", &mConfig.ProfileOutput).defaultsTo("hax-lua.folded");
+    defineEnumOption("Error Handling", &mConfig.ErrorHandling)
+      .value("Die", CATCH_AND_DIE)
+      .value("Exception", CATCH_AND_THROW)
+      .value("Notify", CATCH_AND_HOOK)
+      .defaultsTo("Die");
+
+    mLiveConfig.publish(mConfig);
+
+    MetricsManager& metrics = MetricsManager::getSingleton();
+    mCallTime = &metrics.histogram("hax_lua_call_seconds", "Time spent in Lua calls made by the ScriptEngine");
+    mCallErrors = &metrics.counter("hax_lua_call_errors_total", "Lua calls made by the ScriptEngine that raised an error");
+    mBatchSizes = &metrics.histogram("hax_lua_event_batch_size", "Events passed to Lua per batch", 1);
+    mGCTime = &metrics.histogram("hax_lua_gc_step_seconds", "Time spent collecting Lua garbage in idle frame time");
+    mGCCycles = &metrics.counter("hax_lua_gc_cycles_total", "Lua garbage collection cycles completed in idle frame time");
+    mBudgetErrors = &metrics.counter("hax_lua_budget_exceeded_total", "Lua calls aborted for running out of their instruction budget");
+    mRefusedCalls = &metrics.counter("hax_lua_calls_refused_total", "Lua calls refused for the tick having run out of its instruction budget");
+    mDroppedEvents = &metrics.counter("hax_lua_events_dropped_total", "Events whose Lua call ran out of its instruction budget");
+
+    std::ostringstream state;
+    state << "{state=\"" << getUID() << "\"}";
+    mMemory = &metrics.gauge("hax_lua_memory_bytes" + state.str(), "Memory in use by a Lua state");
+    mArena = &metrics.gauge("hax_lua_arena_bytes" + state.str(), "Memory held by the pool allocator of a Lua state");
+
+    mOnEvent = getCallback("Hax.onEvent");
+    mOnEvents = getCallback("Hax.onEvents");
+    mOnUpdate = getCallback("Hax.update");
 	}
 
 	ScriptEngine::~ScriptEngine() {
 		cleanup();
 
-    mLog->infoStream() << "shutting down.";
+    delete mWatchdog;
+    delete mProfiler;
+
+    HAX_LOG_INFO(mLog) << "shutting down.";
 	}
 
 	bool ScriptEngine::setup() {
 		if (fSetup)
 			return true;
 
-		mLog->infoStream() << "Setting up";
+		HAX_LOG_INFO(mLog) << "Setting up";
 
 		// mLuaState = mCEGUILua->getLuaState();
+    if (!mLuaState) {
+      if (mLiveConfig->PoolAllocator) {
+        mAllocator = new LuaAllocator();
+        mLuaState = lua_newstate(&LuaAllocator::allocate, mAllocator);
+
+        // 64-bit LuaJIT insists on its own allocator
+        if (!mLuaState) {
+          mLog->warnStream() << "this Lua doesn't take custom allocators, \"Pool Allocator\" is ignored";
+          delete mAllocator;
+          mAllocator = 0;
+        }
+        else
+          lua_atpanic(mLuaState, &onPanic);
+      }
+
+      if (!mLuaState)
+        mLuaState = luaL_newstate();
+
+      luaL_openlibs(mLuaState);
+      fOwnsState = true;
+    }
+
+    tuneGC();
+
+    lua_pushlightuserdata(mLuaState, &gEngineKey);
+    lua_pushlightuserdata(mLuaState, this);
+    lua_rawset(mLuaState, LUA_REGISTRYINDEX);
+
+    mWatchdog->setBudgets(std::max(mLiveConfig->CallBudget, 0), std::max(mLiveConfig->TickBudget, 0));
+    updateProfiler();
+    armHooks();
+
     tolua_Hax_open(mLuaState);
 
-    if (mConfig.InterceptEvents)
+    if (!mLiveConfig->BytecodeCache.empty())
+      mScriptCache = new ScriptCache(mLiveConfig->BytecodeCache);
+
+    if (mLiveConfig->FFIEvents) {
+      fFlatEvents = LuaFFI::open(mLuaState);
+      if (!fFlatEvents)
+        mLog->warnStream() << "\"FFI Events\" needs LuaJIT, passing events as usertypes instead";
+      mFlatEvents.resize(1);
+    }
+
+    lua_createtable(mLuaState, 64, 0);
+    mBatchTable = luaL_ref(mLuaState, LUA_REGISTRYINDEX);
+    mBatchTableSize = 0;
+
+    resolveCallbacks();
+
+    if (fAttached && mLiveConfig->InterceptEvents)
       bind(EventUID::Unassigned, boost::bind(&ScriptEngine::passToLua, this, _1));
 
 		fSetup = true;
@@ -73,8 +198,39 @@ namespace Hax {
     
     // unbindAll();
 
+    for (int& ref : mCallbackRefs) {
+      luaL_unref(mLuaState, LUA_REGISTRYINDEX, ref);
+      ref = LUA_NOREF;
+    }
+
+    luaL_unref(mLuaState, LUA_REGISTRYINDEX, mBatchTable);
+    mBatchTable = LUA_NOREF;
+    mBatch.clear();
+    mBatchSize = 0;
+    mFlatEvents.clear();
+    fFlatEvents = false;
+
+    delete mScriptCache;
+    mScriptCache = 0;
+
     // Destroy the lua state
+    if (fOwnsState)
+      lua_close(mLuaState);
+    else {
+      lua_sethook(mLuaState, 0, 0, 0);
+      lua_pushlightuserdata(mLuaState, &gEngineKey);
+      lua_pushnil(mLuaState);
+      lua_rawset(mLuaState, LUA_REGISTRYINDEX);
+    }
+
+    delete mAllocator;
+    mAllocator = 0;
+
+    mMemory->set(0);
+    mArena->set(0);
+
 		mLuaState = 0;
+    fOwnsState = false;
 
     fSetup = false;
 
@@ -82,27 +238,197 @@ namespace Hax {
 	}
 
 	void ScriptEngine::update( unsigned long lTimeElapsed ) {
+    HAX_TRACE_SCOPE("ScriptEngine::update");
+
 		processEvents();
 
-    if (mConfig.TickScript)
-		  passToLua("Hax.update", 1, "unsigned long", lTimeElapsed);
+    if (mBatchSize)
+      flushEvents();
+
+    if (mLiveConfig->TickScript) {
+      HAX_TRACE_SCOPE("ScriptEngine::tick");
+		  call<void>(mOnUpdate, lTimeElapsed);
+    }
+
+    updateMemoryMetrics();
+
+    // the GC settings, budgets, and profiler are only picked up between ticks
+    tuneGC();
+    mWatchdog->setBudgets(std::max(mLiveConfig->CallBudget, 0), std::max(mLiveConfig->TickBudget, 0));
+    mWatchdog->beginTick();
+    updateProfiler();
+    armHooks();
+
+    // the tick is over, none of the reads made during it is still in progress
+    mLiveConfig.quiesce();
 	}
 
+  void ScriptEngine::idle(uint64_t lBudgetNs) {
+    uint64_t budget = (uint64_t)std::max(mLiveConfig->GCIdleBudget, 0) * 1000;
+    collectGarbage(std::min(lBudgetNs, budget));
+  }
+
+  void ScriptEngine::collectGarbage(uint64_t lBudgetNs) {
+    if (!mLuaState || fCorruptState || !lBudgetNs)
+      return;
+
+    HAX_TRACE_SCOPE("ScriptEngine::collectGarbage");
+
+    uint64_t begin = Tracer::now();
+    uint64_t deadline = begin + lBudgetNs;
+
+    do {
+      if (lua_gc(mLuaState, LUA_GCSTEP, 0)) {
+        mGCCycles->inc();
+        break;
+      }
+    } while (Tracer::now() < deadline);
+
+    mGCTime->record(Tracer::now() - begin);
+    updateMemoryMetrics();
+  }
+
+  void ScriptEngine::onHook(lua_State* lua, lua_Debug* ar) {
+    lua_pushlightuserdata(lua, &gEngineKey);
+    lua_rawget(lua, LUA_REGISTRYINDEX);
+    ScriptEngine* engine = (ScriptEngine*)lua_touserdata(lua, -1);
+    lua_pop(lua, 1);
+
+    if (!engine || ar->event != LUA_HOOKCOUNT)
+      return;
+
+    if (engine->mProfiler->isRunning())
+      engine->mProfiler->onCount(lua, ar);
+
+    // raising an error is what aborts the call; it unwinds past this frame
+    switch (engine->mWatchdog->onCount(lua, ar, lua_gethookcount(lua))) {
+      case LuaWatchdog::CallBudget:
+        luaL_error(lua, "call instruction budget exceeded");
+        break;
+      case LuaWatchdog::TickBudget:
+        luaL_error(lua, "tick instruction budget exceeded");
+        break;
+      default:
+        break;
+    }
+  }
+
+  void ScriptEngine::armHooks() {
+    int interval = 0;
+
+    if (mLiveConfig->CallBudget > 0 || mLiveConfig->TickBudget > 0)
+      interval = std::max(mLiveConfig->BudgetInterval, 1);
+
+    // the watchdog and the profiler both take firings of any interval
+    if (mProfiler->isRunning()) {
+      int profile_interval = std::max(mLiveConfig->ProfileInterval, 1);
+      interval = interval ? std::min(interval, profile_interval) : profile_interval;
+    }
+
+    if (interval && lua_gethookcount(mLuaState) == interval)
+      return;
+
+    if (interval)
+      lua_sethook(mLuaState, &ScriptEngine::onHook, LUA_MASKCOUNT, interval);
+    else
+      lua_sethook(mLuaState, 0, 0, 0);
+  }
+
+  void ScriptEngine::updateProfiler() {
+    bool requested = mLiveConfig->Profile;
+
+    if (requested && !fProfileRequested) {
+      HAX_LOG_INFO(mLog) << "profiling Lua for " << mLiveConfig->ProfileDuration << "s";
+      mProfiler->start((uint64_t)std::max(mLiveConfig->ProfileDuration, 0) * 1000000000ULL);
+    }
+
+    fProfileRequested = requested;
+
+    if (!mProfiler->isRunning() || (requested && !mProfiler->isDue()))
+      return;
+
+    mProfiler->stop();
+
+    string_t path = mLiveConfig->ProfileOutput;
+    if (!fAttached) {
+      std::ostringstream uid;
+      uid << "." << getUID();
+      path += uid.str();
+    }
+
+    if (!mProfiler->write(path)) {
+      mLog->errorStream() << "could not write the Lua profile to '" << path << "'";
+      return;
+    }
+
+    std::ostringstream hottest;
+    std::vector<std::pair<string_t, uint64_t>> lines = mProfiler->getLines();
+    for (size_t i = 0; i < lines.size() && i < 3; ++i)
+      hottest << (i ? ", " : "; hottest lines: ") << lines[i].first << " (" << lines[i].second / 1000 << "us)";
+
+    HAX_LOG_INFO(mLog) << "wrote " << mProfiler->getSamples() << " Lua samples to '" << path << "'" << hottest.str();
+  }
+
+  void ScriptEngine::tuneGC() {
+    lua_gc(mLuaState, LUA_GCSETPAUSE, mLiveConfig->GCPause);
+    lua_gc(mLuaState, LUA_GCSETSTEPMUL, mLiveConfig->GCStepMultiplier);
+  }
+
+  void ScriptEngine::updateMemoryMetrics() {
+    mMemory->set(lua_gc(mLuaState, LUA_GCCOUNT, 0) * 1024 + lua_gc(mLuaState, LUA_GCCOUNTB, 0));
+
+    if (mAllocator)
+      mArena->set(mAllocator->getChunkBytes());
+  }
+
 	lua_State* ScriptEngine::getLuaState() {
 		return mLuaState;
 	}
 
+  LuaWatchdog const& ScriptEngine::getWatchdog() const {
+    return *mWatchdog;
+  }
+
+  LuaProfiler const& ScriptEngine::getProfiler() const {
+    return *mProfiler;
+  }
+
+  void ScriptEngine::configure() {
+    bool was_intercepting = mLiveConfig->InterceptEvents;
+
+    mLiveConfig.publish(mConfig);
+
+    if (!fSetup || !fAttached || was_intercepting == mConfig.InterceptEvents || fCorruptState)
+      return;
+
+    if (mConfig.InterceptEvents)
+      bind(EventUID::Unassigned, boost::bind(&ScriptEngine::passToLua, this, _1));
+    else if (isBound(EventUID::Unassigned))
+      unbind(EventUID::Unassigned);
+  }
+
 	void ScriptEngine::runScript(string_t const& inScript) {
-    mLog->infoStream() << "Running script '" << inScript << "'";
+    HAX_LOG_INFO(mLog) << "Running script '" << inScript << "'";
 
-    int lErrorCode = luaL_dofile(mLuaState, inScript.c_str());
-    if (lErrorCode == 1) {
+    int lErrorCode = mScriptCache
+      ? mScriptCache->load(mLuaState, inScript)
+      : luaL_loadfile(mLuaState, inScript.c_str());
+
+    mProfiler->resume();
+
+    if (lErrorCode == 0)
+      lErrorCode = lua_pcall(mLuaState, 0, LUA_MULTRET, 0);
+
+    if (lErrorCode != 0) {
       string_t lError = lua_tostring(mLuaState, -1);
       mLog->errorStream() << "Lua: " << lError;
       lua_pop(mLuaState, -1);
 
       throw ScriptError("Unable to load script '" + inScript + "'; cause: " + lError);
     }
+
+    // the script may have (re)defined any of our callbacks
+    resolveCallbacks();
 		try {
 
 		} catch (std::exception& e) {
@@ -112,63 +438,225 @@ namespace Hax {
 	}
 
 	bool ScriptEngine::passToLua(const Event& inEvt) {
-    return passToLua("Hax.onEvent", 1, "Hax::Event", &inEvt);
+    if (!mEventFilter.test(inEvt.UID))
+      return true;
+
+    if (!mLiveConfig->BatchEvents) {
+      bool handled = fFlatEvents
+        ? call<bool>(mOnEvent, (const void*)mFlatEvents[0].assign(inEvt))
+        : call<bool>(mOnEvent, inEvt);
+
+      return handled || isConsumed();
+    }
+
+    // the slots are reused, so are their property maps
+    if (mBatchSize == mBatch.size())
+      mBatch.push_back(inEvt);
+    else
+      mBatch[mBatchSize] = inEvt;
+
+    ++mBatchSize;
+    return true;
 	}
 
-  bool ScriptEngine::passToLua(const char* inFunc, int argc, ...) {
+  void ScriptEngine::flushEvents() {
+    HAX_TRACE_SCOPE("ScriptEngine::flushEvents");
+
+    size_t count = mBatchSize;
+    mBatchSize = 0;
+    mBatchSizes->record(count);
+
+    if (fFlatEvents && mFlatEvents.size() < count)
+      mFlatEvents.resize(count);
+
+    lua_rawgeti(mLuaState, LUA_REGISTRYINDEX, mBatchTable);
+    for (size_t i = 0; i < count; ++i) {
+      if (fFlatEvents)
+        LuaStack::push(mLuaState, (const void*)mFlatEvents[i].assign(mBatch[i]));
+      else
+        LuaStack::push(mLuaState, mBatch[i]);
+
+      lua_rawseti(mLuaState, -2, (int)i + 1);
+    }
+
+    // truncate whatever the last batch left past this one's end
+    for (size_t i = count; i < mBatchTableSize; ++i) {
+      lua_pushnil(mLuaState);
+      lua_rawseti(mLuaState, -2, (int)i + 1);
+    }
+
+    lua_pop(mLuaState, 1);
+    mBatchTableSize = count;
+
+    call<bool>(mOnEvents, LuaStack::Ref(mBatchTable));
+
+    // a refused batch is handed over again on the next tick
+    if (fRefused)
+      mBatchSize = count;
+    else if (fAborted)
+      mDroppedEvents->inc(count);
+  }
+
+  bool ScriptEngine::isConsumed() {
+    // retrying a call that blew its budget would only blow it again, and
+    // hold back every event queued behind this one
+    if (fAborted)
+      mDroppedEvents->inc();
+
+    return fAborted;
+  }
+
+  void ScriptEngine::filterEvent(EventUID_T evt, bool wanted) {
+    mEventFilter.set(evt, wanted);
+  }
+
+  void ScriptEngine::resolveCallbacks() {
+    for (callback_t callback = 0; callback < (callback_t)mCallbackRefs.size(); ++callback)
+      resolveCallback(callback);
+
+    // Hax.EventFilter, if defined, lists the only UIDs the scripts handle
+    lua_getfield(mLuaState, LUA_GLOBALSINDEX, "Hax");
+    if (lua_istable(mLuaState, -1)) {
+      lua_getfield(mLuaState, -1, "EventFilter");
+      if (lua_istable(mLuaState, -1)) {
+        mEventFilter.reset();
+
+        size_t count = lua_objlen(mLuaState, -1);
+        for (size_t i = 1; i <= count; ++i) {
+          lua_rawgeti(mLuaState, -1, (int)i);
+          if (lua_isnumber(mLuaState, -1))
+            mEventFilter.set((unsigned char)lua_tointeger(mLuaState, -1));
+          lua_pop(mLuaState, 1);
+        }
+
+        HAX_LOG_DEBUG(mLog) << "passing " << mEventFilter.count() << " event types to Lua";
+      }
+      lua_pop(mLuaState, 1);
+    }
+    lua_pop(mLuaState, 1);
+  }
+
+  ScriptEngine::callback_t ScriptEngine::getCallback(string_t const& path) {
+    std::map<string_t, callback_t>::const_iterator known = mCallbacks.find(path);
+    if (known != mCallbacks.end())
+      return known->second;
+
+    callback_t callback = (callback_t)mCallbackRefs.size();
+    mCallbackPaths.push_back(path);
+    mCallbackRefs.push_back(LUA_NOREF);
+    mCallbacks.insert(std::make_pair(path, callback));
+
+    if (mLuaState)
+      resolveCallback(callback);
+
+    return callback;
+  }
+
+  void ScriptEngine::resolveCallback(callback_t callback) {
+    int& ref = mCallbackRefs[callback];
+    luaL_unref(mLuaState, LUA_REGISTRYINDEX, ref);
+    ref = LUA_NOREF;
+
+    // walk the dotted path down from the globals table
+    string_t const& path = mCallbackPaths[callback];
+    lua_pushvalue(mLuaState, LUA_GLOBALSINDEX);
+
+    size_t begin = 0;
+    for (;;) {
+      size_t end = path.find('.', begin);
+
+      if (!lua_istable(mLuaState, -1)) {
+        lua_pop(mLuaState, 1);
+        return;
+      }
+
+      lua_getfield(mLuaState, -1, path.substr(begin, end - begin).c_str());
+      lua_remove(mLuaState, -2);
+
+      if (end == string_t::npos)
+        break;
+
+      begin = end + 1;
+    }
+
+    if (!lua_isfunction(mLuaState, -1)) {
+      lua_pop(mLuaState, 1);
+      return;
+    }
+
+    ref = luaL_ref(mLuaState, LUA_REGISTRYINDEX);
+  }
+
+  bool ScriptEngine::pushCallback(callback_t callback) {
+    fRefused = false;
+    fAborted = false;
+
     if (fCorruptState)
     {
-      mLog->warnStream() << "Lua state is corrupt, bailing out on method call " << inFunc;
+      mLog->warnStream() << "Lua state is corrupt, bailing out on method call " << mCallbackPaths[callback];
+      return false;
+    }
+
+    if (mCallbackRefs[callback] == LUA_NOREF)
+    {
+      mLog->errorStream() << "could not find Lua function " << mCallbackPaths[callback] << "!";
       return false;
     }
 
-    va_list argp;
-    va_start(argp, argc);
+    lua_rawgeti(mLuaState, LUA_REGISTRYINDEX, mCallbackRefs[callback]);
+    return true;
+  }
 
-		lua_getfield(mLuaState, LUA_GLOBALSINDEX, "Hax.arbitrary");
-		if(!lua_isfunction(mLuaState, 1))
-		{
-			mLog->errorStream() << "could not find Lua arbitrary functor " << inFunc << "!";
-      onError();
+  bool ScriptEngine::callLua(int argc) {
+    if (mWatchdog->isTickSpent()) {
+      fRefused = true;
+      lua_pop(mLuaState, argc + 1);
+      mRefusedCalls->inc();
       return false;
-		}
+    }
 
-    lua_pushfstring(mLuaState, inFunc);
-    for (int i=0; i < argc; ++i) {
-      const char* argtype = (const char*)va_arg(argp, const char*);
-      void* argv = (void*)va_arg(argp, void*);
-      tolua_pushusertype(mLuaState,argv,argtype);
+    int ec;
+    {
+      ScopedTimer timer(*mCallTime);
+      mWatchdog->beginCall();
+      mProfiler->resume();
+      ec = lua_pcall(mLuaState, argc, 1, 0);
+      mWatchdog->endCall();
     }
 
-    int ec = lua_pcall(mLuaState, argc+1, 1, 0);
     if (ec != 0)
     {
+      mCallErrors->inc();
       // there was a lua error, dump the state and shut down the instance
       onError();
       return false;
     }
 
-		bool result = lua_toboolean(mLuaState, lua_gettop(mLuaState));
-		lua_remove(mLuaState, lua_gettop(mLuaState));
-
-    va_end(argp);
-    return result;
+    return true;
   }
 
   void ScriptEngine::onError()
   {
     // pop the error msg from the stack
     string_t lError = lua_tostring(mLuaState, lua_gettop(mLuaState));
+    lua_pop(mLuaState, 1);
+
+    if (mWatchdog->getExceeded() != LuaWatchdog::NoBudget) {
+      fAborted = true;
+      onBudgetExceeded(lError);
+      return;
+    }
 
     fCorruptState = true;
 
     // unbind any lua callers
-    unbind(EventUID::Unassigned);
+    if (isBound(EventUID::Unassigned))
+      unbind(EventUID::Unassigned);
 
     mLog->errorStream() << "Lua Error: " << lError;
 
     // DEBUG: just die
-    switch (mConfig.ErrorHandling) {
+    switch (mLiveConfig->ErrorHandling) {
       case CATCH_AND_DIE:
         assert(false);
         break;
@@ -187,32 +675,36 @@ namespace Hax {
     return;
   }
 
-  void ScriptEngine::setDefaults() {
-    mConfig.TickScript = true;
-    mConfig.InterceptEvents = true;
-    mConfig.ErrorHandling = CATCH_AND_DIE;
-  }
+  void ScriptEngine::onBudgetExceeded(string_t const& lError)
+  {
+    string_t lBudget = mWatchdog->getExceeded() == LuaWatchdog::CallBudget ? "Call" : "Tick";
 
-  void ScriptEngine::setOption(string_t const& k, string_t const& v) {
-    if (k == "Intercept Events") {
-      mConfig.InterceptEvents = Utility::boolify(v);
-    }
-    else if (k == "Error Handling") {
-      if (v == "Exception")
-        mConfig.ErrorHandling = CATCH_AND_THROW;
-      else if (v == "Notify")
-        mConfig.ErrorHandling = CATCH_AND_HOOK;
-      else if (v == "Die")
-        mConfig.ErrorHandling = CATCH_AND_DIE;
-      else {
-        mLog->noticeStream() << "Invalid 'Error Handling' setting '" << v << "', defaulting to 'Die'";
-      }
-    }
-    else if (k == "Tick Script") {
-      mConfig.TickScript = Utility::boolify(v);
-    }
-    else {
-      mLog->noticeStream() << "Unknown Script Engine setting '" << k << "', ignoring.";
+    mBudgetErrors->inc();
+
+    // the state is fine, a script just took too long; it stays bound
+    std::ostringstream lBusiest;
+    std::vector<LuaWatchdog::function_t> lFunctions = mWatchdog->getFunctions();
+    for (size_t i = 0; i < lFunctions.size() && i < 3; ++i)
+      lBusiest << (i ? ", " : "; busiest functions: ") << lFunctions[i].name
+        << " (" << lFunctions[i].nanoseconds / 1000 << "us)";
+
+    mLog->errorStream() << "Lua script ran out of its " << lBudget << " Budget: " << lError << lBusiest.str();
+
+    switch (mLiveConfig->ErrorHandling) {
+      case CATCH_AND_DIE:
+        assert(false);
+        break;
+      case CATCH_AND_THROW:
+        throw ScriptBudgetError("A Lua call ran out of its " + lBudget + " Budget: " + lError);
+        break;
+      case CATCH_AND_HOOK:
+        {
+          Event lEvt(EventUID::LuaError);
+          lEvt.setProperty("Error", lError);
+          lEvt.setProperty("Budget", lBudget);
+          EventManager::getSingleton().hook(lEvt);
+        }
+        break;
     }
   }
 
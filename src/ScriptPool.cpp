@@ -0,0 +1,265 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/ScriptPool.hpp"
+#include "Hax/ScriptEngine.hpp"
+#include "Hax/WorkerPool.hpp"
+#include "Hax/Tracer.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <boost/bind.hpp>
+
+namespace Hax {
+
+  /** a detached ScriptEngine with an inbox of routed events */
+  class ScriptPool::Shard : public ScriptEngine {
+  public:
+    Shard()
+    : ScriptEngine(std::vector<string_t>(), false)
+    {
+    }
+
+    virtual ~Shard()
+    {
+    }
+
+    /**
+     * Hands the inbox over in order; the first event Lua isn't done with
+     * stays, along with the ones behind it, for the next tick.
+     */
+    void run(unsigned long lTimeElapsed)
+    {
+      std::vector<Event>::iterator pending = mInbox.begin();
+
+      try {
+        while (pending != mInbox.end() && passToLua(*pending))
+          ++pending;
+      } catch (...) {
+        mInbox.erase(mInbox.begin(), pending);
+        throw;
+      }
+
+      mInbox.erase(mInbox.begin(), pending);
+      update(lTimeElapsed);
+    }
+
+    std::vector<Event> mInbox;
+  };
+
+  ScriptPool::ScriptPool()
+  : Logger("Script Pool"),
+    Configurable({ "Script Pool" }),
+    mWorkers(0),
+    mInFlight(0)
+  {
+    defineOption("States", &mConfig.States, { "states" }).defaultsTo("4");
+    defineOption("Workers", &mConfig.Workers, { "workers" }).defaultsTo("0");
+    defineOption("Route By", &mConfig.RouteBy, { "route by" }).defaultsTo("Entity");
+
+    fSetup = false;
+  }
+
+  ScriptPool::~ScriptPool()
+  {
+    cleanup();
+  }
+
+  void ScriptPool::setOption(string_t const& key, string_t const& value)
+  {
+    bool known = false;
+    for (std::pair<string_t, string_t>& option : mEngineOptions)
+      if (option.first == key) {
+        option.second = value;
+        known = true;
+      }
+
+    if (!known)
+      mEngineOptions.push_back(std::make_pair(key, value));
+
+    for (Shard* shard : mShards)
+      shard->applyOption(key, ConfigValue(value));
+  }
+
+  void ScriptPool::configure()
+  {
+    for (Shard* shard : mShards)
+      shard->configure();
+  }
+
+  bool ScriptPool::setup()
+  {
+    if (fSetup)
+      return true;
+
+    size_t states = (size_t)std::max(mConfig.States, 1);
+    size_t workers = mConfig.Workers > 0 ? (size_t)mConfig.Workers : states;
+
+    for (size_t i = 0; i < states; ++i) {
+      Shard* shard = new Shard();
+
+      for (std::pair<string_t, string_t> const& option : mEngineOptions)
+        shard->applyOption(option.first, ConfigValue(option.second));
+      shard->configure();
+
+      if (!shard->setup()) {
+        mLog->errorStream() << "could not set up Lua state #" << i;
+        delete shard;
+        cleanup();
+        return false;
+      }
+
+      mShards.push_back(shard);
+    }
+
+    mWorkers = new WorkerPool(workers);
+
+    bind(EventUID::Unassigned, boost::bind(&ScriptPool::route, this, _1));
+
+    HAX_LOG_INFO(mLog) << "running " << states << " Lua states on " << workers
+      << " workers, routed by '" << mConfig.RouteBy << "'";
+
+    fSetup = true;
+    return true;
+  }
+
+  bool ScriptPool::cleanup()
+  {
+    if (isBound(EventUID::Unassigned))
+      unbind(EventUID::Unassigned);
+
+    delete mWorkers;
+    mWorkers = 0;
+
+    for (Shard* shard : mShards)
+      delete shard;
+
+    mShards.clear();
+
+    fSetup = false;
+    return true;
+  }
+
+  void ScriptPool::idle(uint64_t lBudgetNs)
+  {
+    if (mShards.empty())
+      return;
+
+    for (Shard* shard : mShards)
+      shard->idle(lBudgetNs / mShards.size());
+  }
+
+  void ScriptPool::runScript(string_t const& inScriptPath)
+  {
+    for (Shard* shard : mShards)
+      shard->runScript(inScriptPath);
+  }
+
+  void ScriptPool::pin(string_t const& key, size_t state)
+  {
+    mPins[key] = state;
+  }
+
+  size_t ScriptPool::getState(string_t const& key) const
+  {
+    std::map<string_t, size_t>::const_iterator pinned = mPins.find(key);
+    if (pinned != mPins.end() && pinned->second < mShards.size())
+      return pinned->second;
+
+    return mShards.empty() ? 0 : std::hash<string_t>()(key) % mShards.size();
+  }
+
+  size_t ScriptPool::size() const
+  {
+    return mShards.size();
+  }
+
+  ScriptEngine& ScriptPool::getEngine(size_t state)
+  {
+    return *mShards.at(state);
+  }
+
+  bool ScriptPool::route(const Event& evt)
+  {
+    if (evt.hasProperty(mConfig.RouteBy)) {
+      mShards[getState(evt.getProperty(mConfig.RouteBy))]->mInbox.push_back(evt);
+      return true;
+    }
+
+    for (Shard* shard : mShards)
+      shard->mInbox.push_back(evt);
+
+    return true;
+  }
+
+  void ScriptPool::update(unsigned long lTimeElapsed)
+  {
+    HAX_TRACE_SCOPE("ScriptPool::update");
+
+    processEvents();
+
+    mInFlight = mShards.size();
+    for (Shard* shard : mShards)
+      mWorkers->submit(boost::bind(&ScriptPool::run, this, shard, lTimeElapsed));
+
+    {
+      boost::mutex::scoped_lock lock(mInFlightMutex);
+      while (mInFlight) {
+        lock.unlock();
+        bool helped = mWorkers->help();
+        lock.lock();
+
+        if (!helped && mInFlight)
+          mShardsDone.wait(lock);
+      }
+    }
+
+    if (mError) {
+      std::exception_ptr error = mError;
+      mError = std::exception_ptr();
+      std::rethrow_exception(error);
+    }
+  }
+
+  void ScriptPool::run(Shard* shard, unsigned long lTimeElapsed)
+  {
+    std::exception_ptr error;
+
+    try {
+      shard->run(lTimeElapsed);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mInFlightMutex);
+      if (error && !mError)
+        mError = error;
+
+      --mInFlight;
+    }
+
+    mShardsDone.notify_all();
+  }
+
+} // namespace Hax
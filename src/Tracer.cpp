@@ -0,0 +1,320 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/Tracer.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <cstdio>
+#include <signal.h>
+#include <unistd.h>
+
+namespace Hax {
+
+  namespace {
+
+    /** a slot guarded by a sequence number, see record() and dump() */
+    struct span_t {
+      std::atomic<uint64_t>     seq;
+      std::atomic<const char*>  name;
+      std::atomic<uint64_t>     begin;
+      std::atomic<uint64_t>     end;
+    };
+
+    /**
+     * The spans of one thread; only the owning thread writes. Rings are never
+     * freed, a thread that exits hands its ring over to the next new thread.
+     */
+    struct ring_t {
+      span_t                    *spans;
+      uint64_t                  mask;
+      std::atomic<uint64_t>     head;
+      /* the first index that belongs to the current owner */
+      std::atomic<uint64_t>     first;
+      std::atomic<int>          tid;
+      std::atomic<const char*>  thread_name;
+      std::atomic<bool>         in_use;
+      ring_t                    *next;
+    };
+
+    const uint64_t NoSpan = ~(uint64_t)0;
+
+    std::atomic<ring_t*>  gRings(0);
+    std::atomic<int>      gNextTid(1);
+    std::atomic<int>      gRingSize(16384);
+    std::atomic<bool>     gDumpRequested(false);
+
+    struct thread_ring_t {
+      ring_t *ring;
+
+      thread_ring_t() {
+        for (ring = gRings.load(); ring; ring = ring->next) {
+          bool free = false;
+          if (ring->in_use.compare_exchange_strong(free, true))
+            break;
+        }
+
+        if (!ring) {
+          uint64_t size = 2;
+          while (size < (uint64_t)gRingSize.load())
+            size <<= 1;
+
+          ring = new ring_t();
+          ring->spans = new span_t[size];
+          ring->mask = size - 1;
+          ring->head.store(0);
+          for (uint64_t i = 0; i < size; ++i)
+            ring->spans[i].seq.store(NoSpan, std::memory_order_relaxed);
+          ring->in_use.store(true);
+
+          ring->next = gRings.load();
+          while (!gRings.compare_exchange_weak(ring->next, ring))
+            ;
+        }
+
+        ring->first.store(ring->head.load());
+        ring->thread_name.store(0);
+        ring->tid.store(gNextTid.fetch_add(1));
+      }
+
+      ~thread_ring_t() {
+        ring->in_use.store(false);
+      }
+    };
+
+    thread_local thread_ring_t tRing;
+
+    void onDumpSignal(int) {
+      gDumpRequested.store(true);
+    }
+
+    struct trace_span_t {
+      const char  *name;
+      uint64_t    begin;
+      uint64_t    end;
+    };
+
+    void write_json_string(std::ostream& out, const char* str) {
+      out << '"';
+      for (; *str; ++str) {
+        if (*str == '"' || *str == '\\')
+          out << '\\';
+        if ((unsigned char)*str >= 0x20)
+          out << *str;
+      }
+      out << '"';
+    }
+  }
+
+  Tracer* Tracer::__instance = 0;
+  std::atomic<bool> Tracer::gEnabled(false);
+  const std::chrono::steady_clock::time_point Tracer::gEpoch = std::chrono::steady_clock::now();
+
+  Tracer::Tracer()
+  : Logger("Tracer"),
+    Configurable({ "Tracer" }),
+    mWatcher(0)
+  {
+    defineOption("Enabled", &mConfig.Enabled, { "enabled" }).defaultsTo("false");
+    defineDurationOption("Window", &mConfig.Window, { "window" }).defaultsTo("10s");
+    defineOption("Ring Size", &mConfig.RingSize, { "ring size" }).defaultsTo("16384");
+    defineOption("Dump Directory", &mConfig.DumpDirectory, { "dump directory" }).defaultsTo(".");
+    defineOption("Dump On Signal", &mConfig.DumpOnSignal, { "dump on signal" }).defaultsTo("true");
+  }
+
+  Tracer::~Tracer()
+  {
+    shutdown();
+  }
+
+  Tracer& Tracer::getSingleton() {
+    if (!__instance)
+      __instance = new Tracer();
+
+    return *__instance;
+  }
+
+  void Tracer::setEnabled(bool flag) {
+    gEnabled.store(flag);
+  }
+
+  void Tracer::setThreadName(const char* name) {
+    tRing.ring->thread_name.store(name, std::memory_order_relaxed);
+  }
+
+  const char* Tracer::intern(string_t const& name) {
+    // never freed, the rings may point into it until the process exits
+    static boost::mutex* mutex = new boost::mutex();
+    static std::set<string_t>* names = new std::set<string_t>();
+
+    boost::mutex::scoped_lock lock(*mutex);
+    return names->insert(name).first->c_str();
+  }
+
+  void Tracer::record(const char* name, uint64_t begin, uint64_t end) {
+    ring_t* ring = tRing.ring;
+    uint64_t index = ring->head.load(std::memory_order_relaxed);
+    span_t& span = ring->spans[index & ring->mask];
+
+    span.seq.store(NoSpan, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    span.name.store(name, std::memory_order_relaxed);
+    span.begin.store(begin, std::memory_order_relaxed);
+    span.end.store(end, std::memory_order_relaxed);
+
+    span.seq.store(index, std::memory_order_release);
+    ring->head.store(index + 1, std::memory_order_release);
+  }
+
+  void Tracer::dump(std::ostream& out, uint64_t window_seconds) {
+    const uint64_t now = Tracer::now();
+    const uint64_t cutoff =
+      (window_seconds && now > window_seconds * 1000000000ULL)
+      ? now - window_seconds * 1000000000ULL
+      : 0;
+
+    const int pid = (int)getpid();
+    bool first_event = true;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    std::vector<trace_span_t> spans;
+    for (ring_t* ring = gRings.load(); ring; ring = ring->next) {
+      const uint64_t head = ring->head.load(std::memory_order_acquire);
+      const uint64_t capacity = ring->mask + 1;
+      uint64_t index = ring->first.load();
+      if (head > capacity && head - capacity > index)
+        index = head - capacity;
+
+      spans.clear();
+      for (; index < head; ++index) {
+        span_t& span = ring->spans[index & ring->mask];
+
+        // a slot that's being (or has been) overwritten is skipped
+        if (span.seq.load(std::memory_order_acquire) != index)
+          continue;
+
+        trace_span_t copy;
+        copy.name = span.name.load(std::memory_order_relaxed);
+        copy.begin = span.begin.load(std::memory_order_relaxed);
+        copy.end = span.end.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (span.seq.load(std::memory_order_relaxed) != index)
+          continue;
+
+        if (copy.end >= cutoff)
+          spans.push_back(copy);
+      }
+
+      if (spans.empty())
+        continue;
+
+      const int tid = ring->tid.load();
+      const char* thread_name = ring->thread_name.load();
+      if (thread_name) {
+        out << (first_event ? "" : ",")
+            << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << tid
+            << ",\"args\":{\"name\":";
+        write_json_string(out, thread_name);
+        out << "}}";
+        first_event = false;
+      }
+
+      char timing[64];
+      for (trace_span_t const& span : spans) {
+        out << (first_event ? "" : ",") << "{\"ph\":\"X\",\"cat\":\"hax\",\"name\":";
+        write_json_string(out, span.name);
+
+        // chrome wants microseconds
+        snprintf(timing, sizeof(timing), ",\"ts\":%.3f,\"dur\":%.3f",
+          span.begin / 1000.0, (span.end - span.begin) / 1000.0);
+        out << timing << ",\"pid\":" << pid << ",\"tid\":" << tid << "}";
+        first_event = false;
+      }
+    }
+
+    out << "]}\n";
+  }
+
+  bool Tracer::dump(string_t const& path) {
+    std::ofstream fh(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!fh.is_open()) {
+      mLog->errorStream() << "unable to write trace to '" << path << "'";
+      return false;
+    }
+
+    dump(fh, mConfig.Window);
+
+    HAX_LOG_NOTICE(mLog) << "wrote the last " << mConfig.Window << " seconds of traces to '" << path << "'";
+    return true;
+  }
+
+  void Tracer::configure() {
+    shutdown();
+
+    gRingSize.store(mConfig.RingSize > 0 ? mConfig.RingSize : 2);
+    setEnabled(mConfig.Enabled);
+
+    if (!mConfig.Enabled || !mConfig.DumpOnSignal)
+      return;
+
+    signal(SIGUSR2, &onDumpSignal);
+    mWatcher = new boost::thread(boost::bind(&Tracer::watch, this));
+
+    HAX_LOG_INFO(mLog) << "tracing, send SIGUSR2 to dump the last "
+      << mConfig.Window << " seconds into '" << mConfig.DumpDirectory << "'";
+  }
+
+  void Tracer::shutdown() {
+    if (!mWatcher)
+      return;
+
+    mWatcher->interrupt();
+    mWatcher->join();
+    delete mWatcher;
+    mWatcher = 0;
+
+    signal(SIGUSR2, SIG_DFL);
+  }
+
+  void Tracer::watch() {
+    try {
+      for (;;) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+
+        if (!gDumpRequested.exchange(false))
+          continue;
+
+        std::ostringstream path;
+        path << mConfig.DumpDirectory << "/hax-trace-" << time(0) << ".json";
+        dump(path.str());
+      }
+    } catch (boost::thread_interrupted&) {
+    }
+  }
+
+} // namespace Hax
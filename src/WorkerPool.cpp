@@ -0,0 +1,165 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/WorkerPool.hpp"
+#include "Hax/Tracer.hpp"
+
+#include <algorithm>
+
+namespace Hax {
+
+  namespace {
+    /** the pool the calling thread works for, and its queue in there */
+    thread_local WorkerPool* tPool = 0;
+    thread_local size_t tQueue = 0;
+  }
+
+  WorkerPool::WorkerPool(size_t workers)
+  : mNext(0),
+    mPending(0),
+    fRunning(true)
+  {
+    for (size_t i = 0; i < workers; ++i)
+      mQueues.push_back(new queue_t());
+
+    for (size_t i = 0; i < workers; ++i)
+      mWorkers.push_back(new boost::thread(boost::bind(&WorkerPool::run, this, i)));
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+      fRunning = false;
+    }
+
+    mWakeup.notify_all();
+
+    for (boost::thread* worker : mWorkers) {
+      worker->join();
+      delete worker;
+    }
+
+    for (queue_t* queue : mQueues)
+      delete queue;
+  }
+
+  void WorkerPool::submit(job_t const& job)
+  {
+    if (mQueues.empty()) {
+      job();
+      return;
+    }
+
+    size_t index = (tPool == this) ? tQueue : mNext.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+
+    // counted before it's visible to take(), which uncounts it
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+      ++mPending;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mQueues[index]->mutex);
+      mQueues[index]->jobs.push_back(job);
+    }
+
+    mWakeup.notify_one();
+  }
+
+  bool WorkerPool::help()
+  {
+    job_t job;
+    if (!take(tPool == this ? tQueue : mNext.load(std::memory_order_relaxed) % std::max<size_t>(mQueues.size(), 1), job))
+      return false;
+
+    job();
+    return true;
+  }
+
+  size_t WorkerPool::size() const
+  {
+    return mWorkers.size();
+  }
+
+  bool WorkerPool::take(size_t home, job_t& job)
+  {
+    const size_t count = mQueues.size();
+    if (!count)
+      return false;
+
+    bool found = false;
+
+    {
+      queue_t* queue = mQueues[home];
+      boost::mutex::scoped_lock lock(queue->mutex);
+      if (!queue->jobs.empty()) {
+        job = queue->jobs.back();
+        queue->jobs.pop_back();
+        found = true;
+      }
+    }
+
+    for (size_t i = 1; i < count && !found; ++i) {
+      queue_t* victim = mQueues[(home + i) % count];
+      boost::mutex::scoped_lock lock(victim->mutex);
+      if (!victim->jobs.empty()) {
+        job = victim->jobs.front();
+        victim->jobs.pop_front();
+        found = true;
+      }
+    }
+
+    if (found) {
+      boost::mutex::scoped_lock lock(mMutex);
+      --mPending;
+    }
+
+    return found;
+  }
+
+  void WorkerPool::run(size_t index)
+  {
+    Tracer::setThreadName("worker");
+
+    tPool = this;
+    tQueue = index;
+
+    for (;;) {
+      job_t job;
+
+      if (take(index, job)) {
+        job();
+        continue;
+      }
+
+      boost::mutex::scoped_lock lock(mMutex);
+      while (fRunning && !mPending)
+        mWakeup.wait(lock);
+
+      if (!fRunning && !mPending)
+        return;
+    }
+  }
+
+} // namespace Hax
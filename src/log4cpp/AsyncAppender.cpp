@@ -0,0 +1,431 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/log4cpp/AsyncAppender.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace Hax {
+
+  std::atomic<AsyncAppender*> AsyncAppender::gInstances[AsyncAppender::MaxInstances];
+
+  namespace {
+
+    const int gFatalSignals[] = {
+      SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#ifdef SIGBUS
+      SIGBUS,
+#endif
+    };
+
+    const int gNrFatalSignals = sizeof(gFatalSignals) / sizeof(gFatalSignals[0]);
+
+    /** the actions our crash handler replaced, by their index in gFatalSignals */
+    struct sigaction gPreviousActions[gNrFatalSignals];
+    std::atomic<bool> gCrashHandlerInstalled(false);
+  }
+
+  static void onFatalSignal(int sig)
+  {
+    AsyncAppender::dumpAll(STDERR_FILENO);
+
+    // put back whoever handled the signal before us, the application's crash
+    // reporter or the default action, and let it have the signal once we
+    // return: it stays blocked until then
+    for (int i = 0; i < gNrFatalSignals; ++i) {
+      if (gFatalSignals[i] != sig)
+        continue;
+
+      sigaction(sig, &gPreviousActions[i], 0);
+      raise(sig);
+      return;
+    }
+
+    signal(sig, SIG_DFL);
+    raise(sig);
+  }
+
+  /** write(2) all of it, or as much as the fd takes; async-signal-safe */
+  static void writeAll(int fd, const char* data, size_t len)
+  {
+    while (len) {
+      ssize_t written = write(fd, data, len);
+      if (written <= 0)
+        return;
+
+      data += written;
+      len -= (size_t)written;
+    }
+  }
+
+  AsyncAppender::AsyncAppender(
+    const std::string& name,
+    Appender* device,
+    size_t capacity,
+    OverflowPolicy policy)
+  : AppenderSkeleton(name),
+    mDevice(device),
+    mPolicy(policy),
+    mFileDevice(dynamic_cast<LineFileAppender*>(device)),
+    mSlots(0),
+    mMask(0),
+    mEnqueuePos(0),
+    mDequeuePos(0),
+    mDropped(0),
+    mReportedDropped(0),
+    mWriter(0),
+    fRunning(true),
+    fIdle(false),
+    fPauseRequested(false),
+    fPaused(false),
+    fWriting(false),
+    fCrashed(false)
+  {
+    capacity = std::min(capacity, (size_t)MaxCapacity);
+
+    size_t size = 2;
+    while (size < capacity)
+      size <<= 1;
+
+    mSlots = new slot_t[size];
+    mMask = size - 1;
+
+    for (size_t i = 0; i < size; ++i)
+      mSlots[i].seq.store(i, std::memory_order_relaxed);
+
+    for (int i = 0; i < MaxInstances; ++i) {
+      AsyncAppender* empty = 0;
+      if (gInstances[i].compare_exchange_strong(empty, this))
+        break;
+    }
+
+    mWriter = new boost::thread(boost::bind(&AsyncAppender::run, this));
+  }
+
+  AsyncAppender::~AsyncAppender()
+  {
+    for (int i = 0; i < MaxInstances; ++i) {
+      AsyncAppender* self = this;
+      if (gInstances[i].compare_exchange_strong(self, 0))
+        break;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+      fRunning = false;
+    }
+    mWakeup.notify_one();
+    mWriter->join();
+    delete mWriter;
+
+    // the writer is gone, this thread is the only consumer left; write
+    // anything that was pushed after it went down
+    drain();
+    reportDropped();
+
+    delete mDevice;
+    delete [] mSlots;
+  }
+
+  bool AsyncAppender::reopen()
+  {
+    flush();
+    pause();
+    bool reopened = mDevice->reopen();
+    resume();
+
+    return reopened;
+  }
+
+  void AsyncAppender::close()
+  {
+    flush();
+    pause();
+    mDevice->close();
+    resume();
+  }
+
+  bool AsyncAppender::requiresLayout() const
+  {
+    return mDevice->requiresLayout();
+  }
+
+  void AsyncAppender::setLayout(Layout* layout)
+  {
+    // the device frees its current layout, which the writer mustn't be using
+    flush();
+    pause();
+    mDevice->setLayout(layout);
+    resume();
+  }
+
+  uint64_t AsyncAppender::getDropped() const
+  {
+    return mDropped.load(std::memory_order_relaxed);
+  }
+
+  void AsyncAppender::_append(const LoggingEvent& event)
+  {
+    if (push(event)) {
+      if (fIdle.load(std::memory_order_relaxed))
+        mWakeup.notify_one();
+
+      return;
+    }
+
+    if (mPolicy != Block) {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    mWakeup.notify_one();
+    while (!push(event))
+      boost::this_thread::yield();
+  }
+
+  bool AsyncAppender::push(const LoggingEvent& event)
+  {
+    slot_t* slot;
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+    for (;;) {
+      slot = &mSlots[pos & mMask];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+      if (dif == 0) {
+        if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (dif < 0)
+        return false; // full
+      else
+        pos = mEnqueuePos.load(std::memory_order_relaxed);
+    }
+
+    // assigning into the slot's strings reuses their capacity
+    slot->record.category.assign(event.categoryName);
+    slot->record.message.assign(event.message);
+    slot->record.ndc.assign(event.ndc);
+    slot->record.priority = event.priority;
+    slot->record.timestamp = event.timeStamp;
+
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool AsyncAppender::pop()
+  {
+    // there's a single consumer, the head can't move under our feet
+    size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    slot_t* slot = &mSlots[pos & mMask];
+
+    if (slot->seq.load(std::memory_order_acquire) != pos + 1)
+      return false; // empty, or the producer isn't done with it yet
+
+    LoggingEvent event(
+      slot->record.category,
+      slot->record.message,
+      slot->record.ndc,
+      slot->record.priority);
+    event.timeStamp = slot->record.timestamp;
+
+    fWriting = true;
+    mDevice->doAppend(event);
+    fWriting = false;
+
+    mDequeuePos.store(pos + 1, std::memory_order_release);
+    slot->seq.store(pos + mMask + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool AsyncAppender::drain()
+  {
+    bool drained_any = false;
+    while (!fCrashed && pop())
+      drained_any = true;
+
+    return drained_any;
+  }
+
+  void AsyncAppender::flush()
+  {
+    // the records reserved so far; some may still be being filled in
+    size_t target = mEnqueuePos.load(std::memory_order_acquire);
+
+    boost::mutex::scoped_lock lock(mMutex);
+    while (fRunning && !fCrashed && mDequeuePos.load(std::memory_order_acquire) < target) {
+      mWakeup.notify_one();
+      mDone.timed_wait(lock, boost::posix_time::milliseconds((long)IdleWaitMs));
+    }
+  }
+
+  void AsyncAppender::pause()
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+    fPauseRequested = true;
+
+    while (fRunning && !fPaused) {
+      mWakeup.notify_one();
+      mDone.wait(lock);
+    }
+  }
+
+  void AsyncAppender::resume()
+  {
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+      fPauseRequested = false;
+    }
+
+    mWakeup.notify_one();
+  }
+
+  void AsyncAppender::reportDropped()
+  {
+    if (mPolicy != Count)
+      return;
+
+    uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+    if (dropped == mReportedDropped)
+      return;
+
+    std::ostringstream msg;
+    msg << "log buffer overflow, " << (dropped - mReportedDropped) << " records were dropped";
+    mReportedDropped = dropped;
+
+    mDevice->doAppend(LoggingEvent(getName(), msg.str(), "LogMgr", Priority::WARN));
+  }
+
+  void AsyncAppender::run()
+  {
+    boost::posix_time::ptime last_report = boost::posix_time::microsec_clock::universal_time();
+
+    while (fRunning && !fCrashed) {
+      bool drained_any = drain();
+
+      boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+      if ((now - last_report).total_milliseconds() >= DropReportIntervalMs) {
+        reportDropped();
+        last_report = now;
+      }
+
+      boost::mutex::scoped_lock lock(mMutex);
+
+      // flush() waits on the head to move past its records
+      if (drained_any)
+        mDone.notify_all();
+
+      if (fPauseRequested) {
+        fPaused = true;
+        mDone.notify_all();
+
+        while (fPauseRequested && fRunning)
+          mWakeup.wait(lock);
+
+        fPaused = false;
+        continue;
+      }
+
+      if (drained_any || !fRunning)
+        continue;
+
+      fIdle = true;
+      mWakeup.timed_wait(lock, boost::posix_time::milliseconds((long)IdleWaitMs));
+      fIdle = false;
+    }
+
+    // let go of anyone still waiting on us
+    boost::mutex::scoped_lock lock(mMutex);
+    mDone.notify_all();
+  }
+
+  void AsyncAppender::flushAll()
+  {
+    for (int i = 0; i < MaxInstances; ++i) {
+      AsyncAppender* appender = gInstances[i].load();
+      if (appender)
+        appender->flush();
+    }
+  }
+
+  void AsyncAppender::dumpAll(int fallback_fd)
+  {
+    for (int i = 0; i < MaxInstances; ++i) {
+      AsyncAppender* appender = gInstances[i].load();
+      if (appender)
+        appender->dump(fallback_fd);
+    }
+  }
+
+  void AsyncAppender::dump(int fallback_fd)
+  {
+    int fd = mFileDevice ? mFileDevice->getFd() : -1;
+    if (fd < 0)
+      fd = fallback_fd;
+
+    // the writer stops before its next record; give it a chance to finish
+    // the one it's on, unless it's stuck, or it's the one that crashed
+    fCrashed = true;
+    for (int spins = 0; fWriting && spins < CrashSpins; ++spins)
+      ;
+
+    // a record the writer is still on may be freed and refilled under us,
+    // leave it be
+    size_t pos = mDequeuePos.load(std::memory_order_acquire);
+    if (fWriting)
+      ++pos;
+
+    for (;;) {
+      slot_t* slot = &mSlots[pos & mMask];
+      if (slot->seq.load(std::memory_order_acquire) != pos + 1)
+        break;
+
+      writeAll(fd, slot->record.category.data(), slot->record.category.size());
+      writeAll(fd, ": ", 2);
+      writeAll(fd, slot->record.message.data(), slot->record.message.size());
+      writeAll(fd, "\n", 1);
+      ++pos;
+    }
+
+    mDequeuePos.store(pos, std::memory_order_release);
+  }
+
+  void AsyncAppender::installCrashHandler()
+  {
+    if (gCrashHandlerInstalled.exchange(true))
+      return;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &onFatalSignal;
+    sigemptyset(&action.sa_mask);
+
+    for (int i = 0; i < gNrFatalSignals; ++i)
+      sigaction(gFatalSignals[i], &action, &gPreviousActions[i]);
+  }
+}
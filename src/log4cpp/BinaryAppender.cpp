@@ -0,0 +1,230 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/log4cpp/BinaryAppender.hpp"
+#include <log4cpp/Priority.hh>
+
+namespace Hax {
+
+  using namespace BinaryLog;
+
+  BinaryAppender::BinaryAppender(const std::string& name, const std::string& path, uint64_t max_size)
+  : AppenderSkeleton(name),
+    mPath(path),
+    mMaxSize(max_size),
+    mSize(0),
+    mFile(0),
+    mLayout(0),
+    mFormatCount(0),
+    mLastTimestamp(0)
+  {
+    open();
+  }
+
+  BinaryAppender::~BinaryAppender()
+  {
+    close();
+
+    if (mLayout)
+      delete mLayout;
+  }
+
+  bool BinaryAppender::open()
+  {
+    mFile = fopen(mPath.c_str(), "ab");
+    if (!mFile)
+      return false;
+
+    setvbuf(mFile, 0, _IOFBF, BufferSize);
+
+    // every file (and every reopening of one) starts over with its own table
+    mStrings.clear();
+    mFormatCount = 0;
+    mLastTimestamp = 0;
+
+    mBuffer.clear();
+    mBuffer += (char)TagHeader;
+    mBuffer.append(Magic + 1, 3);
+    mBuffer += (char)Version;
+    fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+
+    fseek(mFile, 0, SEEK_END);
+    mSize = (uint64_t)ftell(mFile);
+
+    return true;
+  }
+
+  bool BinaryAppender::reopen()
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    if (mFile)
+      fclose(mFile);
+
+    return open();
+  }
+
+  void BinaryAppender::close()
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    if (mFile) {
+      fclose(mFile);
+      mFile = 0;
+    }
+  }
+
+  bool BinaryAppender::requiresLayout() const
+  {
+    return false;
+  }
+
+  void BinaryAppender::setLayout(Layout* layout)
+  {
+    if (mLayout && mLayout != layout)
+      delete mLayout;
+
+    mLayout = layout;
+  }
+
+  void BinaryAppender::rotate()
+  {
+    fclose(mFile);
+
+    std::string backup = mPath + ".1";
+    remove(backup.c_str());
+    rename(mPath.c_str(), backup.c_str());
+
+    open();
+  }
+
+  uint32_t BinaryAppender::intern(std::string const& value)
+  {
+    table_t::const_iterator entry = mStrings.find(value);
+    if (entry != mStrings.end())
+      return entry->second;
+
+    uint32_t id = (uint32_t)mStrings.size();
+    mStrings.insert(std::make_pair(value, id));
+
+    mBuffer += (char)TagString;
+    putVarint(mBuffer, id);
+    putVarint(mBuffer, value.size());
+    mBuffer += value;
+
+    return id;
+  }
+
+  bool BinaryAppender::tokenize(std::string const& message)
+  {
+    mFormat.clear();
+    mArgs.clear();
+
+    const size_t length = message.size();
+    for (size_t i = 0; i < length;) {
+      const char c = message[i];
+
+      if (c == Placeholder)
+        return false;
+
+      if (c < '0' || c > '9') {
+        mFormat += c;
+        ++i;
+        continue;
+      }
+
+      size_t end = i;
+      while (end < length && message[end] >= '0' && message[end] <= '9')
+        ++end;
+
+      // leading zeroes wouldn't survive the round trip
+      const size_t digits = end - i;
+      if (digits > MaxArgDigits || (digits > 1 && c == '0')) {
+        mFormat.append(message, i, digits);
+      } else {
+        uint64_t value = 0;
+        for (; i < end; ++i)
+          value = value * 10 + (uint64_t)(message[i] - '0');
+
+        mArgs.push_back(value);
+        mFormat += Placeholder;
+      }
+
+      i = end;
+    }
+
+    return mFormatCount < MaxFormats || mStrings.count(mFormat);
+  }
+
+  void BinaryAppender::_append(const LoggingEvent& event)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+
+    if (!mFile)
+      return;
+
+    if (mMaxSize && mSize >= mMaxSize)
+      rotate();
+
+    const uint64_t timestamp =
+      (uint64_t)event.timeStamp.getSeconds() * 1000000000ULL +
+      (uint64_t)event.timeStamp.getMicroSeconds() * 1000ULL;
+
+    mBuffer.clear();
+
+    uint32_t context = intern(event.ndc);
+    bool templated = tokenize(event.message);
+
+    uint32_t format = 0;
+    if (templated) {
+      if (!mStrings.count(mFormat))
+        ++mFormatCount;
+
+      format = intern(mFormat);
+    }
+
+    mBuffer += (char)(templated ? TagEvent : TagLiteral);
+    putVarint(mBuffer, zigzag((int64_t)(timestamp - mLastTimestamp)));
+    putVarint(mBuffer, (uint64_t)event.priority);
+    putVarint(mBuffer, context);
+
+    if (templated) {
+      putVarint(mBuffer, format);
+      putVarint(mBuffer, mArgs.size());
+      for (size_t i = 0; i < mArgs.size(); ++i)
+        putVarint(mBuffer, mArgs[i]);
+    } else {
+      putVarint(mBuffer, event.message.size());
+      mBuffer += event.message;
+    }
+
+    mLastTimestamp = timestamp;
+
+    fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+    mSize += mBuffer.size();
+
+    if (event.priority <= Priority::ERROR)
+      fflush(mFile);
+  }
+
+}
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/log4cpp/BinaryLog.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Hax {
+namespace BinaryLog {
+
+  Reader::Reader(std::istream& in)
+  : mIn(in),
+    mLastTimestamp(0),
+    fHeader(false)
+  {
+  }
+
+  std::string const& Reader::getError() const {
+    return mError;
+  }
+
+  bool Reader::fail(const char* error) {
+    mError = error;
+    return false;
+  }
+
+  bool Reader::readVarint(uint64_t& out) {
+    out = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      int c = mIn.get();
+      if (c == EOF)
+        return fail("unexpected end of stream");
+
+      out |= (uint64_t)(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return true;
+    }
+
+    return fail("malformed varint");
+  }
+
+  bool Reader::readString(std::string& out) {
+    uint64_t length;
+    if (!readVarint(length))
+      return false;
+
+    out.resize((size_t)length);
+    if (length && !mIn.read(&out[0], (std::streamsize)length))
+      return fail("unexpected end of stream");
+
+    return true;
+  }
+
+  bool Reader::readId(std::string const*& out) {
+    uint64_t id;
+    if (!readVarint(id))
+      return false;
+
+    if (id >= mStrings.size())
+      return fail("reference to an undefined string");
+
+    out = &mStrings[(size_t)id];
+    return true;
+  }
+
+  bool Reader::next(record_t& record) {
+    int tag;
+    while ((tag = mIn.get()) != EOF) {
+      if (tag == TagHeader) {
+        char magic[3];
+        if (!mIn.read(magic, 3) || memcmp(magic, Magic + 1, 3) != 0)
+          return fail("bad magic, not a binary log");
+
+        int version = mIn.get();
+        if (version != Version)
+          return fail("unsupported binary log version");
+
+        mStrings.clear();
+        mLastTimestamp = 0;
+        fHeader = true;
+        continue;
+      }
+
+      if (!fHeader)
+        return fail("bad magic, not a binary log");
+
+      if (tag == TagString) {
+        uint64_t id;
+        std::string value;
+        if (!readVarint(id) || !readString(value))
+          return false;
+
+        if (id != mStrings.size())
+          return fail("string table entries are out of order");
+
+        mStrings.push_back(value);
+        continue;
+      }
+
+      if (tag != TagEvent && tag != TagLiteral)
+        return fail("unknown entry tag");
+
+      uint64_t dt, priority;
+      std::string const* context;
+      if (!readVarint(dt) || !readVarint(priority) || !readId(context))
+        return false;
+
+      mLastTimestamp += unzigzag(dt);
+      record.timestamp = mLastTimestamp;
+      record.priority = (int)priority;
+      record.context = *context;
+
+      if (tag == TagLiteral)
+        return readString(record.message);
+
+      std::string const* format;
+      uint64_t argc;
+      if (!readId(format) || !readVarint(argc))
+        return false;
+
+      record.message.clear();
+      char digits[24];
+      for (size_t i = 0; i < format->size(); ++i) {
+        if ((*format)[i] != Placeholder) {
+          record.message += (*format)[i];
+          continue;
+        }
+
+        uint64_t arg;
+        if (argc-- == 0)
+          return fail("missing format argument");
+        if (!readVarint(arg))
+          return false;
+
+        snprintf(digits, sizeof(digits), "%llu", (unsigned long long)arg);
+        record.message += digits;
+      }
+
+      if (argc != 0)
+        return fail("too many format arguments");
+
+      return true;
+    }
+
+    return false;
+  }
+
+}
+}
@@ -22,49 +22,15 @@
  */
 
 #include "Hax/log4cpp/FileLayout.hpp"
-#include "log4cpp/Priority.hh"
-#include "log4cpp/FactoryParams.hh"
-
-#ifdef LOG4CPP_HAVE_SSTREAM
-#include <sstream>
-#endif
-#include <iostream>
-#include <iomanip>
-#include <time.h>
 
 namespace Hax {
 
   FileLayout::FileLayout()
+  : LineLayout(true)
   {
   }
 
   FileLayout::~FileLayout() {
   }
 
-  std::string FileLayout::format(const LoggingEvent& event) {
-
-		std::ostringstream message;
-
-    const std::string& priorityName = Priority::getPriorityName(event.priority);
-
-    // no need to print timestamps if we're using syslog
-    struct tm *pTime;
-    time_t ctTime; time(&ctTime);
-    pTime = localtime( &ctTime );
-    message << std::setw(2) << std::setfill('0') << pTime->tm_hour
-        << ":" << std::setw(2) << std::setfill('0') << pTime->tm_min
-        << ":" << std::setw(2) << std::setfill('0') << pTime->tm_sec
-        << " ";
-
-		// start off with priority
-		message << "[" << priorityName[0]	<< "] ";
-
-		// append NDC
-		if (event.ndc != "")
-			message << event.ndc << ": ";
-
-		message << event.message << "\n";
-
-    return message.str();
-  }
 }
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/log4cpp/LineAppenders.hpp"
+
+#include <unistd.h>
+
+namespace Hax {
+
+  LineFileAppender::LineFileAppender(const std::string& name, const std::string& fileName, size_t maxFileSize)
+  : RollingFileAppender(name, fileName, maxFileSize),
+    mLineLayout(0)
+  {
+  }
+
+  LineFileAppender::~LineFileAppender()
+  {
+  }
+
+  void LineFileAppender::setLayout(Layout* layout)
+  {
+    mLineLayout = dynamic_cast<LineLayout*>(layout);
+    RollingFileAppender::setLayout(layout);
+  }
+
+  void LineFileAppender::_append(const LoggingEvent& event)
+  {
+    if (!mLineLayout)
+      return RollingFileAppender::_append(event);
+
+    const std::string& line = mLineLayout->formatLine(event);
+    if (::write(_fd, line.data(), line.size()) < 0)
+      return;
+
+    // same as RollingFileAppender
+    off_t offset = ::lseek(_fd, 0, SEEK_END);
+    if (offset >= 0 && (size_t)offset >= _maxFileSize)
+      rollOver();
+  }
+
+  LineStreamAppender::LineStreamAppender(const std::string& name, std::ostream* stream)
+  : OstreamAppender(name, stream),
+    mLineLayout(0)
+  {
+  }
+
+  LineStreamAppender::~LineStreamAppender()
+  {
+  }
+
+  void LineStreamAppender::setLayout(Layout* layout)
+  {
+    mLineLayout = dynamic_cast<LineLayout*>(layout);
+    OstreamAppender::setLayout(layout);
+  }
+
+  void LineStreamAppender::_append(const LoggingEvent& event)
+  {
+    if (!mLineLayout)
+      return OstreamAppender::_append(event);
+
+    const std::string& line = mLineLayout->formatLine(event);
+    _stream->write(line.data(), line.size());
+  }
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/log4cpp/LineLayout.hpp"
+#include <log4cpp/Priority.hh>
+
+namespace Hax {
+
+  namespace {
+    struct timestamp_t {
+      time_t  second;
+      char    text[LineLayout::TimestampLength + 1];
+    };
+
+    thread_local timestamp_t  tTimestamp = { (time_t)-1, { 0 } };
+    thread_local std::string  tLine;
+
+    inline void write_2digits(char* out, int v) {
+      out[0] = (char)('0' + v / 10);
+      out[1] = (char)('0' + v % 10);
+    }
+  }
+
+  LineLayout::LineLayout(bool timestamp)
+  : fTimestamp(timestamp)
+  {
+  }
+
+  LineLayout::~LineLayout() {
+  }
+
+  const char* LineLayout::getTimestamp(time_t now) {
+    if (tTimestamp.second != now) {
+      struct tm lt;
+      localtime_r(&now, &lt);
+
+      char* out = tTimestamp.text;
+      write_2digits(out, lt.tm_hour); out[2] = ':';
+      write_2digits(out + 3, lt.tm_min); out[5] = ':';
+      write_2digits(out + 6, lt.tm_sec); out[8] = ' ';
+      out[9] = '\0';
+
+      tTimestamp.second = now;
+    }
+
+    return tTimestamp.text;
+  }
+
+  const std::string& LineLayout::formatLine(const LoggingEvent& event) {
+    std::string& line = tLine;
+    line.clear();
+
+    if (fTimestamp)
+      line.append(getTimestamp((time_t)event.timeStamp.getSeconds()), TimestampLength);
+
+    // start off with priority
+    line += '[';
+    line += Priority::getPriorityName(event.priority)[0];
+    line.append("] ", 2);
+
+    // append NDC
+    if (!event.ndc.empty()) {
+      line += event.ndc;
+      line.append(": ", 2);
+    }
+
+    line += event.message;
+    line += '\n';
+
+    return line;
+  }
+
+  std::string LineLayout::format(const LoggingEvent& event) {
+    return formatLine(event);
+  }
+
+}
@@ -0,0 +1,161 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#include "Hax/log4cpp/RateLimitFilter.hpp"
+#include <log4cpp/Priority.hh>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace Hax {
+
+  static const std::string ExemptContext = "LogMgr";
+
+  RateLimitFilter::RateLimitFilter()
+  : Filter(),
+    mReportAppender(0),
+    mReportInterval(std::chrono::seconds(10)),
+    mNextReport(steady_t::now() + mReportInterval)
+  {
+  }
+
+  RateLimitFilter::~RateLimitFilter()
+  {
+  }
+
+  void RateLimitFilter::setDefaultRule(rule_t const& rule)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+    mDefault = rule;
+    mStates.clear();
+  }
+
+  void RateLimitFilter::setRule(std::string const& context, rule_t const& rule)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+    mRules[context] = rule;
+    mStates.erase(context);
+  }
+
+  void RateLimitFilter::setReportAppender(Appender* appender, unsigned interval_seconds)
+  {
+    boost::mutex::scoped_lock lock(mMutex);
+    mReportAppender = appender;
+    mReportInterval = std::chrono::seconds(std::max(interval_seconds, 1u));
+    mNextReport = steady_t::now() + mReportInterval;
+  }
+
+  RateLimitFilter::state_t& RateLimitFilter::getState(std::string const& context, steady_t::time_point now)
+  {
+    states_t::iterator entry = mStates.find(context);
+    if (entry != mStates.end())
+      return entry->second;
+
+    state_t state;
+    std::unordered_map<std::string, rule_t>::const_iterator rule = mRules.find(context);
+    state.rule = rule == mRules.end() ? mDefault : rule->second;
+    state.rule.burst = std::max(state.rule.burst, std::max(state.rule.rate, 1.0));
+    state.rule.sample = std::max(state.rule.sample, 1u);
+    state.tokens = state.rule.burst;
+    state.last_refill = now;
+    state.seen = state.limited = state.sampled = 0;
+
+    return mStates.insert(std::make_pair(context, state)).first->second;
+  }
+
+  Filter::Decision RateLimitFilter::_decide(const LoggingEvent& event)
+  {
+    if (event.ndc == ExemptContext)
+      return Filter::NEUTRAL;
+
+    const steady_t::time_point now = steady_t::now();
+    Decision decision = Filter::NEUTRAL;
+    bool report_due = false;
+
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+
+      state_t& state = getState(event.ndc, now);
+
+      if (state.rule.sample > 1 && event.priority > Priority::WARN) {
+        if (state.seen++ % state.rule.sample != 0) {
+          ++state.sampled;
+          decision = Filter::DENY;
+        }
+      }
+
+      if (decision != Filter::DENY && state.rule.rate > 0) {
+        std::chrono::duration<double> elapsed = now - state.last_refill;
+        state.tokens = std::min(state.rule.burst, state.tokens + elapsed.count() * state.rule.rate);
+        state.last_refill = now;
+
+        if (state.tokens >= 1.0) {
+          state.tokens -= 1.0;
+        } else {
+          ++state.limited;
+          decision = Filter::DENY;
+        }
+      }
+
+      if (mReportAppender && now >= mNextReport) {
+        mNextReport = now + mReportInterval;
+        report_due = true;
+      }
+    }
+
+    if (report_due)
+      report();
+
+    return decision;
+  }
+
+  void RateLimitFilter::report()
+  {
+    std::vector<std::string> lines;
+
+    {
+      boost::mutex::scoped_lock lock(mMutex);
+
+      for (states_t::iterator entry = mStates.begin(); entry != mStates.end(); ++entry) {
+        state_t& state = entry->second;
+        if (!state.limited && !state.sampled)
+          continue;
+
+        std::ostringstream msg;
+        msg << "suppressed " << (state.limited + state.sampled)
+            << " messages from '" << entry->first << "' ("
+            << state.limited << " rate limited, "
+            << state.sampled << " sampled out)";
+        lines.push_back(msg.str());
+
+        state.limited = state.sampled = 0;
+      }
+    }
+
+    // the context is exempt, so this doesn't come back through the limits
+    for (size_t i = 0; i < lines.size(); ++i)
+      mReportAppender->doAppend(LoggingEvent("RateLimitFilter", lines[i], ExemptContext, Priority::WARN));
+  }
+
+}
@@ -22,32 +22,16 @@
  */
 
 #include "Hax/log4cpp/SyslogLayout.hpp"
-#include <sstream>
 
 namespace Hax {
 
-  SyslogLayout::SyslogLayout() {
+  // no need to print timestamps if we're using syslog
+  SyslogLayout::SyslogLayout()
+  : LineLayout(false)
+  {
   }
 
   SyslogLayout::~SyslogLayout() {
   }
 
-  std::string SyslogLayout::format(const LoggingEvent& event) {
-
-		std::ostringstream message;
-
-    const std::string& priorityName = Priority::getPriorityName(event.priority);
-
-		// start off with priority
-		message << "[" << priorityName[0]	<< "] ";
-
-		// append NDC
-		if (event.ndc != "")
-			message << event.ndc << ": ";
-
-		message << event.message << "\n";
-
-    return message.str();
-  }
-
 }
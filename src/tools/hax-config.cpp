@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/**
+ * hax-config: compiles a JSON configuration sheet into a binary snapshot that
+ * Configurator::run(snapshot_path) can apply at boot without parsing.
+ *
+ * Usage:
+ *  hax-config compile path/to/sheet.json path/to/snapshot.haxc
+ */
+
+#include "Hax/Hax.hpp"
+#include "Hax/LogManager.hpp"
+#include "Hax/Configurator.hpp"
+
+#include <iostream>
+#include <fstream>
+
+using namespace Hax;
+
+static int usage(const char* bin)
+{
+  std::cerr << "Usage: " << bin << " compile <sheet.json> <snapshot.haxc>\n";
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 4 || string_t(argv[1]) != "compile")
+    return usage(argv[0]);
+
+  std::ifstream fh(argv[2]);
+  if (!fh.is_open() || !fh.good()) {
+    std::cerr << "unable to open configuration sheet '" << argv[2] << "'\n";
+    return 1;
+  }
+
+  // report to stdout, without the application header
+  LogManager::getSingleton().setSilent(true);
+  LogManager::getSingleton().configure();
+
+  bool success = false;
+  {
+    Configurator cfg(fh);
+    success = cfg.compile(argv[3]);
+  }
+
+  fh.close();
+
+  LogManager::getSingleton().cleanup();
+
+  return success ? 0 : 1;
+}
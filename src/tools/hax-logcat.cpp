@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/**
+ * hax-logcat: decodes logs written by the "binary" LogManager device back into
+ * FileLayout-style text, or into JSON (one object per line).
+ *
+ * Usage:
+ *  hax-logcat [--json] [path/to/log...]
+ *
+ * Files are decoded in the given order, standard input is read if none is.
+ */
+
+#include "Hax/log4cpp/BinaryLog.hpp"
+#include <log4cpp/Priority.hh>
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+
+using namespace Hax;
+
+static int usage(const char* bin)
+{
+  std::cerr << "Usage: " << bin << " [--json] [log...]\n";
+  return 1;
+}
+
+static void printText(BinaryLog::record_t const& record)
+{
+  time_t seconds = (time_t)(record.timestamp / 1000000000ULL);
+  struct tm lt;
+  localtime_r(&seconds, &lt);
+
+  char stamp[16];
+  strftime(stamp, sizeof(stamp), "%H:%M:%S", &lt);
+
+  std::cout << stamp
+    << " [" << log4cpp::Priority::getPriorityName(record.priority)[0] << "] ";
+
+  if (!record.context.empty())
+    std::cout << record.context << ": ";
+
+  std::cout << record.message << "\n";
+}
+
+static void printJSONString(std::string const& value)
+{
+  std::cout << '"';
+  for (size_t i = 0; i < value.size(); ++i) {
+    const unsigned char c = (unsigned char)value[i];
+    switch (c) {
+      case '"':  std::cout << "\\\""; break;
+      case '\\': std::cout << "\\\\"; break;
+      case '\n': std::cout << "\\n"; break;
+      case '\r': std::cout << "\\r"; break;
+      case '\t': std::cout << "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          std::cout << escaped;
+        } else {
+          std::cout << (char)c;
+        }
+    }
+  }
+  std::cout << '"';
+}
+
+static void printJSON(BinaryLog::record_t const& record)
+{
+  std::cout << "{\"time\":" << record.timestamp << ",\"priority\":";
+  printJSONString(log4cpp::Priority::getPriorityName(record.priority));
+  std::cout << ",\"context\":";
+  printJSONString(record.context);
+  std::cout << ",\"message\":";
+  printJSONString(record.message);
+  std::cout << "}\n";
+}
+
+static bool decode(std::istream& in, const char* name, bool json)
+{
+  BinaryLog::Reader reader(in);
+  BinaryLog::record_t record;
+
+  while (reader.next(record)) {
+    if (json)
+      printJSON(record);
+    else
+      printText(record);
+  }
+
+  if (!reader.getError().empty()) {
+    std::cerr << name << ": " << reader.getError() << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  bool json = false;
+  int first = 1;
+
+  if (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+    if (strcmp(argv[1], "--json") != 0)
+      return usage(argv[0]);
+
+    json = true;
+    first = 2;
+  }
+
+  if (first == argc)
+    return decode(std::cin, "<stdin>", json) ? 0 : 1;
+
+  bool success = true;
+  for (int i = first; i < argc; ++i) {
+    std::ifstream fh(argv[i], std::ios::in | std::ios::binary);
+    if (!fh.is_open()) {
+      std::cerr << "unable to open log '" << argv[i] << "'\n";
+      success = false;
+      continue;
+    }
+
+    success = decode(fh, argv[i], json) && success;
+  }
+
+  return success ? 0 : 1;
+}
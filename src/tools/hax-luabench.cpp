@@ -0,0 +1,156 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/**
+ * hax-luabench: measures how fast Lua event handlers get through events passed
+ * by the ScriptEngine, per way of passing them.
+ *
+ * Usage:
+ *  hax-luabench [events]
+ *
+ * Every build runs the "usertype" mode: events are tolua++ usertypes, and the
+ * handler reads a property through the generated wrappers. LuaJIT builds (see
+ * the HAX_LUAJIT CMake option) also run the "ffi" mode, where the handler reads
+ * a flat hax_event_t through the FFI, and run both modes once with the JIT
+ * compiler on and once with only the interpreter.
+ *
+ * To compare stock Lua against LuaJIT, run the tool off both builds.
+ */
+
+#include "Hax/Hax.hpp"
+#include "Hax/LogManager.hpp"
+#include "Hax/ScriptEngine.hpp"
+#include "Hax/LuaFFI.hpp"
+
+#ifdef HAX_LUAJIT
+extern "C" {
+  #include "luajit.h"
+}
+#endif
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+using namespace Hax;
+
+static const char* Handlers =
+  "Bench = { seen = 0 }\n"
+  "function Bench.onEvent(evt)\n"
+  "  if evt:getProperty('Entity') ~= '' then Bench.seen = Bench.seen + 1 end\n"
+  "  return true\n"
+  "end\n"
+  "function Bench.onFlatEvent(ptr)\n"
+  "  if Hax.flatProperty(Hax.flatEvent(ptr), 'Entity') then Bench.seen = Bench.seen + 1 end\n"
+  "  return true\n"
+  "end\n";
+
+static int usage(const char* bin)
+{
+  std::cerr << "Usage: " << bin << " [events]\n";
+  return 1;
+}
+
+/** runs the handler over count events, returns the events handled per second */
+template <typename Arg>
+static double run(ScriptEngine& engine, const char* handler, Event& evt, Arg (*arg)(Event&), size_t count)
+{
+  ScriptEngine::callback_t callback = engine.getCallback(handler);
+
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    evt.setProperty("Entity", (int)(i % 1024));
+    engine.call<bool>(callback, arg(evt));
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+  return seconds > 0 ? count / seconds : 0;
+}
+
+static Event const& asUsertype(Event& evt)
+{
+  return evt;
+}
+
+static const void* asFlatEvent(Event& evt)
+{
+  static FlatEvent flat;
+  return flat.assign(evt);
+}
+
+static void report(const char* mode, double rate)
+{
+  std::cout << mode << ": " << (uint64_t)rate << " events/s\n";
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 2)
+    return usage(argv[0]);
+
+  size_t count = argc == 2 ? (size_t)strtoull(argv[1], 0, 10) : 1000000;
+  if (!count)
+    return usage(argv[0]);
+
+  LogManager::getSingleton().setSilent(true);
+  LogManager::getSingleton().configure();
+
+  int rc = 0;
+  {
+    ScriptEngine engine;
+    engine.setup();
+
+    lua_State* lua = engine.getLuaState();
+    bool flat = LuaFFI::open(lua);
+
+    if (luaL_dostring(lua, Handlers) != 0) {
+      std::cerr << "unable to load the handlers: " << lua_tostring(lua, -1) << "\n";
+      rc = 1;
+    }
+    else {
+      Event evt(EventUID::EntitySelected);
+
+#ifdef HAX_LUAJIT
+      report("usertype (jit)", run(engine, "Bench.onEvent", evt, &asUsertype, count));
+      if (flat)
+        report("ffi (jit)", run(engine, "Bench.onFlatEvent", evt, &asFlatEvent, count));
+
+      luaJIT_setmode(lua, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+
+      report("usertype (interpreter)", run(engine, "Bench.onEvent", evt, &asUsertype, count));
+      if (flat)
+        report("ffi (interpreter)", run(engine, "Bench.onFlatEvent", evt, &asFlatEvent, count));
+#else
+      report("usertype", run(engine, "Bench.onEvent", evt, &asUsertype, count));
+      (void)flat;
+#endif
+    }
+
+    engine.cleanup();
+  }
+
+  LogManager::getSingleton().cleanup();
+
+  return rc;
+}
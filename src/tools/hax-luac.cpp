@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+/**
+ * hax-luac: precompiles Lua scripts into a ScriptEngine bytecode cache, so the
+ * first boot off a package doesn't have to compile them either.
+ *
+ * Usage:
+ *  hax-luac path/to/cache script.lua [script.lua...]
+ *
+ * Point the "Bytecode Cache" setting of the "Script Engine" context at the
+ * same directory, and refer to the scripts by the same paths given here; the
+ * cache entries are keyed by them.
+ */
+
+#include "Hax/Hax.hpp"
+#include "Hax/LogManager.hpp"
+#include "Hax/ScriptCache.hpp"
+
+extern "C" {
+  #include "lauxlib.h"
+}
+
+#include <iostream>
+
+using namespace Hax;
+
+static int usage(const char* bin)
+{
+  std::cerr << "Usage: " << bin << " <cache directory> <script...>\n";
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+    return usage(argv[0]);
+
+  // report to stdout, without the application header
+  LogManager::getSingleton().setSilent(true);
+  LogManager::getSingleton().configure();
+
+  int failures = 0;
+  {
+    ScriptCache cache(argv[1]);
+    lua_State* lua = luaL_newstate();
+
+    for (int i = 2; i < argc; ++i) {
+      if (cache.compile(lua, argv[i]))
+        std::cout << argv[i] << " -> " << cache.getEntryPath(argv[i]) << "\n";
+      else
+        ++failures;
+    }
+
+    lua_close(lua);
+  }
+
+  LogManager::getSingleton().cleanup();
+
+  return failures ? 1 : 0;
+}
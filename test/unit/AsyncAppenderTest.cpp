@@ -0,0 +1,226 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE AsyncAppender
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/log4cpp/AsyncAppender.hpp"
+
+#include <log4cpp/Layout.hh>
+
+#include <map>
+#include <vector>
+#include <sstream>
+
+using namespace Hax;
+
+namespace {
+
+  /**
+   * Counts the records it's handed, and the times it's entered while another
+   * thread is still inside it: the writer must be the device's only user.
+   */
+  class Device : public AppenderSkeleton {
+  public:
+    Device()
+    : AppenderSkeleton("device"),
+      mInside(0),
+      mOverlaps(0),
+      mReordered(0),
+      mWritten(0),
+      mLayout(0)
+    {
+    }
+
+    virtual ~Device() {
+      delete mLayout;
+    }
+
+    virtual void close() { }
+    virtual bool requiresLayout() const { return true; }
+
+    virtual void setLayout(Layout* layout) {
+      enter();
+      delete mLayout;
+      mLayout = layout;
+      leave();
+    }
+
+    uint64_t getOverlaps() const { return mOverlaps; }
+    uint64_t getReordered() const { return mReordered; }
+    uint64_t getWritten() const { return mWritten; }
+
+  protected:
+    virtual void _append(const LoggingEvent& event) {
+      enter();
+
+      // every producer logs its own counter, which must only go up
+      long value = 0;
+      std::istringstream(event.message) >> value;
+
+      std::map<std::string, long>::iterator last = mLast.find(event.categoryName);
+      if (last != mLast.end() && value <= last->second)
+        ++mReordered;
+
+      mLast[event.categoryName] = value;
+      ++mWritten;
+
+      leave();
+    }
+
+  private:
+    void enter() {
+      if (mInside.fetch_add(1) != 0)
+        ++mOverlaps;
+    }
+
+    void leave() {
+      --mInside;
+    }
+
+    std::atomic<int>      mInside;
+    std::atomic<uint64_t> mOverlaps;
+    uint64_t              mReordered;
+    uint64_t              mWritten;
+    std::map<std::string, long> mLast;
+    Layout                *mLayout;
+  };
+
+  class NullLayout : public Layout {
+  public:
+    virtual std::string format(const LoggingEvent&) { return std::string(); }
+  };
+
+  LoggingEvent makeEvent(int producer, long value) {
+    std::ostringstream category, message;
+    category << "producer" << producer;
+    message << value;
+
+    return LoggingEvent(category.str(), message.str(), "", Priority::INFO);
+  }
+
+  void produce(AsyncAppender* appender, int producer, long count) {
+    for (long i = 0; i < count; ++i) {
+      appender->doAppend(makeEvent(producer, i));
+
+      // take turns at the device while the writer is at it
+      if (i % 1000 == 0)
+        appender->flush();
+      if (i % 5000 == 0)
+        appender->setLayout(new NullLayout());
+    }
+  }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(the_writer_is_the_only_consumer)
+{
+  const int producers = 4;
+  const long records = 20000;
+
+  Device* device = new Device();
+  {
+    AsyncAppender appender("async", device, 64, AsyncAppender::Block);
+
+    std::vector<boost::thread*> threads;
+    for (int i = 0; i < producers; ++i)
+      threads.push_back(new boost::thread(&produce, &appender, i, records));
+
+    for (boost::thread* thread : threads) {
+      thread->join();
+      delete thread;
+    }
+
+    appender.flush();
+
+    BOOST_CHECK_EQUAL(device->getWritten(), (uint64_t)(producers * records));
+    BOOST_CHECK_EQUAL(device->getOverlaps(), 0u);
+    BOOST_CHECK_EQUAL(device->getReordered(), 0u);
+    BOOST_CHECK_EQUAL(appender.getDropped(), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(flush_writes_everything_pushed_before_it)
+{
+  Device* device = new Device();
+  AsyncAppender appender("async", device, 1024, AsyncAppender::Block);
+
+  for (long i = 0; i < 500; ++i) {
+    appender.doAppend(makeEvent(0, i));
+
+    if (i % 50 == 49) {
+      appender.flush();
+      BOOST_CHECK_EQUAL(device->getWritten(), (uint64_t)(i + 1));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(dropped_records_are_accounted_for)
+{
+  const long records = 100000;
+
+  Device* device = new Device();
+  AsyncAppender appender("async", device, 16, AsyncAppender::Drop);
+
+  for (long i = 0; i < records; ++i)
+    appender.doAppend(makeEvent(0, i));
+
+  appender.flush();
+
+  // whatever was written is still in order, and the rest was dropped
+  BOOST_CHECK_EQUAL(device->getWritten() + appender.getDropped(), (uint64_t)records);
+  BOOST_CHECK_EQUAL(device->getReordered(), 0u);
+  BOOST_CHECK_EQUAL(device->getOverlaps(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(blocking_never_drops)
+{
+  const long records = 100000;
+
+  Device* device = new Device();
+  AsyncAppender appender("async", device, 16, AsyncAppender::Block);
+
+  for (long i = 0; i < records; ++i)
+    appender.doAppend(makeEvent(0, i));
+
+  appender.flush();
+
+  BOOST_CHECK_EQUAL(device->getWritten(), (uint64_t)records);
+  BOOST_CHECK_EQUAL(appender.getDropped(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(out_of_range_capacities_are_clamped)
+{
+  const size_t capacities[] = { 0, 1, (size_t)-1 };
+
+  for (size_t capacity : capacities) {
+    Device* device = new Device();
+    AsyncAppender appender("async", device, capacity, AsyncAppender::Block);
+
+    for (long i = 0; i < 100; ++i)
+      appender.doAppend(makeEvent(0, i));
+
+    appender.flush();
+    BOOST_CHECK_EQUAL(device->getWritten(), 100u);
+  }
+}
@@ -0,0 +1,263 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE ConfigSnapshot
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/ConfigSnapshot.hpp"
+#include "Hax/Configurator.hpp"
+#include "Hax/Configurable.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+
+using namespace Hax;
+
+namespace {
+
+  typedef std::vector<string_t> calls_t;
+
+  /** a scratch directory, removed with everything in it */
+  struct Scratch {
+    Scratch()
+    : path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("hax-%%%%-%%%%-%%%%"))
+    {
+      boost::filesystem::create_directories(path);
+    }
+
+    ~Scratch() {
+      boost::filesystem::remove_all(path);
+    }
+
+    string_t file(string_t const& name, string_t const& content = string_t()) const {
+      string_t file_path = (path / name).string();
+      if (!content.empty())
+        std::ofstream(file_path.c_str(), std::ios::out | std::ios::binary) << content;
+
+      return file_path;
+    }
+
+    boost::filesystem::path path;
+  };
+
+  /** writes down every call apply() makes */
+  class Recorder : public ConfigSnapshot::Visitor {
+  public:
+    calls_t calls;
+
+    virtual void onContextStart(string_t const& context) {
+      calls.push_back("start " + context);
+    }
+
+    virtual void onOption(string_t const& key, ConfigValue const& value) {
+      std::ostringstream call;
+      call << key << "=" << value.raw << " (" << value.type << ", " << value.number << ")";
+      calls.push_back(call.str());
+    }
+
+    virtual void onContextEnd(bool complete) {
+      calls.push_back(complete ? "end" : "suspend");
+    }
+  };
+
+  /** writes down the options it's assigned and when it's configured */
+  class Subscriber : public Configurable {
+  public:
+    Subscriber(string_t const& context, calls_t& calls)
+    : Configurable(std::vector<string_t>(1, context)),
+      mContext(context),
+      mCalls(calls)
+    {
+    }
+
+    virtual void setOption(string_t const& key, string_t const& value) {
+      mCalls.push_back(mContext + "." + key + "=" + value);
+    }
+
+    virtual void configure() {
+      mCalls.push_back(mContext + " configured");
+    }
+
+  private:
+    string_t mContext;
+    calls_t& mCalls;
+  };
+
+  calls_t replay(string_t const& path) {
+    ConfigSnapshot snapshot;
+    BOOST_REQUIRE(snapshot.load(path));
+
+    Recorder recorder;
+    snapshot.apply(recorder);
+    return recorder.calls;
+  }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(contexts_and_typed_options_survive_a_round_trip)
+{
+  Scratch scratch;
+  string_t path = scratch.file("snapshot.haxc");
+
+  {
+    ConfigSnapshot snapshot;
+    snapshot.addSource("", "{}");
+    snapshot.beginContext("Log");
+    snapshot.record("Level", "debug");
+    snapshot.record("Silent", "off");
+    snapshot.beginContext("Net");
+    snapshot.record("Port", "-8080");
+    BOOST_REQUIRE(snapshot.save(path));
+  }
+
+  const char* expected[] = {
+    "start Log",
+    "Level=debug (0, 0)",
+    "Silent=off (1, 0)",
+    "end",
+    "start Net",
+    "Port=-8080 (2, -8080)",
+    "end"
+  };
+
+  calls_t calls = replay(path);
+  BOOST_CHECK_EQUAL_COLLECTIONS(
+    calls.begin(), calls.end(),
+    expected, expected + sizeof(expected) / sizeof(expected[0]));
+
+  ConfigSnapshot snapshot;
+  BOOST_REQUIRE(snapshot.load(path));
+  BOOST_REQUIRE_EQUAL(snapshot.getSources().size(), 1u);
+  BOOST_CHECK(snapshot.getSources().front().uri.empty());
+  BOOST_CHECK_EQUAL(snapshot.getSources().front().hash, Utility::fnv1a_64("{}"));
+}
+
+BOOST_AUTO_TEST_CASE(a_context_interrupted_by_an_include_ends_once)
+{
+  Scratch scratch;
+  string_t path = scratch.file("snapshot.haxc");
+
+  // what the Configurator records for {"Log": {"a": .., "include": .., "b": ..}}
+  {
+    ConfigSnapshot snapshot;
+    snapshot.addSource("", "root");
+    snapshot.beginContext("Log");
+    snapshot.record("a", "1");
+    snapshot.suspendContext();
+    snapshot.addSource("file:///included.json", "included");
+    snapshot.beginContext("Net");
+    snapshot.record("c", "x");
+    snapshot.beginContext("Log");
+    snapshot.record("b", "2");
+    BOOST_REQUIRE(snapshot.save(path));
+  }
+
+  const char* expected[] = {
+    "start Log",
+    "a=1 (2, 1)",
+    "suspend",
+    "start Net",
+    "c=x (0, 0)",
+    "end",
+    "start Log",
+    "b=2 (2, 2)",
+    "end"
+  };
+
+  calls_t calls = replay(path);
+  BOOST_CHECK_EQUAL_COLLECTIONS(
+    calls.begin(), calls.end(),
+    expected, expected + sizeof(expected) / sizeof(expected[0]));
+}
+
+BOOST_AUTO_TEST_CASE(missing_and_malformed_snapshots_are_rejected)
+{
+  Scratch scratch;
+
+  ConfigSnapshot snapshot;
+  BOOST_CHECK(!snapshot.load(scratch.file("missing.haxc")));
+  BOOST_CHECK(!snapshot.load(scratch.file("garbage.haxc", "definitely not a snapshot")));
+}
+
+BOOST_AUTO_TEST_CASE(replaying_a_snapshot_equals_parsing_the_sheet)
+{
+  Scratch scratch;
+
+  string_t include = scratch.file("included.json",
+    "{ \"Included\": { \"Host\": \"localhost\", \"Port\": \"8080\" } }");
+
+  string_t sheet =
+    "{\n"
+    "  \"Outer\": {\n"
+    "    \"Level\": \"debug\",\n"
+    "    \"include\": \"file://" + include + "\",\n"
+    "    \"Silent\": \"off\"\n"
+    "  },\n"
+    "  \"Last\": { \"Path\": \"scripts\" }\n"
+    "}\n";
+
+  string_t snapshot_path = scratch.file("sheet.haxc");
+
+  Configurator::init();
+
+  calls_t parsed, replayed;
+  {
+    Subscriber outer("Outer", parsed), included("Included", parsed), last("Last", parsed);
+
+    Configurator cfg(sheet);
+    BOOST_REQUIRE(cfg.compile(snapshot_path));
+    BOOST_CHECK(parsed.empty());
+
+    cfg.run();
+    Configurator::init();
+  }
+
+  {
+    Subscriber outer("Outer", replayed), included("Included", replayed), last("Last", replayed);
+
+    Configurator cfg(sheet);
+    BOOST_CHECK(cfg.run(snapshot_path));
+    Configurator::init();
+  }
+
+  // the included context is configured in between, and the one around it once
+  const char* expected[] = {
+    "Outer.Level=debug",
+    "Included.Host=localhost",
+    "Included.Port=8080",
+    "Included configured",
+    "Outer.Silent=off",
+    "Outer configured",
+    "Last.Path=scripts",
+    "Last configured"
+  };
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(
+    parsed.begin(), parsed.end(),
+    expected, expected + sizeof(expected) / sizeof(expected[0]));
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(
+    replayed.begin(), replayed.end(),
+    parsed.begin(), parsed.end());
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE EngineScheduler
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/EngineScheduler.hpp"
+
+#include <algorithm>
+
+using namespace Hax;
+
+namespace {
+
+  /** counts its updates and the time it was handed */
+  class Ticker : public Engine {
+  public:
+    Ticker() : updates(0), elapsed(0), smallest(~0UL), largest(0) { }
+
+    virtual bool setup() { return true; }
+    virtual bool cleanup() { return true; }
+
+    virtual void update(unsigned long lTimeElapsed) {
+      ++updates;
+      elapsed += lTimeElapsed;
+      smallest = std::min(smallest, lTimeElapsed);
+      largest = std::max(largest, lTimeElapsed);
+    }
+
+    unsigned long updates;
+    unsigned long elapsed;
+    unsigned long smallest;
+    unsigned long largest;
+  };
+
+  /** runs as many steps of the default 16ms timestep as make up seconds */
+  void simulate(EngineScheduler& scheduler, unsigned long seconds) {
+    for (unsigned long step = 0; step < seconds * 1000 / 16; ++step)
+      scheduler.step();
+  }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(rates_that_dont_divide_the_timestep_dont_drift)
+{
+  Ticker sixty, hundred_twenty, seven;
+
+  EngineScheduler scheduler;
+  scheduler.add("sixty", &sixty, 60);
+  scheduler.add("hundred twenty", &hundred_twenty, 120);
+  scheduler.add("seven", &seven, 7);
+  BOOST_REQUIRE(scheduler.setup());
+
+  simulate(scheduler, 16);
+
+  BOOST_CHECK_EQUAL(sixty.updates, 16u * 60);
+  BOOST_CHECK_EQUAL(hundred_twenty.updates, 16u * 120);
+  BOOST_CHECK_EQUAL(seven.updates, 16u * 7);
+
+  scheduler.cleanup();
+}
+
+BOOST_AUTO_TEST_CASE(handed_periods_add_up_to_real_time)
+{
+  Ticker sixty, every_step;
+
+  EngineScheduler scheduler;
+  scheduler.add("sixty", &sixty, 60);
+  scheduler.add("every step", &every_step);
+  BOOST_REQUIRE(scheduler.setup());
+
+  simulate(scheduler, 16);
+
+  BOOST_CHECK_EQUAL(sixty.elapsed, 16000u);
+  BOOST_CHECK_EQUAL(sixty.smallest, 16u);
+  BOOST_CHECK_EQUAL(sixty.largest, 17u);
+
+  BOOST_CHECK_EQUAL(every_step.updates, 1000u);
+  BOOST_CHECK_EQUAL(every_step.elapsed, 16000u);
+
+  scheduler.cleanup();
+}
+
+BOOST_AUTO_TEST_CASE(rates_above_the_timestep_are_met_on_average)
+{
+  Ticker fast, faster_than_a_millisecond;
+
+  EngineScheduler scheduler;
+  scheduler.add("fast", &fast, 250);
+  scheduler.add("faster than a millisecond", &faster_than_a_millisecond, 2000);
+  BOOST_REQUIRE(scheduler.setup());
+
+  simulate(scheduler, 16);
+
+  BOOST_CHECK_EQUAL(fast.updates, 16u * 250);
+  BOOST_CHECK_EQUAL(fast.elapsed, 16000u);
+
+  BOOST_CHECK_EQUAL(faster_than_a_millisecond.updates, 16u * 2000);
+  BOOST_CHECK_EQUAL(faster_than_a_millisecond.elapsed, 16000u);
+
+  scheduler.cleanup();
+}
@@ -0,0 +1,266 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE EventListener
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/EventListener.hpp"
+#include "Hax/EventManager.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Hax;
+
+namespace {
+
+  /** feeds itself events, instead of waiting on the EventManager */
+  class Listener : public EventListener {
+  public:
+    using EventListener::enqueue;
+
+    virtual ~Listener() {
+      unbindAll();
+    }
+  };
+
+  Event makeEvent(int n, EventUID_T uid = EventUID::EntitySelected) {
+    Event evt(uid);
+    evt.setProperty("n", n);
+    return evt;
+  }
+
+  /** a handler that writes down the events it's called with */
+  struct Handler {
+    Handler(std::vector<string_t>* in_calls, int in_failures = 0)
+    : calls(in_calls),
+      failures(in_failures)
+    {
+    }
+
+    bool operator()(const Event& evt) {
+      calls->push_back(evt.getProperty("n"));
+      return failures-- <= 0;
+    }
+
+    std::vector<string_t> *calls;
+    int failures;
+  };
+
+  std::vector<string_t> sequence(int from, int to) {
+    std::vector<string_t> out;
+    for (int n = from; n < to; ++n)
+      out.push_back(Utility::stringify(n));
+
+    return out;
+  }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(events_are_handled_in_order)
+{
+  Listener listener;
+  std::vector<string_t> calls;
+  listener.bind(EventUID::EntitySelected, Handler(&calls));
+
+  for (int n = 0; n < 5; ++n)
+    listener.enqueue(makeEvent(n));
+
+  BOOST_CHECK(listener.processEvents());
+
+  std::vector<string_t> expected = sequence(0, 5);
+  BOOST_CHECK_EQUAL_COLLECTIONS(calls.begin(), calls.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(a_failing_handler_is_retried_alone_and_holds_the_queue)
+{
+  Listener listener;
+  std::vector<string_t> done, failing;
+  listener.bind(EventUID::EntitySelected, Handler(&done));
+  listener.bind(EventUID::EntitySelected, Handler(&failing, 2));
+
+  listener.enqueue(makeEvent(0));
+  listener.enqueue(makeEvent(1));
+
+  // the first event is stuck, and the second waits behind it
+  BOOST_CHECK(!listener.processEvents());
+  BOOST_CHECK(!listener.processEvents());
+  BOOST_CHECK_EQUAL(done.size(), 1u);
+  BOOST_CHECK_EQUAL(failing.size(), 2u);
+
+  // the handler that's done with the event isn't called with it again
+  BOOST_CHECK(listener.processEvents());
+
+  const char* expected_done[] = { "0", "1" };
+  const char* expected_failing[] = { "0", "0", "0", "1" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(done.begin(), done.end(), expected_done, expected_done + 2);
+  BOOST_CHECK_EQUAL_COLLECTIONS(failing.begin(), failing.end(), expected_failing, expected_failing + 4);
+}
+
+BOOST_AUTO_TEST_CASE(catch_all_handlers_are_retried_too)
+{
+  Listener listener;
+  std::vector<string_t> own, all;
+  listener.bind(EventUID::EntitySelected, Handler(&own));
+  listener.bind(EventUID::Unassigned, Handler(&all, 1));
+
+  listener.enqueue(makeEvent(0));
+
+  BOOST_CHECK(!listener.processEvents());
+  BOOST_CHECK(listener.processEvents());
+
+  BOOST_CHECK_EQUAL(own.size(), 1u);
+  BOOST_CHECK_EQUAL(all.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(an_unbound_handler_is_no_longer_retried)
+{
+  Listener listener;
+  std::vector<string_t> own, all;
+  listener.bind(EventUID::EntitySelected, Handler(&own));
+  listener.bind(EventUID::Unassigned, Handler(&all, 100));
+
+  listener.enqueue(makeEvent(0));
+  listener.enqueue(makeEvent(1));
+
+  BOOST_CHECK(!listener.processEvents());
+
+  listener.unbind(EventUID::Unassigned);
+  BOOST_CHECK(listener.processEvents());
+
+  const char* expected_own[] = { "0", "1" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(own.begin(), own.end(), expected_own, expected_own + 2);
+  BOOST_CHECK_EQUAL(all.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(a_handler_rebound_between_retries_is_not_mistaken_for_the_pending_one)
+{
+  Listener listener;
+  std::vector<string_t> failing, rebound;
+  listener.bind(EventUID::EntitySelected, Handler(&failing, 100));
+
+  listener.enqueue(makeEvent(0));
+  listener.enqueue(makeEvent(1));
+
+  BOOST_CHECK(!listener.processEvents());
+
+  // the new handler sits at the index the pending one had
+  listener.unbind(EventUID::EntitySelected);
+  listener.bind(EventUID::EntitySelected, Handler(&rebound));
+  BOOST_CHECK(listener.processEvents());
+
+  BOOST_CHECK_EQUAL(failing.size(), 1u);
+
+  const char* expected_rebound[] = { "1" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(rebound.begin(), rebound.end(), expected_rebound, expected_rebound + 1);
+}
+
+BOOST_AUTO_TEST_CASE(a_handler_that_throws_is_retried_alone)
+{
+  Listener listener;
+  std::vector<string_t> done, throwing, after;
+  bool thrown = false;
+
+  listener.bind(EventUID::EntitySelected, Handler(&done));
+  listener.bind(EventUID::EntitySelected, [&](const Event& evt) -> bool {
+    throwing.push_back(evt.getProperty("n"));
+    if (!thrown) {
+      thrown = true;
+      throw std::runtime_error("handler failed");
+    }
+
+    return true;
+  });
+  listener.bind(EventUID::EntitySelected, Handler(&after));
+
+  listener.enqueue(makeEvent(0));
+  listener.enqueue(makeEvent(1));
+
+  BOOST_CHECK_THROW(listener.processEvents(), std::runtime_error);
+  BOOST_CHECK(after.empty());
+
+  BOOST_CHECK(listener.processEvents());
+
+  const char* expected_done[] = { "0", "1" };
+  const char* expected_throwing[] = { "0", "0", "1" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(done.begin(), done.end(), expected_done, expected_done + 2);
+  BOOST_CHECK_EQUAL_COLLECTIONS(throwing.begin(), throwing.end(), expected_throwing, expected_throwing + 3);
+  BOOST_CHECK_EQUAL_COLLECTIONS(after.begin(), after.end(), expected_done, expected_done + 2);
+
+  // the dispatch was wrapped up: growing a handler vector from here on is
+  // no longer deferred to a dispatch that never ends
+  listener.bind(EventUID::EntitySelected, Handler(&after));
+  listener.enqueue(makeEvent(2));
+  BOOST_CHECK(listener.processEvents());
+  BOOST_CHECK_EQUAL(after.size(), 4u);
+}
+
+BOOST_AUTO_TEST_CASE(the_budget_caps_the_events_handled_per_call)
+{
+  Listener listener;
+  std::vector<string_t> calls;
+  listener.bind(EventUID::EntitySelected, Handler(&calls));
+
+  for (int n = 0; n < 5; ++n)
+    listener.enqueue(makeEvent(n));
+
+  BOOST_CHECK(!listener.processEvents(2));
+  BOOST_CHECK_EQUAL(calls.size(), 2u);
+
+  BOOST_CHECK(!listener.processEvents(2));
+  BOOST_CHECK_EQUAL(calls.size(), 4u);
+
+  BOOST_CHECK(listener.processEvents(2));
+
+  std::vector<string_t> expected = sequence(0, 5);
+  BOOST_CHECK_EQUAL_COLLECTIONS(calls.begin(), calls.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(handlers_bound_while_dispatching_wait_for_the_next_event)
+{
+  Listener listener;
+  std::vector<string_t> first, late;
+  bool bound = false;
+
+  listener.bind(EventUID::EntitySelected, [&](const Event& evt) -> bool {
+    first.push_back(evt.getProperty("n"));
+
+    // grows the very vector this handler lives in
+    if (!bound) {
+      for (int i = 0; i < 8; ++i)
+        listener.bind(EventUID::EntitySelected, Handler(&late));
+      bound = true;
+    }
+
+    return true;
+  });
+
+  listener.enqueue(makeEvent(0));
+  listener.enqueue(makeEvent(1));
+
+  BOOST_CHECK(listener.processEvents());
+  BOOST_CHECK_EQUAL(first.size(), 2u);
+  BOOST_CHECK_EQUAL(late.size(), 8u);
+  BOOST_CHECK_EQUAL(std::count(late.begin(), late.end(), "1"), 8);
+}
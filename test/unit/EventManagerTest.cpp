@@ -0,0 +1,238 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE EventManager
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/EventManager.hpp"
+#include "Hax/EventListener.hpp"
+#include "Hax/WorkerPool.hpp"
+
+#include <vector>
+#include <stdexcept>
+
+using namespace Hax;
+
+namespace {
+
+  /** writes down the "Entity:Position" of every event it handles */
+  class Listener : public EventListener {
+  public:
+    Listener() {
+      bind(EventUID::EntitySelected, boost::bind(&Listener::onEvent, this, _1));
+      bind(EventUID::EntityDeselected, boost::bind(&Listener::onEvent, this, _1));
+    }
+
+    virtual ~Listener() {
+      unbindAll();
+    }
+
+    bool onEvent(const Event& evt) {
+      string_t entity = evt.hasProperty("Entity") ? evt.getProperty("Entity") : "-";
+      calls.push_back(Utility::stringify((int)evt.UID) + " " + entity + ":" + evt.getProperty("Position"));
+      return true;
+    }
+
+    std::vector<string_t> calls;
+  };
+
+  Event makeEvent(string_t const& entity, string_t const& position, EventUID_T uid = EventUID::EntitySelected) {
+    Event evt(uid);
+    if (!entity.empty())
+      evt.setProperty("Entity", entity);
+    evt.setProperty("Position", position);
+    return evt;
+  }
+
+  /** a clean EventManager, that stops coalescing once the test is over */
+  struct Fixture {
+    Fixture()
+    : events(EventManager::getSingleton())
+    {
+      events.clear();
+    }
+
+    ~Fixture() {
+      events.coalesce(EventUID::EntitySelected, "");
+      events.clear();
+    }
+
+    /** dispatches everything that's queued, and has the listener handle it */
+    void dispatch(size_t hooked) {
+      for (size_t i = 0; i < hooked; ++i)
+        events.update();
+
+      listener.processEvents();
+    }
+
+    EventManager& events;
+    Listener listener;
+  };
+
+  string_t selected(string_t const& call) {
+    return Utility::stringify((int)EventUID::EntitySelected) + " " + call;
+  }
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE(a_coalesced_event_keeps_its_place_and_takes_the_latest_content, Fixture)
+{
+  events.coalesce(EventUID::EntitySelected, "Entity");
+
+  events.hook(makeEvent("1", "a"));
+  events.hook(makeEvent("2", "a"));
+  events.hook(makeEvent("1", "b"));
+  events.hook(makeEvent("1", "c"));
+  dispatch(4);
+
+  std::vector<string_t> expected;
+  expected.push_back(selected("1:c"));
+  expected.push_back(selected("2:a"));
+  BOOST_CHECK_EQUAL_COLLECTIONS(listener.calls.begin(), listener.calls.end(), expected.begin(), expected.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(events_lacking_the_key_are_not_coalesced, Fixture)
+{
+  events.coalesce(EventUID::EntitySelected, "Entity");
+
+  events.hook(makeEvent("", "a"));
+  events.hook(makeEvent("", "b"));
+  dispatch(2);
+
+  std::vector<string_t> expected;
+  expected.push_back(selected("-:a"));
+  expected.push_back(selected("-:b"));
+  BOOST_CHECK_EQUAL_COLLECTIONS(listener.calls.begin(), listener.calls.end(), expected.begin(), expected.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(only_the_coalesced_uid_is_coalesced, Fixture)
+{
+  events.coalesce(EventUID::EntitySelected, "Entity");
+
+  events.hook(makeEvent("1", "a", EventUID::EntityDeselected));
+  events.hook(makeEvent("1", "b", EventUID::EntityDeselected));
+  dispatch(2);
+
+  BOOST_CHECK_EQUAL(listener.calls.size(), 2u);
+}
+
+BOOST_FIXTURE_TEST_CASE(a_dispatched_event_is_not_replaced, Fixture)
+{
+  events.coalesce(EventUID::EntitySelected, "Entity");
+
+  events.hook(makeEvent("1", "a"));
+  dispatch(1);
+  events.hook(makeEvent("1", "b"));
+  dispatch(1);
+
+  std::vector<string_t> expected;
+  expected.push_back(selected("1:a"));
+  expected.push_back(selected("1:b"));
+  BOOST_CHECK_EQUAL_COLLECTIONS(listener.calls.begin(), listener.calls.end(), expected.begin(), expected.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(an_empty_key_stops_coalescing, Fixture)
+{
+  events.coalesce(EventUID::EntitySelected, "Entity");
+  events.hook(makeEvent("1", "a"));
+
+  events.coalesce(EventUID::EntitySelected, "");
+  events.hook(makeEvent("1", "b"));
+  events.hook(makeEvent("1", "c"));
+  dispatch(3);
+
+  std::vector<string_t> expected;
+  expected.push_back(selected("1:a"));
+  expected.push_back(selected("1:b"));
+  expected.push_back(selected("1:c"));
+  BOOST_CHECK_EQUAL_COLLECTIONS(listener.calls.begin(), listener.calls.end(), expected.begin(), expected.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(critical_events_go_first, Fixture)
+{
+  events.setLane(EventUID::EntityDeselected, EventLane::Critical);
+
+  events.hook(makeEvent("1", "a"));
+  events.hook(makeEvent("2", "a", EventUID::EntityDeselected));
+  dispatch(2);
+
+  events.setLane(EventUID::EntityDeselected, EventLane::Major);
+
+  BOOST_REQUIRE_EQUAL(listener.calls.size(), 2u);
+  BOOST_CHECK_EQUAL(listener.calls.front(), Utility::stringify((int)EventUID::EntityDeselected) + " 2:a");
+}
+
+BOOST_FIXTURE_TEST_CASE(pooled_listeners_are_processed_by_update, Fixture)
+{
+  WorkerPool pool(2);
+  events.setWorkerPool(&pool);
+
+  Listener pooled;
+  pooled.setAffinity(EventListener::AnyThread);
+
+  for (int i = 0; i < 10; ++i)
+    events.hook(makeEvent(Utility::stringify(i), "a"));
+
+  for (int i = 0; i < 10; ++i)
+    events.update();
+
+  events.setWorkerPool(NULL);
+
+  // in order, and without anyone calling processEvents()
+  BOOST_REQUIRE_EQUAL(pooled.calls.size(), 10u);
+  for (int i = 0; i < 10; ++i)
+    BOOST_CHECK_EQUAL(pooled.calls[i], selected(Utility::stringify(i) + ":a"));
+
+  listener.processEvents();
+  BOOST_CHECK_EQUAL(listener.calls.size(), 10u);
+}
+
+BOOST_FIXTURE_TEST_CASE(a_pooled_handler_that_throws_does_not_wedge_update, Fixture)
+{
+  WorkerPool pool(2);
+  events.setWorkerPool(&pool);
+
+  std::vector<string_t> calls;
+  EventListener thrower;
+  thrower.setAffinity(EventListener::AnyThread);
+  thrower.bind(EventUID::EntitySelected, [&calls](const Event& evt) -> bool {
+    calls.push_back(evt.getProperty("Entity"));
+    if (calls.size() == 1)
+      throw std::runtime_error("boom");
+    return true;
+  });
+
+  events.hook(makeEvent("1", "a"));
+  BOOST_CHECK_THROW(events.update(), std::runtime_error);
+
+  // the listener is scheduled again and the next update doesn't hang; the
+  // event it threw on is still at the front of its queue
+  events.hook(makeEvent("2", "a"));
+  events.update();
+
+  events.setWorkerPool(NULL);
+  thrower.unbindAll();
+
+  const char* expected[] = { "1", "1", "2" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(calls.begin(), calls.end(), expected, expected + 3);
+}
@@ -0,0 +1,172 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE LuaAllocator
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/LuaAllocator.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace Hax;
+
+namespace {
+
+  /** drives the allocator the way Lua does, through its lua_Alloc */
+  struct Fixture {
+    void* alloc(size_t size) {
+      return LuaAllocator::allocate(&allocator, 0, 0, size);
+    }
+
+    void* resize(void* ptr, size_t osize, size_t nsize) {
+      return LuaAllocator::allocate(&allocator, ptr, osize, nsize);
+    }
+
+    void release(void* ptr, size_t size) {
+      LuaAllocator::allocate(&allocator, ptr, size, 0);
+    }
+
+    LuaAllocator allocator;
+  };
+
+  void fill(void* ptr, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+      ((unsigned char*)ptr)[i] = (unsigned char)i;
+  }
+
+  bool isFilled(void const* ptr, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+      if (((unsigned char const*)ptr)[i] != (unsigned char)i)
+        return false;
+
+    return true;
+  }
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE(a_freed_block_is_reused_within_its_size_class, Fixture)
+{
+  void* first = alloc(20);
+  release(first, 20);
+
+  // 20 and 30 bytes both round up to 32
+  void* second = alloc(30);
+  BOOST_CHECK_EQUAL(second, first);
+
+  // 40 bytes is the next class up, which has nothing free yet
+  void* third = alloc(40);
+  BOOST_CHECK_NE(third, first);
+
+  release(second, 30);
+  release(third, 40);
+  BOOST_CHECK_EQUAL(allocator.getBytes(), 0u);
+  BOOST_CHECK_EQUAL(allocator.getPeakBytes(), 70u);
+}
+
+BOOST_FIXTURE_TEST_CASE(free_lists_are_last_in_first_out, Fixture)
+{
+  void* blocks[3];
+  for (size_t i = 0; i < 3; ++i)
+    blocks[i] = alloc(16);
+
+  for (size_t i = 0; i < 3; ++i)
+    release(blocks[i], 16);
+
+  for (size_t i = 3; i > 0; --i)
+    BOOST_CHECK_EQUAL(alloc(16), blocks[i - 1]);
+
+  BOOST_CHECK_EQUAL(allocator.getChunkBytes(), (size_t)LuaAllocator::ChunkSize);
+}
+
+BOOST_FIXTURE_TEST_CASE(resizing_within_a_class_keeps_the_block, Fixture)
+{
+  void* block = alloc(33);
+  BOOST_CHECK_EQUAL(resize(block, 33, 48), block);
+  BOOST_CHECK_EQUAL(resize(block, 48, 40), block);
+  BOOST_CHECK_EQUAL(allocator.getBytes(), 40u);
+
+  release(block, 40);
+}
+
+BOOST_FIXTURE_TEST_CASE(resizing_across_the_pooled_boundary_keeps_the_contents, Fixture)
+{
+  const size_t pooled = LuaAllocator::MaxPooled, heap = LuaAllocator::MaxPooled + 1;
+
+  void* block = alloc(pooled);
+  fill(block, pooled);
+
+  // onto the heap: the contents move, and the pooled block is free again
+  void* grown = resize(block, pooled, heap * 4);
+  BOOST_REQUIRE(grown);
+  BOOST_CHECK_NE(grown, block);
+  BOOST_CHECK(isFilled(grown, pooled));
+  BOOST_CHECK_EQUAL(allocator.getBytes(), heap * 4);
+
+  void* reused = alloc(pooled);
+  BOOST_CHECK_EQUAL(reused, block);
+  release(reused, pooled);
+
+  // within the heap
+  fill(grown, heap * 4);
+  void* regrown = resize(grown, heap * 4, heap * 8);
+  BOOST_REQUIRE(regrown);
+  BOOST_CHECK(isFilled(regrown, heap * 4));
+
+  // and back into the pool, truncated
+  void* shrunk = resize(regrown, heap * 8, 24);
+  BOOST_REQUIRE(shrunk);
+  BOOST_CHECK(isFilled(shrunk, 24));
+  BOOST_CHECK_EQUAL(allocator.getBytes(), 24u);
+
+  release(shrunk, 24);
+  BOOST_CHECK_EQUAL(allocator.getBytes(), 0u);
+  BOOST_CHECK_EQUAL(allocator.getPeakBytes(), heap * 8);
+}
+
+BOOST_FIXTURE_TEST_CASE(large_blocks_come_off_the_heap, Fixture)
+{
+  void* block = alloc(LuaAllocator::MaxPooled + 1);
+  BOOST_REQUIRE(block);
+  BOOST_CHECK_EQUAL(allocator.getChunkBytes(), 0u);
+
+  release(block, LuaAllocator::MaxPooled + 1);
+  BOOST_CHECK_EQUAL(allocator.getBytes(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(a_chunk_is_carved_up_before_the_next_one_is_taken, Fixture)
+{
+  const size_t per_chunk = LuaAllocator::ChunkSize / LuaAllocator::MaxPooled;
+
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < per_chunk; ++i)
+    blocks.push_back(alloc(LuaAllocator::MaxPooled));
+
+  BOOST_CHECK_EQUAL(allocator.getChunkBytes(), (size_t)LuaAllocator::ChunkSize);
+
+  blocks.push_back(alloc(LuaAllocator::MaxPooled));
+  BOOST_CHECK_EQUAL(allocator.getChunkBytes(), 2u * LuaAllocator::ChunkSize);
+
+  for (void* block : blocks)
+    release(block, LuaAllocator::MaxPooled);
+}
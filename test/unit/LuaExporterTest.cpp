@@ -0,0 +1,222 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE LuaExporter
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/LuaExporter.hpp"
+
+extern "C" {
+  #include "lualib.h"
+}
+
+#include <vector>
+
+using namespace Hax;
+
+namespace {
+
+  struct Item {
+    int id;
+  };
+
+  typedef std::vector<Item*> items_t;
+
+  /** a state with a usertype for Items, and a pool of Items to export */
+  struct Fixture {
+    Fixture()
+    : lua(newState())
+    {
+      for (int i = 0; i < 8; ++i) {
+        Item item = { i };
+        pool.push_back(item);
+      }
+    }
+
+    ~Fixture() {
+      exporter.reset();
+      lua_close(lua);
+    }
+
+    static lua_State* newState() {
+      lua_State* state = luaL_newstate();
+      luaL_openlibs(state);
+      tolua_open(state);
+      tolua_usertype(state, "Item");
+      return state;
+    }
+
+    /** the ids of the Items in the global array, in order */
+    std::vector<int> ids(lua_State* state, const char* name = "Items") {
+      std::vector<int> out;
+
+      lua_getglobal(state, name);
+      for (int i = 1; i <= (int)lua_objlen(state, -1); ++i) {
+        lua_rawgeti(state, -1, i);
+        out.push_back(((Item*)tolua_tousertype(state, -1, 0))->id);
+        lua_pop(state, 1);
+      }
+
+      // nothing is left dangling past the end
+      lua_rawgeti(state, -1, (int)out.size() + 1);
+      BOOST_CHECK(lua_isnil(state, -1));
+      lua_pop(state, 2);
+
+      return out;
+    }
+
+    std::vector<int> ids() {
+      return ids(lua);
+    }
+
+    void exportItems() {
+      exporter.__export(lua, items, "Item", "Items");
+    }
+
+    void check(std::vector<int> const& actual, int const* expected, size_t count) {
+      BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected, expected + count);
+    }
+
+    lua_State* lua;
+    std::vector<Item> pool;
+    items_t items;
+    LuaExporter<items_t> exporter;
+  };
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE(an_export_holds_the_container_in_order, Fixture)
+{
+  for (int i = 0; i < 4; ++i)
+    items.push_back(&pool[i]);
+
+  exportItems();
+
+  const int expected[] = { 0, 1, 2, 3 };
+  check(ids(), expected, 4);
+  BOOST_CHECK_EQUAL(lua_gettop(lua), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(removals_move_the_last_element_into_the_gap, Fixture)
+{
+  for (int i = 0; i < 5; ++i)
+    items.push_back(&pool[i]);
+
+  exportItems();
+
+  // dropping 3 moves 4 into its slot, and dropping 1 moves 4 on again
+  items.erase(items.begin() + 3);
+  items.erase(items.begin() + 1);
+  exportItems();
+
+  const int after_removal[] = { 0, 4, 2 };
+  check(ids(), after_removal, 3);
+
+  // dropping the one in the last slot leaves the rest where they are
+  items.erase(items.begin() + 1);
+  exportItems();
+
+  const int after_last[] = { 0, 4 };
+  check(ids(), after_last, 2);
+
+  items.clear();
+  exportItems();
+  BOOST_CHECK(ids().empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(insertions_are_appended_whatever_their_position, Fixture)
+{
+  items.push_back(&pool[0]);
+  items.push_back(&pool[1]);
+  exportItems();
+
+  items.insert(items.begin(), &pool[2]);
+  exportItems();
+
+  const int after_insertion[] = { 0, 1, 2 };
+  check(ids(), after_insertion, 3);
+
+  // a removed object that comes back goes to the end
+  items.erase(items.begin() + 1);
+  exportItems();
+  items.push_back(&pool[0]);
+  exportItems();
+
+  const int after_reinsertion[] = { 2, 1, 0 };
+  check(ids(), after_reinsertion, 3);
+}
+
+BOOST_FIXTURE_TEST_CASE(duplicates_are_exported_once, Fixture)
+{
+  items.push_back(&pool[0]);
+  items.push_back(&pool[1]);
+  items.push_back(&pool[0]);
+  exportItems();
+
+  const int expected[] = { 0, 1 };
+  check(ids(), expected, 2);
+
+  // dropping one of the copies keeps the object exported
+  items.pop_back();
+  exportItems();
+  check(ids(), expected, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(an_unchanged_export_touches_nothing, Fixture)
+{
+  for (int i = 0; i < 4; ++i)
+    items.push_back(&pool[i]);
+
+  exportItems();
+
+  lua_getglobal(lua, "Items");
+  lua_rawgeti(lua, -1, 2);
+
+  exportItems();
+
+  // the same array, holding the same userdata
+  lua_getglobal(lua, "Items");
+  BOOST_CHECK(lua_rawequal(lua, -1, -3));
+  lua_rawgeti(lua, -1, 2);
+  BOOST_CHECK(lua_rawequal(lua, -1, -3));
+
+  lua_settop(lua, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(an_export_into_another_state_starts_over, Fixture)
+{
+  for (int i = 0; i < 3; ++i)
+    items.push_back(&pool[i]);
+
+  exportItems();
+
+  lua_State* other = newState();
+  items.erase(items.begin());
+  exporter.__export(other, items, "Item", "Items");
+
+  const int expected[] = { 1, 2 };
+  check(ids(other), expected, 2);
+
+  exporter.reset();
+  lua_close(other);
+}
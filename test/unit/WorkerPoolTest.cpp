@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2011-2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+
+#define BOOST_TEST_MODULE WorkerPool
+#include <boost/test/included/unit_test.hpp>
+
+#include "Hax/WorkerPool.hpp"
+
+using namespace Hax;
+
+namespace {
+
+  /** lets a job hold its worker until the test is done with it */
+  class Gate {
+  public:
+    Gate() : fEntered(false), fOpen(false) { }
+
+    void enter() {
+      boost::mutex::scoped_lock lock(mMutex);
+      fEntered = true;
+      mChanged.notify_all();
+
+      while (!fOpen)
+        mChanged.wait(lock);
+    }
+
+    void waitForEntry() {
+      boost::mutex::scoped_lock lock(mMutex);
+      while (!fEntered)
+        mChanged.wait(lock);
+    }
+
+    void open() {
+      boost::mutex::scoped_lock lock(mMutex);
+      fOpen = true;
+      mChanged.notify_all();
+    }
+
+  private:
+    boost::mutex mMutex;
+    boost::condition_variable mChanged;
+    bool fEntered;
+    bool fOpen;
+  };
+
+  void count(std::atomic<size_t>* counter) {
+    ++(*counter);
+  }
+
+  void spawn(WorkerPool* pool, std::atomic<size_t>* counter, size_t children) {
+    ++(*counter);
+
+    for (size_t i = 0; i < children; ++i)
+      pool->submit(boost::bind(&count, counter));
+  }
+
+  void recordThread(boost::thread::id* out) {
+    *out = boost::this_thread::get_id();
+  }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(without_workers_jobs_run_on_the_caller)
+{
+  WorkerPool pool(0);
+  BOOST_CHECK_EQUAL(pool.size(), 0u);
+
+  boost::thread::id ran_on;
+  pool.submit(boost::bind(&recordThread, &ran_on));
+  BOOST_CHECK(ran_on == boost::this_thread::get_id());
+
+  BOOST_CHECK(!pool.help());
+}
+
+BOOST_AUTO_TEST_CASE(every_job_runs_before_the_pool_is_gone)
+{
+  const size_t jobs = 10000;
+  std::atomic<size_t> counter(0);
+
+  {
+    WorkerPool pool(4);
+    BOOST_CHECK_EQUAL(pool.size(), 4u);
+
+    for (size_t i = 0; i < jobs; ++i)
+      pool.submit(boost::bind(&count, &counter));
+  }
+
+  BOOST_CHECK_EQUAL(counter.load(), jobs);
+}
+
+BOOST_AUTO_TEST_CASE(jobs_submitted_by_jobs_run_too)
+{
+  const size_t parents = 100, children = 50;
+  std::atomic<size_t> counter(0);
+
+  {
+    WorkerPool pool(4);
+    for (size_t i = 0; i < parents; ++i)
+      pool.submit(boost::bind(&spawn, &pool, &counter, children));
+  }
+
+  BOOST_CHECK_EQUAL(counter.load(), parents * (children + 1));
+}
+
+BOOST_AUTO_TEST_CASE(a_waiting_thread_can_help)
+{
+  // the gate must outlive the pool, whose worker is still leaving it
+  Gate gate;
+  WorkerPool pool(1);
+
+  // keep the only worker busy, so the next job can only run if we help
+  pool.submit(boost::bind(&Gate::enter, &gate));
+  gate.waitForEntry();
+
+  boost::thread::id ran_on;
+  pool.submit(boost::bind(&recordThread, &ran_on));
+
+  BOOST_CHECK(pool.help());
+  BOOST_CHECK(ran_on == boost::this_thread::get_id());
+  BOOST_CHECK(!pool.help());
+
+  gate.open();
+}